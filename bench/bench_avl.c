@@ -0,0 +1,801 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  bench_avl: micro and macro benchmarks of c-avl, one record per phase on stdout
+
+  A run loads n keys, then times a mix of lookups, insertions and deletions drawn from the loaded keys. Each
+  operation is timed on its own and lands in a log-linear histogram, from which the percentiles are read.
+
+  usage: bench_avl [-n elements] [-o operations] [-k seq|uniform|zipf] [-z exponent] [-r read percent]
+                   [-t int|string] [-i avl|sorted] [-p] [-a] [-g] [-j threads] [-c readers] [-s seed]
+                   [-f json|csv]
+
+    -n  keys loaded before the timed mix (1000000)
+    -o  operations of the timed mix (as many as the keys), 0 to time the load only
+    -k  which loaded key an operation picks: in turn, uniformly, or with a Zipfian skew (uniform)
+    -z  exponent of the Zipfian skew (0.99)
+    -r  percent of lookups in the mix, the other operations delete the picked key or insert it back (90)
+    -t  8-byte integer keys stored inline, or 16-character string keys pointed to (int)
+    -i  the avl_set, or a sorted array with binary search and memmove as the baseline (avl)
+    -p  the avl_set caches the 8-byte prefixes of the string keys, reported as avl-prefix
+    -a  insertions are hinted by the previous one, sorted ingest with -k seq, reported as avl-hint
+    -g  growth-heavy, the avl_set starts from one slot instead of a reserve of n
+    -j  after the mix, time the union, intersection and difference of the avl_set with another one of n keys, half
+        of them loaded, on 1, 2, 4... up to that many threads, reported as union-t4 and so on (0)
+    -c  after the mix, time 1, 2, 4... up to that many reader threads, each looking up as many loaded keys as the
+        mix has operations, on an AVL_SET_CONCURRENT copy of the avl_set and on the avl_set behind a rwlock taken
+        for each lookup, reported as read-lockfree-t4 and read-rwlock-t4 and so on, no writer runs meanwhile (0)
+    -s  seed of the key order and of the mix (1)
+    -f  one JSON object per line, or CSV with a header (json)
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+/* sub-buckets per power of two of the latency histogram, the percentiles are within 1/16 */
+#define HIST_SUB_BITS (4)
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+enum key_order
+{
+    KEYS_SEQ,
+    KEYS_UNIFORM,
+    KEYS_ZIPF
+};
+
+struct options
+{
+    size_t n;
+    size_t ops;
+    int ops_set;
+    enum key_order order;
+    double zipf;
+    unsigned int read_pct;
+    int strings;
+    int sorted;
+    int prefix;
+    int hint;
+    int growth;
+    unsigned int threads;
+    unsigned int readers;
+    uint64_t seed;
+    int csv;
+};
+
+/* the keys and the structure under test */
+struct bench
+{
+    const struct options *opt;
+    /* key j is ints[j], or the string at strs + j * STR_KEY */
+    uint64_t *ints;
+    char *strs;
+    /* whether key j is in the structure */
+    uint8_t *present;
+    struct avl_set *set;
+    struct avl_config config;
+    /* where the last insertion went, with -a */
+    struct avl_set_cursor hint;
+    /* the sorted array baseline, of uint64_t or of char pointers */
+    void *array;
+    size_t count;
+};
+
+#define STR_KEY (17)
+
+struct histogram
+{
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned int hist_bucket(uint64_t v)
+{
+    if (v < HIST_SUB)
+    {
+        return (unsigned int)v;
+    }
+    unsigned int msb = 63;
+    while (0 == (v >> msb))
+    {
+        msb--;
+    }
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + (unsigned int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* upper bound of the values of bucket b */
+static uint64_t hist_value(unsigned int b)
+{
+    if (b < HIST_SUB)
+    {
+        return b;
+    }
+    unsigned int msb = b / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t base = (uint64_t)(HIST_SUB + b % HIST_SUB) << (msb - HIST_SUB_BITS);
+    return base + ((uint64_t)1 << (msb - HIST_SUB_BITS)) - 1;
+}
+
+static void hist_add(struct histogram *h, uint64_t v)
+{
+    h->buckets[hist_bucket(v)]++;
+    h->count++;
+    if (v > h->max)
+    {
+        h->max = v;
+    }
+}
+
+/* value at per mille p of the recorded values */
+static uint64_t hist_percentile(const struct histogram *h, unsigned int p)
+{
+    uint64_t rank = (h->count * p + 999) / 1000;
+    uint64_t seen = 0;
+    unsigned int b;
+    for (b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen >= rank && seen)
+        {
+            return (hist_value(b) < h->max) ? hist_value(b) : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* xorshift64*, the state must not be 0 */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* a bijection of the 64-bit integers, scatters consecutive indices */
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* Zipfian ranks in [0, n), after Gray et al., "Quickly generating billion-record synthetic databases" */
+struct zipf
+{
+    size_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+};
+
+static void zipf_init(struct zipf *z, size_t n, double theta)
+{
+    double zeta2 = 1.0 + pow(0.5, theta);
+    size_t i;
+    z->n = n;
+    z->theta = theta;
+    z->zetan = 0;
+    for (i = 1; i <= n; i++)
+    {
+        z->zetan += 1.0 / pow((double)i, theta);
+    }
+    z->alpha = 1.0 / (1.0 - theta);
+    z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+static size_t zipf_next(const struct zipf *z, uint64_t *state)
+{
+    double u = (double)(rng_next(state) >> 11) / 9007199254740992.0;
+    double uz = u * z->zetan;
+    if (uz < 1.0)
+    {
+        return 0;
+    }
+    if (uz < 1.0 + pow(0.5, z->theta))
+    {
+        return 1;
+    }
+    size_t r = (size_t)((double)z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return (r < z->n) ? r : z->n - 1;
+}
+
+static int int_compare(const void *lhs, const void *rhs)
+{
+    uint64_t l = *(const uint64_t *)lhs;
+    uint64_t r = *(const uint64_t *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+static int str_compare(const void *lhs, const void *rhs)
+{
+    return strcmp((const char *)lhs, (const char *)rhs);
+}
+
+static int str_ptr_compare(const void *lhs, const void *rhs)
+{
+    return strcmp(*(char *const *)lhs, *(char *const *)rhs);
+}
+
+static void *key_of(struct bench *b, size_t j)
+{
+    return b->opt->strings ? (void *)(b->strs + j * STR_KEY) : (void *)&b->ints[j];
+}
+
+/* position of key k in the sorted array, or of the first greater one */
+static size_t sorted_find(struct bench *b, void *k, int *found)
+{
+    size_t lo = 0;
+    size_t hi = b->count;
+    size_t width = b->opt->strings ? sizeof(char *) : sizeof(uint64_t);
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        void *at = (uint8_t *)b->array + mid * width;
+        int c = b->opt->strings ? strcmp(*(char **)at, (char *)k) : int_compare(at, k);
+        if (0 == c)
+        {
+            *found = 1;
+            return mid;
+        }
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *found = 0;
+    return lo;
+}
+
+static int op_search(struct bench *b, size_t j)
+{
+    void *k = key_of(b, j);
+    if (b->opt->sorted)
+    {
+        int found = 0;
+        sorted_find(b, k, &found);
+        return found;
+    }
+    return NULL != avl_set_search(b->set, k);
+}
+
+static int op_insert(struct bench *b, size_t j)
+{
+    void *k = key_of(b, j);
+    if (b->opt->sorted)
+    {
+        size_t width = b->opt->strings ? sizeof(char *) : sizeof(uint64_t);
+        int found = 0;
+        size_t at = sorted_find(b, k, &found);
+        if (found)
+        {
+            return 1;
+        }
+        uint8_t *p = (uint8_t *)b->array + at * width;
+        memmove(p + width, p, (b->count - at) * width);
+        if (b->opt->strings)
+            *(char **)p = (char *)k;
+        else
+            memcpy(p, k, width);
+        b->count++;
+        return 0;
+    }
+    if (b->opt->hint)
+    {
+        return avl_set_insert_hint(b->set, k, &b->hint);
+    }
+    return avl_set_insert(b->set, k);
+}
+
+static int op_delete(struct bench *b, size_t j)
+{
+    void *k = key_of(b, j);
+    if (b->opt->sorted)
+    {
+        size_t width = b->opt->strings ? sizeof(char *) : sizeof(uint64_t);
+        int found = 0;
+        size_t at = sorted_find(b, k, &found);
+        if (!found)
+        {
+            return -1;
+        }
+        uint8_t *p = (uint8_t *)b->array + at * width;
+        memmove(p, p + width, (b->count - at - 1) * width);
+        b->count--;
+        return 0;
+    }
+    return avl_set_delete(b->set, k);
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+    if (0 != getrusage(RUSAGE_SELF, &ru))
+    {
+        return -1;
+    }
+    return ru.ru_maxrss;
+}
+
+static const char *impl_name(const struct options *opt)
+{
+    if (opt->sorted)
+        return "sorted";
+    if (opt->hint)
+        return opt->prefix ? "avl-prefix-hint" : "avl-hint";
+    return opt->prefix ? "avl-prefix" : "avl";
+}
+
+static void report(const struct options *opt, const char *phase, uint64_t ops, uint64_t elapsed,
+                   const struct histogram *h)
+{
+    static const char *orders[] = {"seq", "uniform", "zipf"};
+    double seconds = (double)elapsed / 1e9;
+    double ops_per_sec = seconds > 0 ? (double)ops / seconds : 0;
+    double ns_per_op = ops ? (double)elapsed / (double)ops : 0;
+    /* the percentiles are null, or empty in CSV, for a phase timed as a whole */
+    char p50[32];
+    char p99[32];
+    char p999[32];
+    char pmax[32];
+    strcpy(p50, opt->csv ? "" : "null");
+    strcpy(p99, p50);
+    strcpy(p999, p50);
+    strcpy(pmax, p50);
+    if (h && h->count)
+    {
+        sprintf(p50, "%llu", (unsigned long long)hist_percentile(h, 500));
+        sprintf(p99, "%llu", (unsigned long long)hist_percentile(h, 990));
+        sprintf(p999, "%llu", (unsigned long long)hist_percentile(h, 999));
+        sprintf(pmax, "%llu", (unsigned long long)h->max);
+    }
+    if (opt->csv)
+    {
+        printf("%s,%s,%s,%s,%zu,%llu,%u,%d,%.6f,%.0f,%.1f,%s,%s,%s,%s,%ld\n", impl_name(opt), phase,
+               orders[opt->order], opt->strings ? "string" : "int", opt->n, (unsigned long long)ops, opt->read_pct,
+               opt->growth, seconds, ops_per_sec, ns_per_op, p50, p99, p999, pmax, peak_rss_kb());
+        return;
+    }
+    printf("{\"impl\":\"%s\",\"phase\":\"%s\",\"keys\":\"%s\",\"type\":\"%s\",\"n\":%zu,\"ops\":%llu,\"read_pct\":%u,"
+           "\"growth\":%d,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"ns_per_op\":%.1f,\"p50_ns\":%s,\"p99_ns\":%s,"
+           "\"p999_ns\":%s,\"max_ns\":%s,\"peak_rss_kb\":%ld}\n",
+           impl_name(opt), phase, orders[opt->order], opt->strings ? "string" : "int", opt->n,
+           (unsigned long long)ops, opt->read_pct, opt->growth, seconds, ops_per_sec, ns_per_op, p50, p99, p999, pmax,
+           peak_rss_kb());
+}
+
+/* insert the n keys, one timed insertion each; the baseline sorts them at once */
+static void load(struct bench *b, struct histogram *h)
+{
+    const struct options *opt = b->opt;
+    size_t j;
+    uint64_t t0 = now_ns();
+    if (opt->sorted)
+    {
+        size_t width = opt->strings ? sizeof(char *) : sizeof(uint64_t);
+        for (j = 0; j < opt->n; j++)
+        {
+            if (opt->strings)
+                ((char **)b->array)[j] = b->strs + j * STR_KEY;
+            else
+                ((uint64_t *)b->array)[j] = b->ints[j];
+        }
+        qsort(b->array, opt->n, width, opt->strings ? str_ptr_compare : int_compare);
+        b->count = opt->n;
+        memset(b->present, 1, opt->n);
+        report(opt, "load", opt->n, now_ns() - t0, NULL);
+        return;
+    }
+    for (j = 0; j < opt->n; j++)
+    {
+        uint64_t t = now_ns();
+        ASSERT_AND_ABORT(0 == op_insert(b, j));
+        hist_add(h, now_ns() - t);
+        b->present[j] = 1;
+    }
+    report(opt, "load", opt->n, now_ns() - t0, h);
+}
+
+/* the timed mix, on the keys picked in the chosen order */
+static void run(struct bench *b, struct histogram *h)
+{
+    const struct options *opt = b->opt;
+    struct zipf z;
+    memset(&z, 0, sizeof(z));
+    uint64_t state = opt->seed * 0x9E3779B97F4A7C15ULL + 1;
+    if (KEYS_ZIPF == opt->order)
+    {
+        zipf_init(&z, opt->n, opt->zipf);
+    }
+    size_t i;
+    size_t hits = 0;
+    uint64_t t0 = now_ns();
+    for (i = 0; i < opt->ops; i++)
+    {
+        size_t j;
+        if (KEYS_SEQ == opt->order)
+            j = i % opt->n;
+        else if (KEYS_UNIFORM == opt->order)
+            j = (size_t)(rng_next(&state) % opt->n);
+        else
+            j = (size_t)(mix64(zipf_next(&z, &state)) % opt->n);
+        int read = (rng_next(&state) % 100) < opt->read_pct;
+        uint64_t t = now_ns();
+        if (read)
+        {
+            hits += (size_t)op_search(b, j);
+        }
+        else if (b->present[j])
+        {
+            ASSERT_AND_ABORT(0 == op_delete(b, j));
+        }
+        else
+        {
+            ASSERT_AND_ABORT(0 == op_insert(b, j));
+        }
+        hist_add(h, now_ns() - t);
+        if (!read)
+        {
+            b->present[j] ^= 1;
+        }
+    }
+    report(opt, "run", opt->ops, now_ns() - t0, h);
+    /* keeps the lookups from being optimized away */
+    ASSERT_AND_ABORT(hits <= opt->ops);
+}
+
+/* the set operations of the loaded keys with the keys [n / 2, n + n / 2), on more and more threads */
+static void algebra(struct bench *b)
+{
+    const struct options *opt = b->opt;
+    struct avl_set *other = avl_set_create(opt->strings ? str_compare : int_compare, NULL, &b->config);
+    ASSERT_AND_ABORT(other);
+    size_t j;
+    for (j = opt->n / 2; j < opt->n + opt->n / 2; j++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(other, key_of(b, j)));
+    }
+    static const char *names[] = {"union", "intersection", "difference"};
+    struct avl_set *(*ops[])(struct avl_set *, struct avl_set *, unsigned int) = {
+        avl_set_union, avl_set_intersection, avl_set_difference};
+    uint64_t elements = avl_set_size(b->set) + avl_set_size(other);
+    unsigned int t;
+    for (t = 1; t <= opt->threads; t *= 2)
+    {
+        size_t i;
+        for (i = 0; i < 3; i++)
+        {
+            char phase[32];
+            uint64_t t0 = now_ns();
+            struct avl_set *r = ops[i](b->set, other, t);
+            uint64_t elapsed = now_ns() - t0;
+            ASSERT_AND_ABORT(r);
+            avl_set_destroy(r);
+            sprintf(phase, "%s-t%u", names[i], t);
+            report(opt, phase, elements, elapsed, NULL);
+        }
+    }
+    avl_set_destroy(other);
+}
+
+/* a reader thread of readers(), through a reader record or the rwlock */
+struct reader_job
+{
+    struct bench *b;
+    struct avl_set *set;
+    pthread_rwlock_t *lock;
+    uint64_t state;
+    size_t hits;
+};
+
+static void *reader(void *arg)
+{
+    struct reader_job *job = (struct reader_job *)arg;
+    const struct options *opt = job->b->opt;
+    struct avl_reader *r = NULL;
+    if (NULL == job->lock)
+    {
+        r = avl_set_reader_register(job->set);
+        ASSERT_AND_ABORT(r);
+    }
+    size_t i;
+    for (i = 0; i < opt->ops; i++)
+    {
+        void *k = key_of(job->b, (size_t)(rng_next(&job->state) % opt->n));
+        if (r)
+            avl_set_reader_enter(r);
+        else
+            pthread_rwlock_rdlock(job->lock);
+        job->hits += (NULL != avl_set_search(job->set, k));
+        if (r)
+            avl_set_reader_exit(r);
+        else
+            pthread_rwlock_unlock(job->lock);
+    }
+    avl_set_reader_unregister(r);
+    return NULL;
+}
+
+/* the lookups of the loaded keys by more and more reader threads, lock-free and behind a rwlock */
+static void readers(struct bench *b)
+{
+    const struct options *opt = b->opt;
+    struct avl_config config = b->config;
+    config._options |= AVL_SET_CONCURRENT;
+    struct avl_set *lock_free = avl_set_create(opt->strings ? str_compare : int_compare, NULL, &config);
+    ASSERT_AND_ABORT(lock_free);
+    size_t j;
+    for (j = 0; j < opt->n; j++)
+    {
+        if (b->present[j])
+            ASSERT_AND_ABORT(0 == avl_set_insert(lock_free, key_of(b, j)));
+    }
+    pthread_rwlock_t lock;
+    pthread_rwlock_init(&lock, NULL);
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * opt->readers);
+    struct reader_job *jobs = (struct reader_job *)calloc(opt->readers, sizeof(struct reader_job));
+    ASSERT_AND_ABORT(tids && jobs);
+    unsigned int t;
+    for (t = 1; t <= opt->readers; t *= 2)
+    {
+        int locked;
+        for (locked = 0; locked < 2; locked++)
+        {
+            char phase[32];
+            unsigned int i;
+            size_t hits = 0;
+            uint64_t t0 = now_ns();
+            for (i = 0; i < t; i++)
+            {
+                jobs[i].b = b;
+                jobs[i].set = locked ? b->set : lock_free;
+                jobs[i].lock = locked ? &lock : NULL;
+                jobs[i].state = (opt->seed + i) * 0x9E3779B97F4A7C15ULL + 1;
+                jobs[i].hits = 0;
+                ASSERT_AND_ABORT(0 == pthread_create(&tids[i], NULL, reader, &jobs[i]));
+            }
+            for (i = 0; i < t; i++)
+            {
+                pthread_join(tids[i], NULL);
+                hits += jobs[i].hits;
+            }
+            uint64_t elapsed = now_ns() - t0;
+            ASSERT_AND_ABORT(hits <= (size_t)t * opt->ops);
+            sprintf(phase, "read-%s-t%u", locked ? "rwlock" : "lockfree", t);
+            report(opt, phase, (uint64_t)t * opt->ops, elapsed, NULL);
+        }
+    }
+    free(jobs);
+    free(tids);
+    pthread_rwlock_destroy(&lock);
+    avl_set_destroy(lock_free);
+}
+
+static void usage(const char *self)
+{
+    fprintf(stderr,
+            "usage: %s [-n elements] [-o operations] [-k seq|uniform|zipf] [-z exponent] [-r read percent]\n"
+            "          [-t int|string] [-i avl|sorted] [-p] [-a] [-g] [-j threads] [-c readers] [-s seed]\n"
+            "          [-f json|csv]\n",
+            self);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.n = 1000000;
+    opt.order = KEYS_UNIFORM;
+    opt.zipf = 0.99;
+    opt.read_pct = 90;
+    opt.seed = 1;
+    int c;
+    while (-1 != (c = getopt(argc, argv, "n:o:k:z:r:t:i:pagj:c:s:f:")))
+    {
+        switch (c)
+        {
+        case 'n':
+            opt.n = (size_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            opt.ops = (size_t)strtoull(optarg, NULL, 10);
+            opt.ops_set = 1;
+            break;
+        case 'k':
+            if (0 == strcmp(optarg, "seq"))
+                opt.order = KEYS_SEQ;
+            else if (0 == strcmp(optarg, "uniform"))
+                opt.order = KEYS_UNIFORM;
+            else if (0 == strcmp(optarg, "zipf"))
+                opt.order = KEYS_ZIPF;
+            else
+                usage(argv[0]);
+            break;
+        case 'z':
+            opt.zipf = atof(optarg);
+            break;
+        case 'r':
+            opt.read_pct = (unsigned int)atoi(optarg);
+            break;
+        case 't':
+            if (0 == strcmp(optarg, "int"))
+                opt.strings = 0;
+            else if (0 == strcmp(optarg, "string"))
+                opt.strings = 1;
+            else
+                usage(argv[0]);
+            break;
+        case 'i':
+            if (0 == strcmp(optarg, "avl"))
+                opt.sorted = 0;
+            else if (0 == strcmp(optarg, "sorted"))
+                opt.sorted = 1;
+            else
+                usage(argv[0]);
+            break;
+        case 'p':
+            opt.prefix = 1;
+            break;
+        case 'a':
+            opt.hint = 1;
+            break;
+        case 'g':
+            opt.growth = 1;
+            break;
+        case 'j':
+            opt.threads = (unsigned int)atoi(optarg);
+            break;
+        case 'c':
+            opt.readers = (unsigned int)atoi(optarg);
+            break;
+        case 's':
+            opt.seed = (uint64_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'f':
+            if (0 == strcmp(optarg, "json"))
+                opt.csv = 0;
+            else if (0 == strcmp(optarg, "csv"))
+                opt.csv = 1;
+            else
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (0 == opt.n || opt.read_pct > 100 || opt.zipf <= 0 || opt.zipf == 1.0 || opt.n > ((size_t)1 << 31) - 2 ||
+        (opt.prefix && (!opt.strings || opt.sorted)) || (opt.hint && opt.sorted) ||
+        (opt.threads && opt.sorted) || (opt.readers && (opt.sorted || 0 == opt.ops)))
+    {
+        usage(argv[0]);
+    }
+    if (!opt.ops_set)
+    {
+        opt.ops = opt.n;
+    }
+
+    /* the keys, distinct, loaded in sequence or in a scattered order; with -j, n / 2 more are never loaded */
+    struct bench b;
+    memset(&b, 0, sizeof(b));
+    b.opt = &opt;
+    b.present = (uint8_t *)calloc(opt.n, 1);
+    ASSERT_AND_ABORT(b.present);
+    size_t nkeys = opt.n + (opt.threads ? opt.n / 2 : 0);
+    size_t j;
+    if (opt.strings)
+    {
+        b.strs = (char *)malloc(nkeys * STR_KEY);
+        ASSERT_AND_ABORT(b.strs);
+    }
+    else
+    {
+        b.ints = (uint64_t *)malloc(nkeys * sizeof(uint64_t));
+        ASSERT_AND_ABORT(b.ints);
+    }
+    for (j = 0; j < nkeys; j++)
+    {
+        uint64_t k = (KEYS_SEQ == opt.order) ? (uint64_t)j : mix64((uint64_t)j ^ (opt.seed << 32));
+        if (opt.strings)
+            sprintf(b.strs + j * STR_KEY, "%016llx", (unsigned long long)k);
+        else
+            b.ints[j] = k;
+    }
+
+    if (opt.sorted)
+    {
+        b.array = malloc(opt.n * (opt.strings ? sizeof(char *) : sizeof(uint64_t)));
+        ASSERT_AND_ABORT(b.array);
+    }
+    else
+    {
+        b.config._reserve = opt.growth ? 1 : opt.n;
+        b.config._key_size = opt.strings ? 0 : sizeof(uint64_t);
+        b.config._key_prefix = opt.prefix ? avl_string_prefix : NULL;
+        b.set = avl_set_create(opt.strings ? str_compare : int_compare, NULL, &b.config);
+        ASSERT_AND_ABORT(b.set);
+    }
+    if (opt.csv)
+    {
+        printf("impl,phase,keys,type,n,ops,read_pct,growth,seconds,ops_per_sec,ns_per_op,p50_ns,p99_ns,p999_ns,max_ns,"
+               "peak_rss_kb\n");
+    }
+
+    struct histogram *h = (struct histogram *)calloc(1, sizeof(struct histogram));
+    ASSERT_AND_ABORT(h);
+    load(&b, h);
+    if (opt.ops)
+    {
+        memset(h, 0, sizeof(struct histogram));
+        run(&b, h);
+    }
+    if (opt.threads)
+    {
+        algebra(&b);
+    }
+    if (opt.readers)
+    {
+        readers(&b);
+    }
+
+    free(h);
+    if (b.set)
+        avl_set_destroy(b.set);
+    free(b.array);
+    free(b.ints);
+    free(b.strs);
+    free(b.present);
+    return 0;
+}
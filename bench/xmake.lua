@@ -0,0 +1,10 @@
+set_languages("c99 cxx11")
+
+target("bench_avl")
+    set_kind("binary")
+    add_files("bench_avl.c")
+    add_deps("c-avl")
+    if not is_plat("windows") then
+        add_syslinks("m")
+    end
+target_end()
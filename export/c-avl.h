@@ -57,6 +57,73 @@ extern "C"
      */
     typedef void (*avl_destruct)(void *p);
 
+    /**
+     * @brief key prefix function pointer
+     * @param k key, as passed to the ::avl_compare
+     * @return a prefix of k which keeps the order: a key whose prefix is lower compares lower, keys comparing equal
+     * have the same prefix
+     */
+    typedef uint64_t (*avl_key_prefix)(const void *k);
+
+/**
+ * @brief option of ::avl_config, keep subtree sizes for avl_set_rank(), avl_set_select() and avl_set_count_range()
+ * @note it costs 4 more bytes per element (8 with alignment on 64-bit platforms)
+ */
+#define AVL_SET_ORDER_STATISTICS (1u << 0)
+
+/**
+ * @brief option of ::avl_config, one writer thread and any number of reader threads without locks
+ * @note a reader thread takes an ::avl_reader and wraps its lookups and cursor walks between avl_set_reader_enter()
+ * and avl_set_reader_exit(), the elements it gets stay valid until it exits
+ * @note a lookup overlapping a change of the writer is retried, deleted elements are destructed by the writer once
+ * every reader that could see them has exited
+ * @note the writer lists the elements and the arena segments retired in the meantime, in memory proportional to
+ * what the readers still hold; a reader staying long inside a read section makes that list grow, not fail
+ * @note avl_set_extract(), avl_set_insert_or_assign() with ::AVL_ASSIGN_DETACH and avl_set_build_sorted() wait for
+ * the readers to exit, the writer must not call them from inside a read section of its own (asserted in debug builds)
+ * @note avl_set_split(), avl_set_join() and the set operations refuse a concurrent avl_set
+ * @note it needs the GCC __atomic builtins, avl_set_create() returns NULL with it on other compilers
+ */
+#define AVL_SET_CONCURRENT (1u << 1)
+
+/**
+ * @brief option of ::avl_config, allow avl_set_snapshot() to take read-only versions of the avl_set in O(1)
+ * @note it costs 4 more bytes per element; a snapshot shares the unchanged elements with the avl_set, which copies
+ * the few ones on the path of a change instead of modifying them
+ * @note while a snapshot is alive, avl_set_delete() may fail and avl_set_clear() may leave the avl_set as it is on
+ * allocation failure, deleted elements are destructed once the older snapshots are released, avl_set_build_sorted(),
+ * avl_set_split() and avl_set_join() refuse the avl_set
+ * @note the slots dropped while a snapshot is alive are listed in memory proportional to the changes, the list is
+ * freed with the last snapshot
+ * @note it cannot be combined with ::AVL_SET_CONCURRENT
+ */
+#define AVL_SET_SNAPSHOTS (1u << 2)
+
+/**
+ * @brief arena policy of ::avl_config, back the arena with transparent huge pages (2 MB, aligned to 2 MB)
+ * @note the arena is mapped and advised with madvise(MADV_HUGEPAGE), its size is rounded up to 2 MB; without
+ * transparent huge pages the mapping keeps regular pages
+ */
+#define AVL_ARENA_HUGE_PAGES (1u << 0)
+
+/**
+ * @brief arena policy of ::avl_config, back the arena with explicit huge pages (MAP_HUGETLB)
+ * @note it falls back to ::AVL_ARENA_HUGE_PAGES when the system has no huge page reserved
+ */
+#define AVL_ARENA_HUGETLB (1u << 1)
+
+/**
+ * @brief arena policy of ::avl_config, interleave the pages of the arena across the NUMA nodes
+ * @note the placement is a hint, it is dropped on a kernel without NUMA support
+ */
+#define AVL_ARENA_NUMA_INTERLEAVE (1u << 2)
+
+/**
+ * @brief arena policy of ::avl_config, place the pages of the arena on the NUMA node avl_config::_arena_node
+ * @note the placement is a hint, it is dropped on a kernel without NUMA support or for a node it does not know
+ */
+#define AVL_ARENA_NUMA_BIND (1u << 3)
+
     /**
      * @struct avl_config
      * @brief customizable configuration
@@ -67,8 +134,31 @@ extern "C"
         struct avl_config _config = {
             ._alloc = my_malloc,
             ._dealloc = my_free,
-            ._reserve = 8};
+            ._reserve = 8,
+            ._options = AVL_SET_ORDER_STATISTICS};
      * @endcode
+     * @par Inline keys
+     * With a non-zero _key_size, avl_set_insert() copies _key_size bytes from the given element into the
+     * avl_set and the ::avl_compare receives addresses inside the avl_set. The elements returned by the
+     * search and cursor functions are valid until the next insertion or deletion.
+     * @par Arena
+     * The slots of the elements live in an arena of segments of 64 KB, or of 2 MB with a huge page policy. A growth
+     * adds one segment and moves no element, except while the first segment is smaller than that. With _arena_alloc
+     * and _arena_dealloc set, the segments come from them, the alignment they get is 2 MB for the huge page policies
+     * and 64 bytes otherwise. Without them, a non-zero _arena_policy maps the segments with mmap() on Linux, and is
+     * ignored elsewhere. _alloc and _dealloc still allocate the bookkeeping of the avl_set.
+     * @par Shrink
+     * The arena grows when it is full and keeps its size on deletions. With a non-zero _shrink_percent, a
+     * deletion that leaves the arena of 100 slots or more filled below that percent starts draining the slots above
+     * room for half as many more elements. Each following deletion moves a few elements from there down into free
+     * slots, at O(log n) each; once they are all gone the arena is cut, which frees the segments above and copies
+     * the first segment at most. No deletion relayouts the whole arena, avl_set_shrink_to_fit() does it at once in
+     * O(n). An insertion that finds no room below stops the drain. A concurrent avl_set, a mapped avl_set, or an
+     * avl_set with a live snapshot is not shrunk.
+     * @par Key prefixes
+     * With _key_prefix set, each slot caches the prefix of its key next to the node. Lookups, insertions and
+     * deletions compare the prefixes first and call the ::avl_compare only when they are equal. avl_string_prefix()
+     * suits keys compared with strcmp(). A mapped avl_set does not use the prefixes.
      */
     struct avl_config
     {
@@ -78,6 +168,24 @@ extern "C"
         void (*_dealloc)(void *);
         /** reserve elements*/
         size_t _reserve;
+        /** bitwise OR of AVL_SET_* options*/
+        unsigned int _options;
+        /** bytes of a key copied into the avl_set, 0 to store the key pointers as they are*/
+        size_t _key_size;
+        /** customize arena allocator, gets _arena_ctx, the bytes and their alignment*/
+        void *(*_arena_alloc)(void *ctx, size_t bytes, size_t align);
+        /** customize arena deallocator, gets _arena_ctx, the arena and its bytes*/
+        void (*_arena_dealloc)(void *ctx, void *p, size_t bytes);
+        /** user context of the arena allocator*/
+        void *_arena_ctx;
+        /** bitwise OR of AVL_ARENA_* policies*/
+        unsigned int _arena_policy;
+        /** NUMA node of ::AVL_ARENA_NUMA_BIND*/
+        unsigned int _arena_node;
+        /** drain the arena once the elements fill less than this percent of it, at most 50, 0 never*/
+        unsigned int _shrink_percent;
+        /** order-preserving 8-byte prefix of a key, NULL to call the ::avl_compare at each step*/
+        avl_key_prefix _key_prefix;
     };
 
     /**
@@ -86,6 +194,54 @@ extern "C"
      */
     struct avl_set;
 
+/**
+ * @brief upper bound of the height of an avl_set, 2^31 elements need at most 45 levels
+ */
+#define AVL_MAX_HEIGHT (64)
+
+    /**
+     * @struct avl_set_cursor
+     * @brief a position in the order of an avl_set, lives on the caller side
+     * @note any insertion or deletion invalidates the cursors of the avl_set, except for the cursors of the readers
+     * of a concurrent avl_set, which move on from their last element
+     * @par Example codes
+     * @code {.c}
+        struct avl_set_cursor _c;
+        void *_e;
+        for (_e = avl_set_first(s, &_c); _e; _e = avl_set_next(&_c))
+        {
+            do_something(_e);
+        }
+     * @endcode
+     */
+    struct avl_set_cursor
+    {
+        /** the avl_set being walked */
+        struct avl_set *_set;
+        /** length of the path, 0 when the cursor is out of range */
+        size_t _depth;
+        /** slots from the root down to the current element */
+        uint32_t _path[AVL_MAX_HEIGHT];
+        /** version of a concurrent avl_set the path was taken from */
+        size_t _seq;
+        /** changes of the avl_set when avl_set_insert_hint() left the cursor, 0 once positioned otherwise */
+        size_t _version;
+        /** successor of the element avl_set_insert_hint() left the cursor at, while _version is current */
+        uint32_t _succ;
+    };
+
+    /**
+     * @struct avl_reader
+     * @brief a reader thread of an avl_set created with AVL_SET_CONCURRENT
+     */
+    struct avl_reader;
+
+    /**
+     * @struct avl_snapshot
+     * @brief a read-only version of an avl_set created with AVL_SET_SNAPSHOTS
+     */
+    struct avl_snapshot;
+
     /**
      * @brief create an avl_set
      * @param cmp [<b>mandatory</b>] compare function between set elements
@@ -112,6 +268,13 @@ extern "C"
      */
     struct avl_set *avl_set_create(avl_compare cmp, avl_destruct dtor, const struct avl_config *cfg);
 
+    /**
+     * @brief ::avl_key_prefix of the NUL-terminated strings compared with strcmp()
+     * @param k the string
+     * @return its first 8 bytes, big-endian, padded with 0
+     */
+    uint64_t avl_string_prefix(const void *k);
+
     /**
      * @brief return the number of the avl_set elements
      * @param s target avl_set
@@ -133,6 +296,33 @@ extern "C"
      */
     void avl_set_destroy(struct avl_set *s);
 
+    /**
+     * @brief register a reader thread of a concurrent avl_set
+     * @param s target avl_set, created with AVL_SET_CONCURRENT
+     * @return the reader, NULL if s is not concurrent or has too many readers
+     * @note a reader is used by one thread at a time, and unregistered before avl_set_destroy()
+     */
+    struct avl_reader *avl_set_reader_register(struct avl_set *s);
+
+    /**
+     * @brief give back a reader taken by avl_set_reader_register()
+     * @param r [optional] the reader, outside of any read section
+     */
+    void avl_set_reader_unregister(struct avl_reader *r);
+
+    /**
+     * @brief start a read section, the writer does not recycle the elements the reader can reach until it exits
+     * @param r the reader of the calling thread
+     * @note read sections do not nest, keep them short as the deleted elements pile up meanwhile
+     */
+    void avl_set_reader_enter(struct avl_reader *r);
+
+    /**
+     * @brief end a read section, the elements and cursors got within it must not be used anymore
+     * @param r the reader of the calling thread
+     */
+    void avl_set_reader_exit(struct avl_reader *r);
+
     /**
      * @brief search an element in the avl_set
      * @param s target avl_set
@@ -142,11 +332,21 @@ extern "C"
      */
     void *avl_set_search(struct avl_set *s, const void *k);
 
+    /**
+     * @brief search many elements at once, the cache misses of independent lookups overlap
+     * @param s target avl_set
+     * @param keys the n "key" elements to be searched
+     * @param n number of the keys
+     * @param out [out] n results, out[i] is the element equal to keys[i] or NULL on not found
+     * @return number of the elements found
+     */
+    size_t avl_set_search_batch(struct avl_set *s, void *const *keys, size_t n, void **out);
+
     /**
      * @brief insert an element into the avl_set
      * @param s target avl_set
-     * @param k the element to be inserted
-     * @return 0 on success, 1 on duplicated
+     * @param k the element to be inserted, copied if the avl_set has inline keys
+     * @return 0 on success, 1 on duplicated, -1 on allocation failure
      * @note duplicated element will be destroyed
      */
     int avl_set_insert(struct avl_set *s, void *k);
@@ -155,10 +355,691 @@ extern "C"
      * @brief delete an element from the avl_set
      * @param s target avl_set
      * @param k the element to be deleted
-     * @return 0 on success, -1 on not found
+     * @return 0 on success, -1 on not found (or on allocation failure while a snapshot is alive)
      */
     int avl_set_delete(struct avl_set *s, const void *k);
 
+    /**
+     * @enum avl_assign
+     * @brief what avl_set_insert_or_assign() does with an element equal to the inserted one
+     */
+    enum avl_assign
+    {
+        /** keep the element, the inserted one is still owned by the caller */
+        AVL_ASSIGN_KEEP,
+        /** store the inserted element instead and destroy the previous one, as avl_set_insert() does */
+        AVL_ASSIGN_REPLACE,
+        /** store the inserted element instead and hand the previous one to the caller, without destroying it */
+        AVL_ASSIGN_DETACH
+    };
+
+    /**
+     * @brief insert an element into the avl_set, or assign it to the equal element, in one descent
+     * @param s target avl_set
+     * @param k the element to be inserted, copied if the avl_set has inline keys
+     * @param assign what becomes of an equal element already in the avl_set
+     * @param prev [optional] set to the equal element kept or detached, NULL if none or if it is destroyed; required
+     * with ::AVL_ASSIGN_DETACH
+     * @return 0 on success, 1 on duplicated, -1 on allocation failure or on ::AVL_ASSIGN_DETACH without prev
+     * @note a detached inline key is copied into a buffer of the avl_set, valid until the next extraction or
+     * detachment; a concurrent avl_set waits for its readers to let go of a detached element, a snapshot keeps
+     * sharing it
+     * @note with ::AVL_ASSIGN_DETACH on a concurrent avl_set, the calling thread must not be in a read section
+     */
+    int avl_set_insert_or_assign(struct avl_set *s, void *k, enum avl_assign assign, void **prev);
+
+    /**
+     * @brief search an element, insert it if it is absent, in one descent
+     * @param s target avl_set
+     * @param k the element to be searched or inserted
+     * @param inserted [optional] set to 1 if k is inserted, otherwise k is still owned by the caller
+     * @return the element in the avl_set, equal to k, NULL on allocation failure
+     * @note the element found is left as it is, nothing is destroyed
+     */
+    void *avl_set_find_or_insert(struct avl_set *s, void *k, int *inserted);
+
+    /**
+     * @brief take an element out of the avl_set without destroying it
+     * @param s target avl_set
+     * @param k the element to be extracted
+     * @return the element, now owned by the caller, NULL on not found (or on allocation failure while a snapshot
+     * is alive)
+     * @note an extracted inline key is copied into a buffer of the avl_set, valid until the next extraction or
+     * detachment; a concurrent avl_set waits for its readers to let go of the element, a snapshot keeps sharing it
+     * @note on a concurrent avl_set, the calling thread must not be in a read section
+     */
+    void *avl_set_extract(struct avl_set *s, const void *k);
+
+    /**
+     * @brief move the cursor to the smallest element
+     * @param s target avl_set
+     * @param c the cursor to be positioned
+     * @return the smallest element, NULL on empty set
+     */
+    void *avl_set_first(struct avl_set *s, struct avl_set_cursor *c);
+
+    /**
+     * @brief move the cursor to the largest element
+     * @param s target avl_set
+     * @param c the cursor to be positioned
+     * @return the largest element, NULL on empty set
+     */
+    void *avl_set_last(struct avl_set *s, struct avl_set_cursor *c);
+
+    /**
+     * @brief move the cursor to the next element in order
+     * @param c a positioned cursor
+     * @return the next element, NULL when the cursor passes the largest one
+     */
+    void *avl_set_next(struct avl_set_cursor *c);
+
+    /**
+     * @brief move the cursor to the previous element in order
+     * @param c a positioned cursor
+     * @return the previous element, NULL when the cursor passes the smallest one
+     */
+    void *avl_set_prev(struct avl_set_cursor *c);
+
+    /**
+     * @brief move the cursor to the first element which is not less than k
+     * @param s target avl_set
+     * @param k the "key" element to be compared
+     * @param c the cursor to be positioned
+     * @return the element found, NULL if every element is less than k
+     */
+    void *avl_set_lower_bound(struct avl_set *s, const void *k, struct avl_set_cursor *c);
+
+    /**
+     * @brief move the cursor to the first element which is greater than k
+     * @param s target avl_set
+     * @param k the "key" element to be compared
+     * @param c the cursor to be positioned
+     * @return the element found, NULL if no element is greater than k
+     */
+    void *avl_set_upper_bound(struct avl_set *s, const void *k, struct avl_set_cursor *c);
+
+    /**
+     * @brief get the element under the cursor
+     * @param c a positioned cursor
+     * @return current element, NULL when the cursor is out of range
+     */
+    void *avl_set_cursor_get(const struct avl_set_cursor *c);
+
+    /**
+     * @brief insert an element right after the element of a cursor, for sorted and near-sorted streams
+     * @param s target avl_set
+     * @param k the element to be inserted, copied if the avl_set has inline keys
+     * @param hint a cursor of s, or a zeroed cursor to start appending, moved to the inserted element
+     * @return 0 on success, 1 on duplicated, -1 on allocation failure
+     * @note k is compared with the element of the hint and its successor only, if it falls in between; otherwise
+     * it is inserted from the root as avl_set_insert() does. Feeding each insertion the hint left by the previous
+     * one, an ascending stream is inserted with O(1) comparisons and amortized O(1) work per element: that hint is
+     * trusted as long as nothing else changed the set, and its path is read as far up as the rebalancing climbs.
+     * Any other cursor has its path from the root checked through the links first, without touching the keys; so
+     * has any cursor of a set keeping order statistics or sharing elements with snapshots, which update every
+     * ancestor anyway.
+     */
+    int avl_set_insert_hint(struct avl_set *s, void *k, struct avl_set_cursor *hint);
+
+    /**
+     * @brief fill an empty avl_set with sorted elements, in O(n)
+     * @param s target avl_set, must be empty
+     * @param keys elements in strictly ascending order, as they would be passed to avl_set_insert()
+     * @param n number of the elements
+     * @return 0 on success, -1 if the avl_set is not empty or on allocation failure
+     * @note the order is only verified by assertions, unsorted or duplicated elements break the avl_set
+     */
+    int avl_set_build_sorted(struct avl_set *s, void **keys, size_t n);
+
+    /**
+     * @brief split an avl_set at a pivot
+     * @param s target avl_set, reused for one of the halves
+     * @param pivot the "key" element to be compared
+     * @param lo [out] the avl_set of the elements less than pivot
+     * @param hi [out] the avl_set of the other elements
+     * @return 0 on success, -1 on allocation failure (s keeps all its elements)
+     * @note s is handed back through *lo or *hi, the other one is a new avl_set with an arena of its own
+     * @note the split costs O(log n + min(|lo|, |hi|)), not O(log n): the tree is cut with O(log n) rotations, then
+     * every element of the smaller half is copied into the new arena, with its inline key and value, and its slot
+     * in s is freed
+     */
+    int avl_set_split(struct avl_set *s, const void *pivot, struct avl_set **lo, struct avl_set **hi);
+
+    /**
+     * @brief move all the elements of b into a
+     * @param a target avl_set, its elements must all be less than those of b
+     * @param b an avl_set with the same ::avl_compare and configuration as a, emptied on success
+     * @return 0 on success, -1 on mismatched or overlapping sets or allocation failure
+     * @note the join costs O(log n + min(|a|, |b|)), not O(log n): every element of the smaller avl_set is copied
+     * into the arena of the larger one, with its inline key and value, then the trees are joined with O(log n)
+     * rotations; a and b exchange their arenas first when b is the larger one, unless their arena policies differ,
+     * in which case the elements of b are the ones copied, in O(log n + |b|)
+     */
+    int avl_set_join(struct avl_set *a, struct avl_set *b);
+
+    /**
+     * @brief delete the elements in the range [from, to)
+     * @param s target avl_set
+     * @param from lower bound of the range, inclusive
+     * @param to upper bound of the range, exclusive
+     * @return number of the deleted elements
+     * @note the range is cut off with O(log n) rotations, then each element is destroyed
+     * @note a concurrent avl_set, or one with a live snapshot, deletes the elements one by one instead
+     */
+    size_t avl_set_erase_range(struct avl_set *s, const void *from, const void *to);
+
+    /**
+     * @enum avl_layout
+     * @brief order of the slots after avl_set_compact()
+     */
+    enum avl_layout
+    {
+        /** level by level from the root, the top levels share the first cache lines */
+        AVL_LAYOUT_BREADTH_FIRST,
+        /** van Emde Boas, each subtree of a few levels is contiguous, whatever the size of a cache line or a page */
+        AVL_LAYOUT_VAN_EMDE_BOAS
+    };
+
+    /**
+     * @brief renumber the slots of the avl_set so that the nodes met by a lookup are close to each other
+     * @param s target avl_set
+     * @param layout order of the renumbered slots
+     * @return 0 on success, -1 on allocation failure, for a concurrent or mapped avl_set, or while a snapshot is
+     * alive
+     * @note it takes O(n log log n) and a second arena for a while, the avl_set stays mutable; the inline keys and the
+     * cursors got before are invalidated, as by a deletion
+     */
+    int avl_set_compact(struct avl_set *s, enum avl_layout layout);
+
+    /**
+     * @brief move the elements into an arena of their count and release the rest of the memory
+     * @param s target avl_set
+     * @return 0 on success, -1 on allocation failure, for a concurrent or mapped avl_set, or while a snapshot is
+     * alive
+     * @note it takes O(n) and lays out the slots as ::AVL_LAYOUT_BREADTH_FIRST; the inline keys, the values of an
+     * ::avl_map and the cursors got before are invalidated, as by a deletion
+     */
+    int avl_set_shrink_to_fit(struct avl_set *s);
+
+    /**
+     * @struct avl_set_stats
+     * @brief what avl_set_get_stats() reports, the counters stay 0 unless the library is built with AVL_STATS
+     */
+    struct avl_set_stats
+    {
+        /** 1 if the library maintains the counters below, built with AVL_STATS (xmake f --stats=y) */
+        int counting;
+        /** calls of the ::avl_compare by lookups, insertions, deletions, cuts and the set operations */
+        uint64_t compares;
+        /** comparisons decided by the cached key prefixes instead, see avl_config::_key_prefix */
+        uint64_t prefix_decisions;
+        /** single rotations to the right and to the left */
+        uint64_t rotate_right;
+        uint64_t rotate_left;
+        /** double rotations, left-right and right-left */
+        uint64_t rotate_left_right;
+        uint64_t rotate_right_left;
+        /** times the arena grew, and the bytes moved meanwhile: the first segment until it is whole, the directory */
+        uint64_t grows;
+        uint64_t grow_bytes;
+        /** highest height seen after an insertion, or the current one if higher */
+        size_t max_height;
+        /** number of elements and height of the tree */
+        size_t size;
+        size_t height;
+        /** slots of the arena, and the free ones among them */
+        size_t reserve;
+        size_t free_slots;
+        /** bytes held by the arena, and the bytes of the slots of the elements */
+        size_t arena_bytes;
+        size_t live_bytes;
+    };
+
+    /**
+     * @brief read the counters and the shape of the avl_set
+     * @param s target avl_set
+     * @param stats [out] the statistics
+     * @note the structural fields are computed on the fly in O(log n), the counters cost nothing unless AVL_STATS is
+     * defined; the counters of a concurrent avl_set are updated by its readers too
+     */
+    void avl_set_get_stats(struct avl_set *s, struct avl_set_stats *stats);
+
+    /**
+     * @brief walk the whole avl_set and check the AVL invariants
+     * @param s target avl_set
+     * @param depths [optional] depths[d] is set to the number of elements at depth d, the root is at depth 0
+     * @param ndepths number of entries of depths, the deeper elements are not counted
+     * @return 0 if the avl_set is sound, -1 otherwise
+     * @note it checks the order of the elements, the balance factors, the subtree sizes of order statistics, the
+     * links and the size, in O(n); for tests and debugging, never concurrently with a writer
+     */
+    int avl_set_validate(struct avl_set *s, size_t *depths, size_t ndepths);
+
+    /**
+     * @brief take a snapshot of the avl_set, in O(1)
+     * @param s target avl_set, created with ::AVL_SET_SNAPSHOTS
+     * @return the snapshot, NULL if s does not allow snapshots or on allocation failure
+     * @note the snapshot is not changed by the later changes of s, it is released before avl_set_destroy()
+     * @par Example codes
+     * @code {.c}
+        struct avl_snapshot *_snap = avl_set_snapshot(s);
+        avl_set_insert(s, e);
+        struct avl_set_cursor _c;
+        void *_e;
+        for (_e = avl_snapshot_first(_snap, &_c); _e; _e = avl_set_next(&_c))
+        {
+            do_something(_e); // e is not there
+        }
+        avl_set_snapshot_release(_snap);
+     * @endcode
+     */
+    struct avl_snapshot *avl_set_snapshot(struct avl_set *s);
+
+    /**
+     * @brief release a snapshot, the elements only it holds are recycled
+     * @param snap [optional] the snapshot taken by avl_set_snapshot()
+     */
+    void avl_set_snapshot_release(struct avl_snapshot *snap);
+
+    /**
+     * @brief return the number of the elements of a snapshot
+     * @param snap target snapshot
+     * @return a non-negative integer
+     */
+    size_t avl_snapshot_size(const struct avl_snapshot *snap);
+
+    /**
+     * @brief search an element in a snapshot
+     * @param snap target snapshot
+     * @param k the "key" element to be searched
+     * @return wanted element, NULL on not found
+     */
+    void *avl_snapshot_search(const struct avl_snapshot *snap, const void *k);
+
+    /**
+     * @brief position a cursor to the first element of a snapshot
+     * @param snap target snapshot
+     * @param c [out] the cursor, moved on with avl_set_next() and avl_set_prev()
+     * @return the first element, NULL if the snapshot is empty
+     * @note the cursor stays valid across the changes of the avl_set, until the snapshot is released
+     */
+    void *avl_snapshot_first(const struct avl_snapshot *snap, struct avl_set_cursor *c);
+
+    /**
+     * @brief position a cursor to the last element of a snapshot
+     * @param snap target snapshot
+     * @param c [out] the cursor
+     * @return the last element, NULL if the snapshot is empty
+     */
+    void *avl_snapshot_last(const struct avl_snapshot *snap, struct avl_set_cursor *c);
+
+    /**
+     * @brief position a cursor to the first element of a snapshot not less than k
+     * @param snap target snapshot
+     * @param k the "key" element to be compared
+     * @param c [out] the cursor
+     * @return the element found, NULL if every element is less than k
+     */
+    void *avl_snapshot_lower_bound(const struct avl_snapshot *snap, const void *k, struct avl_set_cursor *c);
+
+    /**
+     * @brief position a cursor to the first element of a snapshot greater than k
+     * @param snap target snapshot
+     * @param k the "key" element to be compared
+     * @param c [out] the cursor
+     * @return the element found, NULL if no element is greater than k
+     */
+    void *avl_snapshot_upper_bound(const struct avl_snapshot *snap, const void *k, struct avl_set_cursor *c);
+
+    /**
+     * @brief make a new avl_set of the elements found in a or b
+     * @param a an avl_set, left untouched
+     * @param b an avl_set with the same ::avl_compare and configuration as a, left untouched
+     * @param nthreads upper bound of the threads merging a and b, 0 or 1 to stay on the calling thread
+     * @return the new avl_set, NULL on mismatched or concurrent sets, or on allocation failure
+     * @warning unless the keys are inline (avl_config::_key_size), the new avl_set points to the keys of a and b and
+     * destroys none of them: it must be destroyed before a or b destroys those keys, by a deletion or a clear, or by
+     * avl_set_destroy() with an ::avl_destruct; inline keys and the values are copied
+     * @note the new avl_set takes the configuration of a, without its ::avl_destruct
+     * @note of two equal elements the one of b is taken, as if each element of b were inserted into a
+     * @note the work is O(m + n) for the sizes m and n of a and b; the merge and the copy of the elements are split
+     * evenly among the threads, the new tree is then linked on the calling thread in O(m + n) without comparison;
+     * an element left out of an intersection or a difference is skipped in O(1) next to the others and O(log n)
+     * away from them
+     * @note with nthreads > 1 the ::avl_compare is called from several threads at the same time
+     */
+    struct avl_set *avl_set_union(struct avl_set *a, struct avl_set *b, unsigned int nthreads);
+
+    /**
+     * @brief make a new avl_set of the elements found in both a and b
+     * @param a an avl_set, left untouched
+     * @param b an avl_set with the same ::avl_compare and configuration as a, left untouched
+     * @param nthreads upper bound of the threads merging a and b, 0 or 1 to stay on the calling thread
+     * @return the new avl_set, NULL on mismatched or concurrent sets, or on allocation failure
+     * @warning unless the keys are inline (avl_config::_key_size), the new avl_set points to the keys of a and b and
+     * destroys none of them: it must be destroyed before a or b destroys those keys, by a deletion or a clear, or by
+     * avl_set_destroy() with an ::avl_destruct; inline keys and the values are copied
+     * @note the elements of b are taken
+     * @see avl_set_union
+     */
+    struct avl_set *avl_set_intersection(struct avl_set *a, struct avl_set *b, unsigned int nthreads);
+
+    /**
+     * @brief make a new avl_set of the elements of a which are not found in b
+     * @param a an avl_set, left untouched
+     * @param b an avl_set with the same ::avl_compare and configuration as a, left untouched
+     * @param nthreads upper bound of the threads merging a and b, 0 or 1 to stay on the calling thread
+     * @return the new avl_set, NULL on mismatched or concurrent sets, or on allocation failure
+     * @warning unless the keys are inline (avl_config::_key_size), the new avl_set points to the keys of a and b and
+     * destroys none of them: it must be destroyed before a or b destroys those keys, by a deletion or a clear, or by
+     * avl_set_destroy() with an ::avl_destruct; inline keys and the values are copied
+     * @see avl_set_union
+     */
+    struct avl_set *avl_set_difference(struct avl_set *a, struct avl_set *b, unsigned int nthreads);
+
+    /**
+     * @brief count the elements which are less than k, in O(log n)
+     * @param s target avl_set, created with ::AVL_SET_ORDER_STATISTICS
+     * @param k the "key" element to be compared
+     * @param rank [out] number of the elements less than k
+     * @return 0 on success, -1 if the avl_set does not keep order statistics
+     */
+    int avl_set_rank(struct avl_set *s, const void *k, size_t *rank);
+
+    /**
+     * @brief find the i-th smallest element, in O(log n)
+     * @param s target avl_set, created with ::AVL_SET_ORDER_STATISTICS
+     * @param i zero-based index in the order of the avl_set
+     * @param c [optional] cursor to be positioned at the element
+     * @return the element found, NULL if i is out of range or the avl_set does not keep order statistics
+     */
+    void *avl_set_select(struct avl_set *s, size_t i, struct avl_set_cursor *c);
+
+    /**
+     * @brief count the elements in the range [from, to), in O(log n)
+     * @param s target avl_set, created with ::AVL_SET_ORDER_STATISTICS
+     * @param from lower bound of the range, inclusive
+     * @param to upper bound of the range, exclusive
+     * @param count [out] number of the elements in the range
+     * @return 0 on success, -1 if the avl_set does not keep order statistics
+     */
+    int avl_set_count_range(struct avl_set *s, const void *from, const void *to, size_t *count);
+
+    /**
+     * @brief write the avl_set into a file to be opened by avl_set_open_mmap()
+     * @param s target avl_set, with inline keys (a non-zero _key_size of ::avl_config)
+     * @param path the file to be written, replaced if it exists
+     * @return 0 on success, -1 without inline keys or on I/O failure (a previous file at path is left as it is)
+     * @note the elements go into a new file next to path, renamed over path once written, the processes which
+     * opened the previous file with avl_set_open_mmap() keep reading it until they destroy their avl_set
+     * @note the elements are written in order as a perfectly balanced tree, in O(n) with one slot of memory; the
+     * file is read back only on a host with the same byte order and word size
+     */
+    int avl_set_save(struct avl_set *s, const char *path);
+
+    /**
+     * @brief open a file written by avl_set_save() as a read-only avl_set, mapping it instead of reading it
+     * @param path the file to be opened
+     * @param cmp [<b>mandatory</b>] compare function between set elements, the same as for the saved avl_set
+     * @return pointer of the opened avl_set, NULL on I/O failure or on a file of another format
+     * @note the lookups, the cursors and the order statistics are served from the mapped pages, in O(1) time to
+     * open; the processes opening the same file share its pages
+     * @note insertions fail as on allocation failure, deletions as on not found, avl_set_clear() does nothing;
+     * avl_set_destroy() unmaps the file, which must not be truncated meanwhile
+     */
+    struct avl_set *avl_set_open_mmap(const char *path, avl_compare cmp);
+
+/**
+ * @brief option of avl_set_serialize(), write each key as the length of the prefix it shares with the previous key
+ * and the rest of its bytes
+ */
+#define AVL_STREAM_FRONT_CODING (1u << 0)
+
+    /**
+     * @brief write function pointer, consumes the bytes of a serialized avl_set
+     * @param ctx the context given to avl_set_serialize()
+     * @param buf the bytes to be written, at most one chunk
+     * @param n number of the bytes
+     * @return 0 on success, non-zero to abort the serialization
+     */
+    typedef int (*avl_write)(void *ctx, const void *buf, size_t n);
+
+    /**
+     * @brief read function pointer, produces the bytes of a serialized avl_set
+     * @param ctx the context given to avl_set_deserialize()
+     * @param buf [out] room for the bytes read
+     * @param n room of buf, at most one chunk
+     * @return number of the bytes read, 0 at the end of the stream or on error
+     */
+    typedef size_t (*avl_read)(void *ctx, void *buf, size_t n);
+
+    /**
+     * @brief key encode function pointer, turns a key into bytes ordered as the keys
+     * @param k the key, as passed to the ::avl_compare
+     * @param buf [out] room for the bytes, NULL if cap is 0
+     * @param cap room of buf
+     * @return number of the bytes of k, written into buf only if they fit in cap
+     */
+    typedef size_t (*avl_key_encode)(const void *k, void *buf, size_t cap);
+
+    /**
+     * @brief key decode function pointer, turns the bytes written by an ::avl_key_encode back into a key
+     * @param buf the bytes
+     * @param n number of the bytes
+     * @return the key as passed to avl_set_insert(), NULL on error; with inline keys, it is only read before the
+     * next call
+     */
+    typedef void *(*avl_key_decode)(const void *buf, size_t n);
+
+    /**
+     * @brief stream the keys of the avl_set in order, through chunks of bounded size
+     * @param s target avl_set
+     * @param write called on each chunk
+     * @param ctx passed to write
+     * @param encode [optional] key encoder, the key_size bytes of an inline key are written as they are without it
+     * @param options bitwise OR of AVL_STREAM_* options
+     * @return 0 on success, -1 on allocation or write failure, or without encode for a set of pointers
+     * @note besides the chunk, the memory used is two encoded keys
+     */
+    int avl_set_serialize(struct avl_set *s, avl_write write, void *ctx, avl_key_encode encode, unsigned int options);
+
+    /**
+     * @brief create an avl_set from a stream written by avl_set_serialize(), in linear time
+     * @param read called for each chunk
+     * @param ctx passed to read
+     * @param decode [optional] key decoder, required unless cfg has inline keys
+     * @param cmp [<b>mandatory</b>] compare function between set elements
+     * @param dtor [optional] destructor for set elements
+     * @param cfg [optional] customizable configuration
+     * @return pointer of the created avl_set, NULL on allocation failure or on a broken or unsorted stream
+     * @note the keys are stored in order and linked into a balanced tree at the end, without any comparison but
+     * one per key to check the order; the keys decoded before an error are destroyed
+     * @note the arena grows with the keys read, the count written in the stream only bounds them, so a broken
+     * stream costs no more memory than the bytes it holds
+     */
+    struct avl_set *avl_set_deserialize(avl_read read, void *ctx, avl_key_decode decode, avl_compare cmp,
+                                        avl_destruct dtor, const struct avl_config *cfg);
+
+    /**
+     * @struct avl_sharded_set
+     * @brief forward declaration, keys partitioned over avl_set shards, each behind its own lock
+     * @note the writers of different shards do not wait for each other, a shard is one plain avl_set
+     */
+    struct avl_sharded_set;
+
+    /**
+     * @brief hash function pointer, partitions the keys of an avl_sharded_set
+     * @param k the key to be hashed
+     * @return any integer, equal keys have equal hashes
+     */
+    typedef size_t (*avl_hash)(const void *k);
+
+    /**
+     * @brief visit function pointer, called on each element of an avl_sharded_set in order
+     * @param e the element
+     * @param arg the argument given to avl_sharded_set_foreach()
+     * @return 0 to go on, non-zero to stop
+     */
+    typedef int (*avl_visit)(void *e, void *arg);
+
+    /**
+     * @brief create an avl_sharded_set partitioned by a hash function
+     * @param cmp [<b>mandatory</b>] compare function between set elements
+     * @param dtor [optional] destructor for set elements
+     * @param hash hash function, the shard of k is hash(k) % nshards; optional with one shard
+     * @param nshards number of the shards, a few times the number of the writer threads
+     * @param cfg [optional] customizable configuration of the shards, _reserve is the total of all the shards
+     * @return pointer of the created avl_sharded_set, NULL on error or with ::AVL_SET_CONCURRENT
+     */
+    struct avl_sharded_set *avl_sharded_set_create(avl_compare cmp, avl_destruct dtor, avl_hash hash,
+                                                   size_t nshards, const struct avl_config *cfg);
+
+    /**
+     * @brief create an avl_sharded_set partitioned by ranges of keys
+     * @param cmp [<b>mandatory</b>] compare function between set elements
+     * @param dtor [optional] destructor for set elements
+     * @param bounds nbounds keys in ascending order, the i-th shard holds the keys in [bounds[i - 1], bounds[i]),
+     * the pointers are kept as they are
+     * @param nbounds number of the bounds, there are nbounds + 1 shards
+     * @param cfg [optional] customizable configuration of the shards, _reserve is the total of all the shards
+     * @return pointer of the created avl_sharded_set, NULL on error or with ::AVL_SET_CONCURRENT
+     */
+    struct avl_sharded_set *avl_sharded_set_create_ranges(avl_compare cmp, avl_destruct dtor, void *const *bounds,
+                                                          size_t nbounds, const struct avl_config *cfg);
+
+    /**
+     * @brief destroy the avl_sharded_set (and remove all its elements)
+     * @param ss target avl_sharded_set, no other thread uses it anymore
+     */
+    void avl_sharded_set_destroy(struct avl_sharded_set *ss);
+
+    /**
+     * @brief return the number of the avl_sharded_set elements
+     * @param ss target avl_sharded_set
+     * @return a non-negative integer, the shards are counted one after another
+     */
+    size_t avl_sharded_set_size(struct avl_sharded_set *ss);
+
+    /**
+     * @brief insert an element into its shard, thread-safe
+     * @param ss target avl_sharded_set
+     * @param k the element to be inserted
+     * @return 0 on success, 1 on duplicated, -1 on allocation failure
+     * @note duplicated element will be destroyed
+     */
+    int avl_sharded_set_insert(struct avl_sharded_set *ss, void *k);
+
+    /**
+     * @brief delete an element from its shard, thread-safe
+     * @param ss target avl_sharded_set
+     * @param k the element to be deleted
+     * @return 0 on success, -1 on not found
+     */
+    int avl_sharded_set_delete(struct avl_sharded_set *ss, const void *k);
+
+    /**
+     * @brief look an element up in its shard, thread-safe
+     * @param ss target avl_sharded_set
+     * @param k the "key" element to be searched
+     * @return 1 if found, 0 otherwise
+     * @note the element itself is not returned, another thread may delete it at any time
+     */
+    int avl_sharded_set_contains(struct avl_sharded_set *ss, const void *k);
+
+    /**
+     * @brief visit all the elements in order, merged across the shards
+     * @param ss target avl_sharded_set
+     * @param visit called on each element, stops the walk by returning non-zero
+     * @param arg passed to visit
+     * @return number of the visited elements
+     * @note every shard is locked during the walk, visit must not change ss
+     */
+    size_t avl_sharded_set_foreach(struct avl_sharded_set *ss, avl_visit visit, void *arg);
+
+    /**
+     * @struct avl_map
+     * @brief forward declaration, an avl_set with a value stored next to each key
+     */
+    struct avl_map;
+
+    /**
+     * @brief create an avl_map
+     * @param cmp [<b>mandatory</b>] compare function between keys
+     * @param kdtor [optional] destructor for keys
+     * @param vdtor [optional] destructor for values, called with the address of the value storage
+     * @param value_size bytes of a value, 0 for a pointer-sized value
+     * @param cfg [optional] customizable configuration
+     * @return pointer of the created avl_map, NULL on error
+     * @see avl_set_create
+     * @par Example codes
+     * @code
+        struct avl_map *m = avl_map_create(my_key_compare, free, NULL, sizeof(double), NULL);
+        double v = 3.14;
+        avl_map_put(m, strdup("pi"), &v);
+        double *pv = (double *)avl_map_get(m, "pi");
+     * @endcode
+     */
+    struct avl_map *avl_map_create(avl_compare cmp, avl_destruct kdtor, avl_destruct vdtor, size_t value_size,
+                                   const struct avl_config *cfg);
+
+    /**
+     * @brief return the number of the avl_map entries
+     * @param m target avl_map
+     * @return a non-negative integer
+     */
+    size_t avl_map_size(const struct avl_map *m);
+
+    /**
+     * @brief remove all the entries and destroy them with the ::avl_destruct
+     * @param m target avl_map
+     */
+    void avl_map_clear(struct avl_map *m);
+
+    /**
+     * @brief destroy the avl_map (and remove all its entries)
+     * @param m target avl_map
+     */
+    void avl_map_destroy(struct avl_map *m);
+
+    /**
+     * @brief search the value of a key
+     * @param m target avl_map
+     * @param k the key to be searched
+     * @return address of the value storage, NULL on not found
+     * @note the address is valid until the next insertion into or deletion from the avl_map, shrink or compaction;
+     * with _shrink_percent set, deleting any key may move some of the others
+     */
+    void *avl_map_get(struct avl_map *m, const void *k);
+
+    /**
+     * @brief insert or replace an entry
+     * @param m target avl_map
+     * @param k the key to be inserted
+     * @param v address of the value, value_size bytes are copied
+     * @return 0 on success, 1 on duplicated, -1 on allocation failure
+     * @note the duplicated key and its value will be destroyed
+     */
+    int avl_map_put(struct avl_map *m, void *k, const void *v);
+
+    /**
+     * @brief delete an entry
+     * @param m target avl_map
+     * @param k the key to be deleted
+     * @return 0 on success, -1 on not found
+     */
+    int avl_map_erase(struct avl_map *m, const void *k);
+
+    /**
+     * @brief search the value of a key, insert the key with a zero-filled value if it is absent
+     * @param m target avl_map
+     * @param k the key to be searched or inserted
+     * @param inserted [optional] set to 1 if k is inserted, otherwise k is still owned by the caller
+     * @return address of the value storage, NULL on allocation failure
+     * @note the address is valid until the next insertion into or deletion from the avl_map, shrink or compaction;
+     * with _shrink_percent set, deleting any key may move some of the others
+     */
+    void *avl_map_get_or_insert(struct avl_map *m, void *k, int *inserted);
+
 #if defined(__cplusplus)
 }
 #endif
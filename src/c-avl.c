@@ -19,630 +19,5320 @@
   THE SOFTWARE.
 */
 
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+/*! @note anonymous mappings, madvise() and syscall() are not in strict ANSI or POSIX */
+#define _DEFAULT_SOURCE
+#endif
+
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "c-avl.h"
 
-#define _AVL_MAX(a, b) ((a) > (b) ? (a) : (b))
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#define _AVL_HAVE_PTHREAD
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define _AVL_HAVE_MMAP
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+/*! @note the arena policies map anonymous memory, with huge pages and NUMA placement where available */
+#define _AVL_HAVE_ARENA_POLICY
+#endif
+
+#if defined(__GNUC__)
+/*! @note AVL_SET_CONCURRENT relies on the __atomic builtins */
+#define _AVL_HAVE_ATOMIC
+#endif
+
+#ifdef _AVL_HAVE_ATOMIC
+#define _AVL_LOAD(p, order) __atomic_load_n((p), (order))
+#define _AVL_STORE(p, v, order) __atomic_store_n((p), (v), (order))
+#define _AVL_FENCE(order) __atomic_thread_fence(order)
+#else
+#define _AVL_LOAD(p, order) (*(p))
+#define _AVL_STORE(p, v, order) ((void)(*(p) = (v)))
+#define _AVL_FENCE(order) ((void)0)
+#endif
+
 #define _AVL_DEFAULT_RESERVE (8)
+#define _AVL_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define _AVL_ALIGN(n, a) (((n) + (a)-1) / (a) * (a))
+/*! @brief number of lookups advanced together by avl_set_search_batch() */
+#define _AVL_BATCH_WIDTH (16)
+/*! @brief upper bound of the worker threads of a set operation */
+#define _AVL_MAX_THREADS (64)
+/*! @brief a set operation does not spawn a thread for less elements */
+#define _AVL_MIN_TASK_SIZE (4096)
+/*! @brief bytes of a cache line, the writer counters and each reader record have their own */
+#define _AVL_CACHE_LINE (64)
+/*! @brief upper bound of the registered readers of a concurrent set */
+#define _AVL_MAX_READERS (128)
+/*! @brief retired slots piled up before the writer tries to reclaim them */
+#define _AVL_RECLAIM_THRESHOLD (64)
+/*! @brief spins of a reader waiting for the writer to finish a change before it yields the processor */
+#define _AVL_SPIN_LIMIT (64)
+/*! @brief steps of the drain of a shrinking arena paid by each deletion, see __avl_set_drain() */
+#define _AVL_DRAIN_STEPS (16)
+/*! @brief ancestors read from a hint before the retrace climbs any higher, see __avl_set_attach() */
+#define _AVL_RETRACE_CHUNK (4)
+/*! @brief bytes of a huge page, the size and the alignment of a huge-page arena are multiples of it */
+#define _AVL_HUGE_PAGE ((size_t)2 * 1024 * 1024)
+/*! @brief memory policies of mbind(2), from linux/mempolicy.h */
+#define _AVL_MPOL_BIND (2)
+#define _AVL_MPOL_INTERLEAVE (3)
+/*! @brief bytes of a segment of the arena at least, a growth adds one segment and moves no element */
+#define _AVL_SEGMENT_BYTES ((size_t)64 * 1024)
+
+#if defined(__GNUC__)
+#define _AVL_PREFETCH(p) __builtin_prefetch((p), 0, 1)
+#else
+#define _AVL_PREFETCH(p) ((void)(p))
+#endif
+/*! @brief the empty link */
+#define _AVL_NIL ((uint32_t)0x7FFFFFFFu)
+/*! @brief mask of the slot index within a link */
+#define _AVL_LINK_MASK ((uint32_t)0x7FFFFFFFu)
+/*! @brief top bit of a link, marks the higher subtree */
+#define _AVL_HEAVY_BIT ((uint32_t)0x80000000u)
+/*! @brief slot indices must stay below _AVL_NIL */
+#define _AVL_MAX_SLOTS ((size_t)_AVL_NIL)
 
 typedef void (*avl_deallocate)(void *);
 
 /*! @struct avl_node */
 typedef struct _avl_node
 {
-    /*! left child */
-    uintptr_t left;
-    /*! right child */
-    uintptr_t right;
-    /*! height */
-    int height;
+    /*! left child slot, the top bit is set when the left subtree is higher */
+    uint32_t left;
+    /*! right child slot, the top bit is set when the right subtree is higher */
+    uint32_t right;
 } avl_node;
 
-static int _avl_height(avl_node *n)
-{
-    return n ? n->height : 0;
-}
-
-static void _avl_update_height(avl_node *n)
-{
-    if (n)
-    {
-        n->height = _AVL_MAX(_avl_height((avl_node *)(n->left)), _avl_height((avl_node *)(n->right))) + 1;
-    }
-}
-
-static int __avl_balance_factor(avl_node *n)
+static uint32_t _avl_left(const avl_node *n)
 {
-    return n ? (_avl_height((avl_node *)(n->left)) - _avl_height((avl_node *)(n->right))) : 0;
+    return n->left & _AVL_LINK_MASK;
 }
 
-static avl_node *avl_single_rotate_right(avl_node *root)
+static uint32_t _avl_right(const avl_node *n)
 {
-    avl_node *left = (avl_node *)(root->left);
-    root->left = left->right;
-    left->right = (uintptr_t)root;
-    _avl_update_height(root);
-    _avl_update_height(left);
-    return left;
+    return n->right & _AVL_LINK_MASK;
 }
 
-static avl_node *avl_single_rotate_left(avl_node *root)
+/*! @note the links are stored atomically for the readers of a concurrent set, ordered by the fence of the change */
+static void _avl_set_left(avl_node *n, uint32_t i)
 {
-    avl_node *right = (avl_node *)(root->right);
-    root->right = right->left;
-    right->left = (uintptr_t)root;
-    _avl_update_height(root);
-    _avl_update_height(right);
-    return right;
+    _AVL_STORE(&n->left, (n->left & _AVL_HEAVY_BIT) | i, __ATOMIC_RELAXED);
 }
 
-typedef struct _avl_stack
-{
-    size_t size;
-    size_t tail;
-    size_t array[];
-} avl_stack;
-
-static int __avl_stack_pop(size_t *e, avl_stack *s)
+static void _avl_set_right(avl_node *n, uint32_t i)
 {
-    if (s->tail == 0)
-    {
-        return -1;
-    }
-
-    s->tail--;
-    if (e)
-    {
-        *e = s->array[s->tail];
-    }
-    return 0;
+    _AVL_STORE(&n->right, (n->right & _AVL_HEAVY_BIT) | i, __ATOMIC_RELAXED);
 }
 
-static void __avl_stack_push(avl_stack *s, size_t e)
+/*! @brief height(left) - height(right), one of -1, 0, 1 */
+static int __avl_balance_factor(const avl_node *n)
 {
-    assert(s);
-    s->array[s->tail] = e;
-    s->tail++;
+    return (int)(n->left >> 31) - (int)(n->right >> 31);
 }
 
-static void __avl_stack_clear(avl_stack *s)
+static void __avl_set_balance_factor(avl_node *n, int bf)
 {
-    assert(s);
-    s->tail = 0;
+    _AVL_STORE(&n->left, (n->left & _AVL_LINK_MASK) | (bf > 0 ? _AVL_HEAVY_BIT : 0), __ATOMIC_RELAXED);
+    _AVL_STORE(&n->right, (n->right & _AVL_LINK_MASK) | (bf < 0 ? _AVL_HEAVY_BIT : 0), __ATOMIC_RELAXED);
 }
 
-static size_t __avl_stack_bytesize(const avl_stack *s)
+/*! @struct avl_slots */
+typedef struct _avl_slots
 {
-    assert(s);
-    return sizeof(avl_stack) + sizeof(size_t) * s->size;
-}
+    /*! last released slot, each released slot links the previous one through its left link, _AVL_NIL if none */
+    uint32_t head;
+    /*! the slots from mark up to the reserve have never been used */
+    size_t mark;
+    /*! count of the free slots, released or never used */
+    size_t avail;
+    /*! while the arena drains, the slots from limit up are emptied before they are cut off, 0 otherwise */
+    size_t limit;
+    /*! last released slot known to lie below the limit, the ones after it are still to be sorted, _AVL_NIL if none */
+    uint32_t sorted;
+    /*! released slots from the limit up, linked like the others and set apart until the cut */
+    uint32_t spill;
+    /*! first slot of the spill, linked back to the others when the drain gives up */
+    uint32_t spill_tail;
+    /*! the slots [limit, scan) may still hold elements, they are moved below the limit once the sort is done */
+    size_t scan;
+} avl_slots;
 
-/*! @struct avl_set_element */
-typedef struct _avl_set_element
+/*! @struct avl_set */
+#if defined(AVL_STATS)
+/*! @brief counters of avl_set_get_stats(), maintained only when built with AVL_STATS */
+typedef struct _avl_stats
 {
-    /* data */
-    avl_node node;
-    uintptr_t key;
-} avl_set_element;
+    uint64_t compares;
+    /*! comparisons decided by the cached key prefixes, without calling the comparator */
+    uint64_t prefix_decisions;
+    /*! single right, single left, double left-right, double right-left */
+    uint64_t rotations[4];
+    uint64_t grows;
+    uint64_t grow_bytes;
+    size_t max_height;
+} avl_stats;
+#endif
 
-/*! @struct avl_set */
 struct avl_set
 {
     /* data */
     avl_compare _compare;
     avl_destruct _key_destruct;
+    avl_destruct _value_destruct;
     struct avl_config _config;
     size_t _size;
-    size_t _rindex;
-    avl_stack *_slots;
-    avl_set_element *_tree;
+    uint32_t _rindex;
+    /*! changes made to the links so far, from 1, a hint left by avl_set_insert_hint() is trusted while it is kept */
+    size_t _version;
+    /*! bytes of one slot: avl_node, subtree size (optional), key, value (map only) */
+    size_t _stride;
+    /*! offset of the subtree size in a slot, 0 if not maintained */
+    size_t _count_off;
+    /*! offset of the cached prefix of the key in a slot, 0 unless avl_config::_key_prefix is set */
+    size_t _prefix_off;
+    /*! offset of the key in a slot */
+    size_t _key_off;
+    /*! bytes of an inline key, 0 if the slot holds a pointer to the key */
+    size_t _key_size;
+    /*! offset of the value in a slot */
+    size_t _value_off;
+    /*! bytes of the value, 0 for a set */
+    size_t _value_size;
+    /*! free slots, kept in the arena itself */
+    avl_slots _slots;
+    /**
+     * the arena, slot i lives in segment i >> _seg_shift, the first segment alone is smaller while it is the last;
+     * each entry is biased by the bytes of the slots before its segment, slot i is at _segs[i >> _seg_shift] plus
+     * i * _stride
+     */
+    uint8_t **_segs;
+    size_t _segs_cap;
+    size_t _seg_shift;
+    size_t _seg_mask;
+    /*! reader registry and retired slots, NULL unless AVL_SET_CONCURRENT */
+    struct _avl_sync *_sync;
+    /*! offset of the version a slot was written at, 0 unless AVL_SET_SNAPSHOTS */
+    size_t _birth_off;
+    /*! live snapshots and the slots they hold, NULL unless AVL_SET_SNAPSHOTS */
+    struct _avl_snap *_snap;
+    /*! file mapping holding a read-only arena, NULL unless opened by avl_set_open_mmap() */
+    void *_map;
+    size_t _map_bytes;
+    /*! copy of the last inline key handed to the caller by avl_set_extract() or ::AVL_ASSIGN_DETACH */
+    void *_handed;
+#if defined(AVL_STATS)
+    avl_stats _stats;
+#endif
 };
 
-struct avl_set *avl_set_create(avl_compare cmp, avl_destruct kdtor, const struct avl_config *cfg)
+#define _AVL_ELEM(s, i) \
+    ((uint8_t *)((uintptr_t)(s)->_segs[(size_t)(i) >> (s)->_seg_shift] + (size_t)(i) * (s)->_stride))
+#define _AVL_NODE(s, i) ((avl_node *)_AVL_ELEM(s, i))
+#define _AVL_KEY(s, i) (*(uintptr_t *)(_AVL_ELEM(s, i) + (s)->_key_off))
+#define _AVL_INLINE_KEY(s, i) ((void *)(_AVL_ELEM(s, i) + (s)->_key_off))
+#define _AVL_COUNT(s, i) (*(uint32_t *)(_AVL_ELEM(s, i) + (s)->_count_off))
+#define _AVL_VALUE(s, i) ((void *)(_AVL_ELEM(s, i) + (s)->_value_off))
+#define _AVL_BIRTH(s, i) (*(uint32_t *)(_AVL_ELEM(s, i) + (s)->_birth_off))
+#define _AVL_PREFIX(s, i) (*(uint64_t *)(_AVL_ELEM(s, i) + (s)->_prefix_off))
+
+#if defined(AVL_STATS)
+/*! @note readers of a concurrent set and the threads of a set operation count their comparisons as well */
+static void __avl_stat_add(const struct avl_set *s, uint64_t *c, uint64_t n)
 {
-    if (NULL == cmp)
+    (void)s;
+#ifdef _AVL_HAVE_ATOMIC
+    __atomic_fetch_add(c, n, __ATOMIC_RELAXED);
+#else
+    *c += n;
+#endif
+}
+#define _AVL_STAT(s, field, n) __avl_stat_add((s), &(s)->_stats.field, (uint64_t)(n))
+#else
+#define _AVL_STAT(s, field, n) ((void)0)
+#endif
+#define _AVL_COMPARE(s, a, b) (_AVL_STAT(s, compares, 1), (s)->_compare((a), (b)))
+
+/*! @brief a released slot from the limit of a draining arena up, its empty heavy right link tells it from an element */
+static void __avl_set_spill_slot(struct avl_set *s, uint32_t e)
+{
+    avl_slots *f = &s->_slots;
+    avl_node *n = _AVL_NODE(s, e);
+    n->left = f->spill;
+    n->right = _AVL_NIL | _AVL_HEAVY_BIT;
+    if (_AVL_NIL == f->spill)
     {
-        return NULL;
+        f->spill_tail = e;
     }
+    f->spill = e;
+}
 
-    struct avl_config _config = {
-        ._alloc = malloc,
-        ._dealloc = free,
-        ._reserve = _AVL_DEFAULT_RESERVE};
+/*! @brief stop draining the arena, the spilled slots are handed out again */
+static void __avl_set_undrain(struct avl_set *s)
+{
+    avl_slots *f = &s->_slots;
+    if (_AVL_NIL != f->spill)
+    {
+        _AVL_NODE(s, f->spill_tail)->left = f->head;
+        f->head = f->spill;
+    }
+    f->limit = 0;
+    f->sorted = _AVL_NIL;
+    f->spill = _AVL_NIL;
+    f->spill_tail = _AVL_NIL;
+}
 
-    if (cfg)
+/*! @brief take a free slot, the last released one while it is still in cache, _AVL_NIL if none */
+static uint32_t __avl_set_take_slot(struct avl_set *s)
+{
+    avl_slots *f = &s->_slots;
+    uint32_t e = _AVL_NIL;
+    if (_AVL_NIL != f->head)
     {
-        if (cfg->_alloc && cfg->_dealloc)
-        {
-            _config._alloc = cfg->_alloc;
-            _config._dealloc = cfg->_dealloc;
-        }
-        if (cfg->_reserve > 0)
+        e = f->head;
+        f->head = _AVL_NODE(s, e)->left;
+        _AVL_NODE(s, e)->left = 0;
+        _AVL_NODE(s, e)->right = 0;
+        if (e == f->sorted)
         {
-            _config._reserve = cfg->_reserve;
+            /*! @note the sort starts over from the slots released since */
+            f->sorted = _AVL_NIL;
         }
     }
+    else if (f->mark < (f->limit ? f->limit : s->_config._reserve))
+    {
+        e = (uint32_t)f->mark++;
+    }
+    else if (f->limit)
+    {
+        /*! @note no room is left below the limit, the drain gives up */
+        __avl_set_undrain(s);
+        return __avl_set_take_slot(s);
+    }
+    else
+    {
+        return _AVL_NIL;
+    }
+    f->avail--;
+    return e;
+}
 
-    struct avl_set *_s = (struct avl_set *)(_config._alloc(sizeof(struct avl_set)));
-    if (NULL == _s)
+/*! @brief give slot e, zeroed, back to the free slots */
+static void __avl_set_put_slot(struct avl_set *s, uint32_t e)
+{
+    avl_slots *f = &s->_slots;
+    if (f->limit && e >= f->limit)
     {
-        /*! @note panic */
-        return NULL;
+        __avl_set_spill_slot(s, e);
+    }
+    else
+    {
+        _AVL_NODE(s, e)->left = f->head;
+        f->head = e;
     }
+    f->avail++;
+}
 
-    memset(_s, 0, sizeof(struct avl_set));
-    /*! @brief initialization */
-    _s->_compare = cmp;
-    _s->_config = _config;
-    _s->_key_destruct = kdtor;
-    _s->_rindex = 0;
-    _s->_size = 0;
+/*! @brief the slots [0, n) are taken, the others have never been used */
+static void __avl_set_reset_slots(struct avl_set *s, size_t n)
+{
+    s->_slots.head = _AVL_NIL;
+    s->_slots.mark = n;
+    s->_slots.avail = s->_config._reserve - n;
+    s->_slots.limit = 0;
+    s->_slots.sorted = _AVL_NIL;
+    s->_slots.spill = _AVL_NIL;
+    s->_slots.spill_tail = _AVL_NIL;
+}
+
+/*! @struct avl_map */
+struct avl_map
+{
+    /*! a map is a set with a value stored next to each key */
+    struct avl_set _set;
+};
 
-    size_t _bytes = sizeof(avl_set_element) * _config._reserve;
-    _s->_tree = (avl_set_element *)(_config._alloc(_bytes));
-    memset(_s->_tree, 0, _bytes);
+/*! @brief the key held by slot e, as passed to the ::avl_compare */
+static void *__avl_key(const struct avl_set *s, uint32_t e)
+{
+    return s->_key_size ? _AVL_INLINE_KEY(s, e) : (void *)_AVL_KEY(s, e);
+}
+
+/*! @brief the key held by the slot at self, saves locating the slot again */
+static void *__avl_key_at(const struct avl_set *s, const avl_node *self)
+{
+    const uint8_t *_at = (const uint8_t *)self + s->_key_off;
+    return s->_key_size ? (void *)_at : (void *)*(const uintptr_t *)_at;
+}
 
-    /*! @note create a stack to record available slots */
-    avl_stack *_stack = (avl_stack *)(_config._alloc(sizeof(avl_stack) + sizeof(size_t) * _config._reserve));
-    _stack->size = _config._reserve;
-    _stack->tail = 0;
+/**
+ * @brief the root as a reader sees it
+ * @note on a concurrent set the acquire loads of the root and of the links order the loads of the directory and
+ * of the slots they lead to, a weakly ordered CPU could otherwise index an older directory with a newer link
+ */
+static uint32_t __avl_set_read_root(const struct avl_set *s)
+{
+    return s->_sync ? _AVL_LOAD(&s->_rindex, __ATOMIC_ACQUIRE) : s->_rindex;
+}
 
-    size_t i;
-    for (i = _config._reserve; i != 0; i--)
+/*! @brief the child of n on the left (dir < 0) or right side as a reader sees it */
+static uint32_t __avl_set_read_link(const struct avl_set *s, const avl_node *n, int dir)
+{
+    const uint32_t *_link = (0 > dir) ? &n->left : &n->right;
+    return (s->_sync ? _AVL_LOAD(_link, __ATOMIC_ACQUIRE) : *_link) & _AVL_LINK_MASK;
+}
+
+/**
+ * @brief the node of slot e as a reader sees it
+ * @return NULL on a torn read of a concurrent set, which fails its validation and is retried
+ */
+static avl_node *__avl_set_read_node(const struct avl_set *s, uint32_t e)
+{
+    if (NULL == s->_sync)
     {
-        __avl_stack_push(_stack, i - 1);
+        return _AVL_NODE(s, e);
     }
-    _s->_slots = _stack;
-    return _s;
+    /*! @note the writer stores the directory before its capacity */
+    size_t _cap = _AVL_LOAD(&s->_segs_cap, __ATOMIC_ACQUIRE);
+    uint8_t **_segs = _AVL_LOAD(&s->_segs, __ATOMIC_ACQUIRE);
+    size_t k = (size_t)e >> s->_seg_shift;
+    uint8_t *_seg = (k < _cap) ? _AVL_LOAD(&_segs[k], __ATOMIC_ACQUIRE) : NULL;
+    return _seg ? (avl_node *)(_seg + (size_t)e * s->_stride) : NULL;
 }
 
-size_t avl_set_size(const struct avl_set *s)
+/*! @brief the element of slot e as a reader sees it, NULL on a torn read */
+static void *__avl_set_read_key(const struct avl_set *s, uint32_t e)
 {
-    return s->_size;
+    const avl_node *n = __avl_set_read_node(s, e);
+    return n ? __avl_key_at(s, n) : NULL;
 }
 
-void avl_set_clear(struct avl_set *s)
+/*! @brief the size of the subtree at e as a reader sees it, 0 on a torn read */
+static size_t __avl_set_read_count(const struct avl_set *s, uint32_t e)
 {
-    if (s)
+    const avl_node *n = (_AVL_NIL == e) ? NULL : __avl_set_read_node(s, e);
+    return n ? *(const uint32_t *)((const uint8_t *)n + s->_count_off) : 0;
+}
+
+/*! @brief the prefix of k, 0 unless the set caches the prefixes of its keys */
+static uint64_t __avl_set_prefix(const struct avl_set *s, const void *k)
+{
+    return s->_prefix_off ? s->_config._key_prefix(k) : 0;
+}
+
+/**
+ * @brief compare k with the key held by the slot at self
+ * @param kp prefix of k, from __avl_set_prefix()
+ * @note the ::avl_compare is called only on equal prefixes, the prefix lies in the cache line of the node
+ */
+static int __avl_set_compare_at(struct avl_set *s, const void *k, uint64_t kp, const avl_node *self)
+{
+    if (s->_prefix_off)
     {
-        avl_destruct _d = s->_key_destruct;
-        size_t i;
-        for (i = 0; i < s->_size; i++)
+        uint64_t _p = *(const uint64_t *)((const uint8_t *)self + s->_prefix_off);
+        if (kp != _p)
         {
-            void *_key = (void *)(s->_tree[i].key);
-            if (_d)
-                _d(_key);
+            _AVL_STAT(s, prefix_decisions, 1);
+            return (kp < _p) ? -1 : 1;
         }
-        memset(s->_tree, 0, sizeof(avl_set_element) * s->_config._reserve);
-        s->_size = 0;
-        s->_rindex = 0;
-
-        /*! @note maintain available slots */
-        __avl_stack_clear(s->_slots);
     }
+    return _AVL_COMPARE(s, k, __avl_key_at(s, self));
 }
 
-void avl_set_destroy(struct avl_set *s)
+static void __avl_store_key(struct avl_set *s, uint32_t e, const void *k)
 {
-    avl_set_clear(s);
-    if (s)
+    if (s->_key_size)
     {
-        /*! free tree array */
-        avl_deallocate _f = s->_config._dealloc;
-        _f(s->_tree);
-        s->_tree = NULL;
-        /*! free available slots */
-        _f(s->_slots);
-        s->_slots = NULL;
-        memset(s, 0, sizeof(struct avl_set));
-        _f(s);
+        memcpy(_AVL_INLINE_KEY(s, e), k, s->_key_size);
+    }
+    else
+    {
+        _AVL_KEY(s, e) = (uintptr_t)k;
+    }
+    if (s->_prefix_off)
+    {
+        _AVL_PREFIX(s, e) = s->_config._key_prefix(__avl_key(s, e));
     }
 }
 
-static void __avl_set_reserve_one(struct avl_set *s)
+static void __avl_store_value(struct avl_set *s, uint32_t e, const void *v)
 {
-    /*! ensure enough size */
-    if (s->_size < s->_config._reserve)
+    if (v)
     {
-        /*! @note there is still enough room for one element */
-        return;
+        memcpy(_AVL_VALUE(s, e), v, s->_value_size);
     }
-    size_t new_rsv_size = s->_size + (s->_size / 2) + _AVL_DEFAULT_RESERVE;
-    /*! manually reallocate : allocate new tree */
-    size_t _new_bytes = sizeof(avl_set_element) * new_rsv_size;
-    avl_set_element *ntree = (avl_set_element *)(s->_config._alloc(_new_bytes));
-
-    /*! manually reallocate : copy from old tree */
-    size_t _old_bytes = sizeof(avl_set_element) * s->_config._reserve;
-    memcpy(ntree, s->_tree, _old_bytes);
-    uint8_t *_rest = (uint8_t *)ntree + _old_bytes;
-    memset(_rest, 0, _new_bytes - _old_bytes);
-
-    /*! clean up old tree*/
-    memset(s->_tree, 0, _old_bytes);
-    s->_config._dealloc(s->_tree);
-
-    /*! manually reallocate : allocate new slots */
-    size_t _slot_size = sizeof(avl_stack) + sizeof(size_t) * new_rsv_size;
-    avl_stack *nslots = (avl_stack *)(s->_config._alloc(_slot_size));
-    memset(nslots, 0, _slot_size);
-    /*! set new slots size*/
-    nslots->size = new_rsv_size;
-
-    /*! manually reallocate : copy available old slots*/
-    size_t _old_slot_size = __avl_stack_bytesize(s->_slots);
-    size_t i;
-    for (i = 0; i < s->_slots->tail; i++)
+    else
     {
-        __avl_stack_push(nslots, s->_slots->array[i]);
+        memset(_AVL_VALUE(s, e), 0, s->_value_size);
     }
-    /*! newly allocated slots are also available */
-    size_t j;
-    for (j = s->_slots->size; j < new_rsv_size; j++)
+}
+
+/*! @brief number of elements in the subtree, the set must maintain order statistics */
+static uint32_t _avl_count(const struct avl_set *s, uint32_t e)
+{
+    return (_AVL_NIL == e) ? 0 : _AVL_COUNT(s, e);
+}
+
+static void _avl_update_count(struct avl_set *s, uint32_t e)
+{
+    if (s->_count_off)
     {
-        /*! @note this loop may take quite a while */
-        __avl_stack_push(nslots, s->_slots->array[j]);
+        avl_node *n = _AVL_NODE(s, e);
+        _AVL_COUNT(s, e) = _avl_count(s, _avl_left(n)) + _avl_count(s, _avl_right(n)) + 1;
     }
+}
 
-    /*! clean up old slots*/
-    memset(s->_slots, 0, _old_slot_size);
-    s->_config._dealloc(s->_slots);
+/*! @brief most slots a change copies away from the snapshots: its path, and two more per rotation */
+#define _AVL_COPY_RESERVE (3 * AVL_MAX_HEIGHT)
 
-    /*! the new setup */
-    s->_tree = ntree;
-    s->_slots = nslots;
-    s->_config._reserve = new_rsv_size;
+/*! @struct avl_dead */
+typedef struct _avl_dead
+{
+    uint32_t slot;
+    /*! the versions of the set which held the slot, [birth, death) */
+    uint32_t birth;
+    uint32_t death;
+    /*! the element was removed, it is destructed along with the slot */
+    uint32_t destruct;
+} avl_dead;
+
+/*! @brief a version of an avl_set, sharing the unchanged slots with it */
+struct avl_snapshot
+{
+    struct avl_set *_set;
+    uint32_t _root;
+    uint32_t _version;
+    size_t _size;
+    struct avl_snapshot *_prev;
+    struct avl_snapshot *_next;
+};
+
+/*! @struct avl_snap */
+typedef struct _avl_snap
+{
+    /*! version written into the slots from now on, starts from 1 */
+    uint32_t version;
+    /*! version of the newest snapshot, the slots written up to it are shared, 0 without snapshots */
+    uint32_t frozen;
+    /*! live snapshots, from the oldest to the newest */
+    struct avl_snapshot *oldest;
+    struct avl_snapshot *newest;
+    /*! slots dropped by the set and still held by snapshots, grown with the changes made since the first one */
+    avl_dead *dead;
+    size_t ndead;
+    size_t dcap;
+} avl_snap;
+
+/*! @brief whether the set shares slots with live snapshots */
+static int __avl_set_shared(const struct avl_set *s)
+{
+    return s->_snap && s->_snap->frozen;
+}
+
+/*! @brief whether slot e is shared with a snapshot, and must be copied before any change */
+static int __avl_set_frozen(const struct avl_set *s, uint32_t e)
+{
+    return __avl_set_shared(s) && _AVL_BIRTH(s, e) <= s->_snap->frozen;
 }
 
-static avl_set_element *__avl_set_search(struct avl_set *s, avl_set_element *e, const void *k)
+/*! @brief make room for n more dead slots before a change, the list is doubled when full */
+static int __avl_snap_room(struct avl_set *s, size_t n)
 {
-    assert(e);
-    int cmpret = s->_compare(k, (const void *)(e->key));
-    if (0 == cmpret)
+    avl_snap *z = s->_snap;
+    if (z->ndead + n <= z->dcap)
     {
-        /*! @brief found */
-        return e;
+        return 0;
     }
-    else if (0 > cmpret)
+    size_t _cap = _AVL_MAX(z->ndead + n, 2 * z->dcap);
+    /*! manually reallocate : _config has no realloc */
+    avl_dead *_dead = (avl_dead *)(s->_config._alloc(sizeof(avl_dead) * _cap));
+    if (NULL == _dead)
     {
-        avl_node *lchild = (avl_node *)(e->node.left);
-        if (lchild)
-        {
-            avl_set_element *left = (avl_set_element *)lchild;
-            return __avl_set_search(s, left, k);
-        }
+        return -1;
     }
-    else
+    if (z->dead)
     {
-        avl_node *rchild = (avl_node *)(e->node.right);
-        if (rchild)
-        {
-            avl_set_element *right = (avl_set_element *)rchild;
-            return __avl_set_search(s, right, k);
-        }
+        memcpy(_dead, z->dead, sizeof(avl_dead) * z->ndead);
+        s->_config._dealloc(z->dead);
     }
-    /*! @brief left or right is NULL, not found */
-    return NULL;
+    z->dead = _dead;
+    z->dcap = _cap;
+    return 0;
 }
 
-void *avl_set_search(struct avl_set *s, const void *k)
+/*! @brief keep slot e, dropped from the set, until no snapshot holds it, see __avl_snap_room() */
+static void __avl_set_bury(struct avl_set *s, uint32_t e, int destruct)
 {
-    assert(s);
-    if (0 == s->_size)
-    {
-        /*! @brief empty set */
-        return NULL;
-    }
-    avl_set_element *root = &(s->_tree[s->_rindex]);
-    avl_set_element *ret = __avl_set_search(s, root, k);
-    if (NULL == ret)
-    {
-        /*! @brief not found */
-        return NULL;
-    }
-    return (void *)(ret->key);
+    avl_snap *z = s->_snap;
+    assert(z->ndead < z->dcap);
+    avl_dead *d = &z->dead[z->ndead++];
+    d->slot = e;
+    d->birth = _AVL_BIRTH(s, e);
+    d->death = z->version;
+    d->destruct = (uint32_t)destruct;
 }
 
-static avl_set_element *__avl_set_insert(struct avl_set *s, avl_set_element *e, void *k)
+/*! @brief a private copy of shared slot e, from the slots reserved by __avl_set_reserve_one() */
+static uint32_t __avl_set_copy(struct avl_set *s, uint32_t e)
 {
-    if (NULL == e)
+    uint32_t _copy = __avl_set_take_slot(s);
+    assert(_AVL_NIL != _copy);
+    memcpy(_AVL_ELEM(s, _copy), _AVL_ELEM(s, e), s->_stride);
+    _AVL_BIRTH(s, _copy) = s->_snap->version;
+    __avl_set_bury(s, e, 0);
+    return _copy;
+}
+
+/*! @brief make the child of e on one side (dir < 0 for the left) private to the set, e must be already */
+static uint32_t __avl_set_own_child(struct avl_set *s, uint32_t e, int dir)
+{
+    avl_node *n = _AVL_NODE(s, e);
+    uint32_t c = (0 > dir) ? _avl_left(n) : _avl_right(n);
+    if (_AVL_NIL == c || !__avl_set_frozen(s, c))
     {
-        /*! @note on edge */
-        size_t empty_slot = 0;
-        if (0 != __avl_stack_pop(&empty_slot, s->_slots))
-        {
-            assert(0);
-            return NULL;
-        }
-        avl_set_element *ret = &(s->_tree[empty_slot]);
-        ret->node.left = (uintptr_t)NULL;
-        ret->node.right = (uintptr_t)NULL;
-        ret->node.height = 1;
-        ret->key = (uintptr_t)k;
-        s->_size++;
-        return ret;
+        return c;
     }
-    int cmpret = s->_compare(k, (const void *)(e->key));
-    if (0 == cmpret)
+    c = __avl_set_copy(s, c);
+    if (0 > dir)
     {
-        /*! @note key duplicated, destroy the previous element*/
-        if (s->_key_destruct)
-        {
-            s->_key_destruct((void *)(e->key));
-        }
-        e->key = (uintptr_t)k;
-        return e;
+        _avl_set_left(n, c);
     }
-    else if (0 > cmpret)
+    else
     {
-        avl_node *lchild = (avl_node *)(e->node.left);
-        if (lchild)
-        {
-            avl_set_element *left = (avl_set_element *)lchild;
-            avl_set_element *newleft = __avl_set_insert(s, left, k);
-            e->node.left = (uintptr_t)(&(newleft->node));
-        }
-        else
-        {
-            avl_set_element *newleft = __avl_set_insert(s, NULL, k);
-            e->node.left = (uintptr_t)(&(newleft->node));
-        }
+        _avl_set_right(n, c);
     }
-    else
+    return c;
+}
+
+static uint32_t avl_single_rotate_right(struct avl_set *s, uint32_t root)
+{
+    avl_node *r = _AVL_NODE(s, root);
+    uint32_t left = _avl_left(r);
+    avl_node *l = _AVL_NODE(s, left);
+    _avl_set_left(r, _avl_right(l));
+    _avl_set_right(l, root);
+    _avl_update_count(s, root);
+    _avl_update_count(s, left);
+    return left;
+}
+
+static uint32_t avl_single_rotate_left(struct avl_set *s, uint32_t root)
+{
+    avl_node *r = _AVL_NODE(s, root);
+    uint32_t right = _avl_right(r);
+    avl_node *l = _AVL_NODE(s, right);
+    _avl_set_right(r, _avl_left(l));
+    _avl_set_left(l, root);
+    _avl_update_count(s, root);
+    _avl_update_count(s, right);
+    return right;
+}
+
+/*! @brief height of a subtree, following the higher side */
+static int __avl_set_height(const struct avl_set *s, uint32_t e)
+{
+    int h = 0;
+    while (_AVL_NIL != e)
     {
-        avl_node *rchild = (avl_node *)(e->node.right);
-        if (rchild)
-        {
-            avl_set_element *right = (avl_set_element *)rchild;
-            avl_set_element *newright = __avl_set_insert(s, right, k);
-            e->node.right = (uintptr_t)(&(newright->node));
-        }
-        else
-        {
-            avl_set_element *newright = __avl_set_insert(s, NULL, k);
-            e->node.right = (uintptr_t)(&(newright->node));
-        }
+        avl_node *n = _AVL_NODE(s, e);
+        h++;
+        e = (0 < __avl_balance_factor(n)) ? _avl_left(n) : _avl_right(n);
     }
-    /*! @note do some AVL stuff */
-    avl_node *self = &e->node;
-    _avl_update_height(self);
-    int balance_factor = __avl_balance_factor(self);
-    if (balance_factor > 1)
+    return h;
+}
+
+/**
+ * @brief restore the balance of a subtree
+ * @param e root of the subtree
+ * @param bf the balance factor of e, +2 or -2, which can not be stored
+ * @param shrunk set to 1 if the new subtree is lower than the unbalanced one
+ * @return new root of the subtree
+ */
+static uint32_t __avl_rebalance(struct avl_set *s, uint32_t e, int bf, int *shrunk)
+{
+    avl_node *self = _AVL_NODE(s, e);
+    if (bf > 0)
     {
-        avl_node *left = (avl_node *)(e->node.left);
-        int lbf = __avl_balance_factor(left);
-        if (lbf > 0)
-        {
-            avl_node *_new_root = avl_single_rotate_right(self);
-            avl_set_element *root_elem = (avl_set_element *)_new_root;
-            return root_elem;
-        }
-        else if (lbf < 0)
+        /*! @note on deletion the higher side may be shared with a snapshot */
+        uint32_t left = __avl_set_own_child(s, e, -1);
+        avl_node *l = _AVL_NODE(s, left);
+        int lbf = __avl_balance_factor(l);
+        if (lbf >= 0)
         {
-            avl_node *_new_left = avl_single_rotate_left(left);
-            self->left = (uintptr_t)_new_left;
-            avl_node *_new_root = avl_single_rotate_right(self);
-            avl_set_element *root_elem = (avl_set_element *)_new_root;
-            return root_elem;
+            uint32_t _new_root = avl_single_rotate_right(s, e);
+            _AVL_STAT(s, rotations[0], 1);
+            /*! @note lbf is 0 only on deletion, the height is kept */
+            __avl_set_balance_factor(self, lbf ? 0 : 1);
+            __avl_set_balance_factor(l, lbf ? 0 : -1);
+            *shrunk = lbf ? 1 : 0;
+            return _new_root;
         }
+        uint32_t grand = __avl_set_own_child(s, left, 1);
+        avl_node *g = _AVL_NODE(s, grand);
+        int gbf = __avl_balance_factor(g);
+        _avl_set_left(self, avl_single_rotate_left(s, left));
+        uint32_t _new_root = avl_single_rotate_right(s, e);
+        _AVL_STAT(s, rotations[2], 1);
+        __avl_set_balance_factor(self, gbf > 0 ? -1 : 0);
+        __avl_set_balance_factor(l, gbf < 0 ? 1 : 0);
+        __avl_set_balance_factor(g, 0);
+        *shrunk = 1;
+        return _new_root;
     }
-    else if (balance_factor < -1)
+    else
     {
-        avl_node *right = (avl_node *)(e->node.right);
-        int rbf = __avl_balance_factor(right);
-        if (rbf < 0)
+        uint32_t right = __avl_set_own_child(s, e, 1);
+        avl_node *r = _AVL_NODE(s, right);
+        int rbf = __avl_balance_factor(r);
+        if (rbf <= 0)
         {
-            avl_node *_new_root = avl_single_rotate_left(self);
-            avl_set_element *root_elem = (avl_set_element *)_new_root;
-            return root_elem;
-        }
-        else if (rbf > 0)
-        {
-            avl_node *_new_right = avl_single_rotate_right(right);
-            self->right = (uintptr_t)_new_right;
-            avl_node *_new_root = avl_single_rotate_left(self);
-            avl_set_element *root_elem = (avl_set_element *)_new_root;
-            return root_elem;
+            uint32_t _new_root = avl_single_rotate_left(s, e);
+            _AVL_STAT(s, rotations[1], 1);
+            /*! @note rbf is 0 only on deletion, the height is kept */
+            __avl_set_balance_factor(self, rbf ? 0 : -1);
+            __avl_set_balance_factor(r, rbf ? 0 : 1);
+            *shrunk = rbf ? 1 : 0;
+            return _new_root;
         }
+        uint32_t grand = __avl_set_own_child(s, right, -1);
+        avl_node *g = _AVL_NODE(s, grand);
+        int gbf = __avl_balance_factor(g);
+        _avl_set_right(self, avl_single_rotate_right(s, right));
+        uint32_t _new_root = avl_single_rotate_left(s, e);
+        _AVL_STAT(s, rotations[3], 1);
+        __avl_set_balance_factor(self, gbf < 0 ? 1 : 0);
+        __avl_set_balance_factor(r, gbf > 0 ? -1 : 0);
+        __avl_set_balance_factor(g, 0);
+        *shrunk = 1;
+        return _new_root;
     }
-    return e;
 }
 
-int avl_set_insert(struct avl_set *s, void *k)
+#if defined(_AVL_HAVE_ARENA_POLICY)
+/*! @brief bytes actually mapped for an arena of the given bytes */
+static size_t __avl_arena_length(const struct avl_config *cfg, size_t bytes)
 {
-    assert(s);
-    /*! empty set */
-    if (0 == s->_size)
+    if (cfg->_arena_policy & (AVL_ARENA_HUGE_PAGES | AVL_ARENA_HUGETLB))
     {
-        avl_set_element *nroot = __avl_set_insert(s, NULL, k);
-        s->_rindex = (uint32_t)(nroot - s->_tree);
-        return 0;
+        return _AVL_ALIGN(bytes, _AVL_HUGE_PAGE);
     }
-    /*! check reserve */
-    __avl_set_reserve_one(s);
-    /*! record current size */
-    size_t cur_size = s->_size;
-    /*! current root */
-    avl_set_element *relem = &(s->_tree[s->_rindex]);
-    /*! perform insertion */
-    avl_set_element *nroot = __avl_set_insert(s, relem, k);
-    /*! update root index */
-    s->_rindex = (uint32_t)(nroot - s->_tree);
-    /*! success on size increasing, no change means duplicated*/
-    return s->_size > cur_size ? 0 : 1;
+    return bytes;
 }
 
-static avl_set_element *__avl_set_delete(struct avl_set *s, avl_set_element *e, const void *k, int replace)
+/*! @brief map an arena following the policy, every step falls back quietly if the kernel refuses it */
+static void *__avl_arena_map(const struct avl_config *cfg, size_t bytes)
 {
-    if (NULL == e)
+    size_t _len = __avl_arena_length(cfg, bytes);
+    uint8_t *p = (uint8_t *)MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (cfg->_arena_policy & AVL_ARENA_HUGETLB)
     {
-        return NULL;
+        /*! @note explicit huge pages, if the administrator reserved enough of them */
+        p = (uint8_t *)mmap(NULL, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
     }
-    /*! @brief record on this frame */
-    avl_set_element *self = e;
-    int cmpret = s->_compare(k, (const void *)(self->key));
-    if (0 > cmpret)
+#endif
+    if ((uint8_t *)MAP_FAILED == p && _len != bytes)
     {
-        /*! @note deletion is performed on left-tree, may need a new left child */
-        avl_node *lchild = (avl_node *)(self->node.left);
-        avl_set_element *left = (avl_set_element *)lchild;
-        avl_set_element *_new_left = __avl_set_delete(s, left, k, replace);
-        self->node.left = (uintptr_t)_new_left;
-        /*! @note self balance check */
-        if (__avl_balance_factor(&(self->node)) < -1)
+        /*! @note transparent huge pages need an aligned range, the excess around it is given back */
+        uint8_t *raw = (uint8_t *)mmap(NULL, _len + _AVL_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ((uint8_t *)MAP_FAILED != raw)
         {
-            avl_node *right = (avl_node *)(self->node.right);
-            int rbf = __avl_balance_factor(right);
-            if (rbf < 0)
-            {
-                avl_node *_new_root = avl_single_rotate_left(&(self->node));
-                self = (avl_set_element *)_new_root;
-            }
-            else if (rbf > 0)
-            {
-                avl_node *_new_right = avl_single_rotate_right(right);
-                self->node.right = (uintptr_t)_new_right;
-                avl_node *_new_root = avl_single_rotate_left(&(self->node));
-                self = (avl_set_element *)_new_root;
-            }
+            p = (uint8_t *)_AVL_ALIGN((uintptr_t)raw, _AVL_HUGE_PAGE);
+            if (p > raw)
+                munmap(raw, (size_t)(p - raw));
+            if (raw + _AVL_HUGE_PAGE > p)
+                munmap(p + _len, (size_t)(raw + _AVL_HUGE_PAGE - p));
+#if defined(MADV_HUGEPAGE)
+            madvise(p, _len, MADV_HUGEPAGE);
+#endif
         }
     }
-    else if (0 < cmpret)
+    else if ((uint8_t *)MAP_FAILED == p)
     {
-        /*! @note deletion is performed on right-tree, may need a new right child */
-        avl_node *rchild = (avl_node *)(self->node.right);
-        avl_set_element *right = (avl_set_element *)rchild;
-        avl_set_element *_new_right = __avl_set_delete(s, right, k, replace);
-        self->node.right = (uintptr_t)_new_right;
-        /*! @note self balance check */
-        if (__avl_balance_factor(&(self->node)) > 1)
-        {
-            avl_node *left = (avl_node *)(self->node.left);
-            int lbf = __avl_balance_factor(left);
-            if (lbf > 0)
-            {
-                avl_node *_new_root = avl_single_rotate_right(&(self->node));
-                self = (avl_set_element *)_new_root;
-            }
-            else if (lbf < 0)
-            {
-                avl_node *_new_left = avl_single_rotate_left(left);
-                self->node.left = (uintptr_t)_new_left;
-                avl_node *_new_root = avl_single_rotate_right(&(self->node));
-                self = (avl_set_element *)_new_root;
-            }
-        }
+        p = (uint8_t *)mmap(NULL, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     }
-    else
+    if ((uint8_t *)MAP_FAILED == p)
     {
-        /*! @note target found, record it */
-        avl_set_element _record = *self;
-        /*! check target status */
-        avl_node *left = (avl_node *)(self->node.left);
-        avl_node *right = (avl_node *)(self->node.right);
-        if (left && right)
-        {
-            /*! @note target has left and right children */
-            int bf = __avl_balance_factor(&(self->node));
-            if (0 > bf)
-            {
-                /* right tree is higher, find the smallest element of the right tree */
-                avl_node *_smallest = right;
-                while (1)
-                {
-                    avl_node *_smaller = (avl_node *)(_smallest->left);
-                    if (NULL == _smaller)
-                    {
-                        break;
-                    }
-                    _smallest = _smaller;
-                }
-                avl_set_element *_victim = (avl_set_element *)_smallest;
-                /*! @note save the key of the victim */
-                self->key = _victim->key;
-                /*! @note perform deletion on right tree */
-                avl_set_element *_new_right = __avl_set_delete(s, (avl_set_element *)right, (const void *)(_victim->key), 1);
-                /*! @note update new right child */
-                self->node.right = (uintptr_t)(&(_new_right->node));
-            }
-            else
-            {
-                /* left tree is higher (or equal), find the largest element of the left tree */
-                avl_node *_largest = left;
-                while (1)
-                {
-                    avl_node *_larger = (avl_node *)(_largest->right);
-                    if (NULL == _larger)
-                    {
-                        break;
-                    }
-                    _largest = _larger;
-                }
-                avl_set_element *_victim = (avl_set_element *)_largest;
-                /*! @note save the key of the victim */
-                self->key = _victim->key;
-                /*! @note perform deletion on left tree */
-                avl_set_element *_new_left = __avl_set_delete(s, (avl_set_element *)left, (const void *)(_victim->key), 1);
-                /*! @note update new left child */
-                self->node.left = (uintptr_t)(&(_new_left->node));
-            }
-        }
-        else
+        return NULL;
+    }
+#if defined(SYS_mbind)
+    if (cfg->_arena_policy & (AVL_ARENA_NUMA_INTERLEAVE | AVL_ARENA_NUMA_BIND))
+    {
+        /*! @note before the first touch; a kernel with fewer possible nodes wants the mask cut down to them */
+        int _bind = (cfg->_arena_policy & AVL_ARENA_NUMA_BIND) && cfg->_arena_node < 8 * sizeof(unsigned long);
+        unsigned long _bits;
+        for (_bits = 8 * sizeof(unsigned long); _bits > 1; _bits /= 2)
         {
-            /*! @note target slot can be recycled */
-            memset(self, 0, sizeof(avl_set_element));
-            size_t _slotid = self - s->_tree;
-            __avl_stack_push(s->_slots, _slotid);
-            if ((NULL == left) && (NULL == right))
-            {
-                /*! @note target is a leaf */
-                self = NULL;
-            }
-            else if (NULL == right)
+            unsigned long _mask = _bind ? (1ul << cfg->_arena_node) : (~0ul >> (8 * sizeof(unsigned long) - _bits));
+            if ((_bind && cfg->_arena_node >= _bits) ||
+                0 == syscall(SYS_mbind, p, _len, _bind ? _AVL_MPOL_BIND : _AVL_MPOL_INTERLEAVE, &_mask, _bits + 1, 0))
             {
-                /*! @note target only has left child */
-                self = (avl_set_element *)left;
+                break;
             }
-            else if (NULL == left)
-            {
-                /*! @note target only has right child */
-                self = (avl_set_element *)right;
-            }
-        }
-        /*! finally, cleanup job */
-        if (!replace)
-        {
-            /*! @note target is not replace, destruct key if needed */
-            if (s->_key_destruct)
-                s->_key_destruct((void *)(_record.key));
-            /*! update size */
-            s->_size--;
         }
     }
-    /*! @note update height */
-    _avl_update_height(&(self->node));
-    return self;
+#endif
+    return p;
 }
+#endif
 
-int avl_set_delete(struct avl_set *s, const void *k)
+/*! @brief whether the arenas of the sets are allocated and freed alike, so that they can be swapped */
+static int __avl_arena_same(const struct avl_config *a, const struct avl_config *b)
 {
-    assert(s);
-    if (0 == s->_size)
+    return a->_alloc == b->_alloc && a->_dealloc == b->_dealloc && a->_arena_alloc == b->_arena_alloc &&
+           a->_arena_dealloc == b->_arena_dealloc && a->_arena_ctx == b->_arena_ctx &&
+           a->_arena_policy == b->_arena_policy && a->_arena_node == b->_arena_node;
+}
+
+/*! @brief allocate an arena of the given bytes, with the arena hooks, or following the arena policy */
+static void *__avl_arena_alloc(const struct avl_config *cfg, size_t bytes)
+{
+    if (cfg->_arena_alloc)
     {
-        /*! @brief empty set */
-        return -1;
+        int _huge = 0 != (cfg->_arena_policy & (AVL_ARENA_HUGE_PAGES | AVL_ARENA_HUGETLB));
+        return cfg->_arena_alloc(cfg->_arena_ctx, bytes, _huge ? _AVL_HUGE_PAGE : _AVL_CACHE_LINE);
     }
-    size_t _rec_size = s->_size;
-    avl_set_element *root = &(s->_tree[s->_rindex]);
-    root = __avl_set_delete(s, root, k, 0);
-    /*! @note if the element is deleted */
-    if (_rec_size == s->_size)
+#if defined(_AVL_HAVE_ARENA_POLICY)
+    if (cfg->_arena_policy)
     {
-        /*! @note target not found */
-        return -1;
+        return __avl_arena_map(cfg, bytes);
     }
-    s->_rindex = (root - s->_tree);
-    return 0;
+#endif
+    return cfg->_alloc(bytes);
+}
+
+static void __avl_arena_free(const struct avl_config *cfg, void *p, size_t bytes)
+{
+    if (cfg->_arena_dealloc)
+    {
+        cfg->_arena_dealloc(cfg->_arena_ctx, p, bytes);
+        return;
+    }
+#if defined(_AVL_HAVE_ARENA_POLICY)
+    if (cfg->_arena_policy)
+    {
+        munmap(p, __avl_arena_length(cfg, bytes));
+        return;
+    }
+#endif
+    cfg->_dealloc(p);
+}
+
+/*! @brief choose the segments of the arena, one huge page each with a huge page policy */
+static void __avl_set_segment(struct avl_set *s)
+{
+    int _huge = 0 != (s->_config._arena_policy & (AVL_ARENA_HUGE_PAGES | AVL_ARENA_HUGETLB));
+    size_t _bytes = _huge ? _AVL_HUGE_PAGE : _AVL_SEGMENT_BYTES;
+    s->_seg_shift = 0;
+    while ((s->_stride << s->_seg_shift) < _bytes && ((size_t)1 << s->_seg_shift) < _AVL_MAX_SLOTS)
+    {
+        s->_seg_shift++;
+    }
+    s->_seg_mask = ((size_t)1 << s->_seg_shift) - 1;
+}
+
+/*! @brief slots of an arena holding at least n slots, whole segments once past the first one */
+static size_t __avl_set_round_reserve(const struct avl_set *s, size_t n)
+{
+    if (n > s->_seg_mask + 1)
+    {
+        n = (n + s->_seg_mask) & ~s->_seg_mask;
+    }
+    return (n > _AVL_MAX_SLOTS) ? _AVL_MAX_SLOTS : n;
+}
+
+/*! @brief segments of an arena of reserve slots */
+static size_t __avl_set_nsegs(const struct avl_set *s, size_t reserve)
+{
+    return (reserve + s->_seg_mask) >> s->_seg_shift;
+}
+
+/*! @brief bytes of segment k of an arena of reserve slots */
+static size_t __avl_set_seg_bytes(const struct avl_set *s, size_t reserve, size_t k)
+{
+    return ((0 == k && reserve <= s->_seg_mask) ? reserve : s->_seg_mask + 1) * s->_stride;
+}
+
+/*! @brief the directory entry of segment k at p, or back */
+static uint8_t *__avl_set_seg_bias(const struct avl_set *s, const uint8_t *p, size_t k, int bias)
+{
+    size_t _before = (k << s->_seg_shift) * s->_stride;
+    return (uint8_t *)(bias ? (uintptr_t)p - _before : (uintptr_t)p + _before);
+}
+
+/*! @brief free the segments [from, to) of an arena of reserve slots */
+static void __avl_set_segs_free(struct avl_set *s, uint8_t **segs, size_t reserve, size_t from, size_t to)
+{
+    size_t k;
+    for (k = from; k < to; k++)
+    {
+        if (segs[k])
+        {
+            __avl_arena_free(&s->_config, __avl_set_seg_bias(s, segs[k], k, 0), __avl_set_seg_bytes(s, reserve, k));
+            segs[k] = NULL;
+        }
+    }
+}
+
+/*! @brief allocate the zeroed segments [from, to) of an arena of reserve slots, none on failure */
+static int __avl_set_segs_alloc(struct avl_set *s, uint8_t **segs, size_t reserve, size_t from, size_t to)
+{
+    size_t k;
+    for (k = from; k < to; k++)
+    {
+        uint8_t *_seg = (uint8_t *)__avl_arena_alloc(&s->_config, __avl_set_seg_bytes(s, reserve, k));
+        if (NULL == _seg)
+        {
+            __avl_set_segs_free(s, segs, reserve, from, k);
+            return -1;
+        }
+        memset(_seg, 0, __avl_set_seg_bytes(s, reserve, k));
+        segs[k] = __avl_set_seg_bias(s, _seg, k, 1);
+    }
+    return 0;
+}
+
+/*! @brief a directory of cap segments, with the zeroed segments of an arena of reserve slots */
+static uint8_t **__avl_set_arena_create(struct avl_set *s, size_t reserve, size_t cap)
+{
+    uint8_t **segs = (uint8_t **)(s->_config._alloc(sizeof(uint8_t *) * cap));
+    if (NULL == segs)
+    {
+        return NULL;
+    }
+    memset(segs, 0, sizeof(uint8_t *) * cap);
+    if (0 != __avl_set_segs_alloc(s, segs, reserve, 0, __avl_set_nsegs(s, reserve)))
+    {
+        s->_config._dealloc(segs);
+        return NULL;
+    }
+    return segs;
+}
+
+static void __avl_set_arena_destroy(struct avl_set *s, uint8_t **segs, size_t reserve)
+{
+    __avl_set_segs_free(s, segs, reserve, 0, __avl_set_nsegs(s, reserve));
+    s->_config._dealloc(segs);
+}
+
+/*! @brief a registered reader of a concurrent set, alone on its cache line */
+struct avl_reader
+{
+    struct _avl_sync *_sync;
+    /*! epoch seen on entering, 0 outside of a read section */
+    size_t _epoch;
+#if !defined(NDEBUG) && defined(_AVL_HAVE_PTHREAD)
+    /*! the thread in the read section, to catch a writer waiting for itself */
+    pthread_t _owner;
+#define _AVL_READER_OWNER (sizeof(pthread_t))
+#else
+#define _AVL_READER_OWNER (0)
+#endif
+    int _used;
+    char _pad[_AVL_CACHE_LINE - sizeof(void *) - sizeof(size_t) - _AVL_READER_OWNER - sizeof(int)];
+};
+
+/*! @struct avl_limbo */
+typedef struct _avl_limbo
+{
+    /*! epoch of the retirement, readers that entered later cannot reach it */
+    size_t epoch;
+    /*! a retired slot, or a retired segment of the given bytes, or a retired directory of 0 bytes */
+    void *arena;
+    size_t bytes;
+    uint32_t slot;
+    /*! whether the key and the value of the slot are destructed, not if they were handed to the caller */
+    uint32_t destruct;
+} avl_limbo;
+
+/*! @struct avl_sync */
+typedef struct _avl_sync
+{
+    /*! odd while the writer is changing the set, read sections overlapping a change are retried */
+    size_t seq;
+    char _pad0[_AVL_CACHE_LINE - sizeof(size_t)];
+    /*! current epoch, starts from 1 */
+    size_t epoch;
+    char _pad1[_AVL_CACHE_LINE - sizeof(size_t)];
+    struct avl_reader readers[_AVL_MAX_READERS];
+    /*! retired slots, the list grows with the retirements pending, see __avl_sync_room() */
+    avl_limbo *limbo;
+    size_t nlimbo;
+    size_t lcap;
+    /*! retired arenas, likewise */
+    avl_limbo *arenas;
+    size_t narenas;
+    size_t acap;
+    /*! the current change has retired something */
+    int retired;
+    /*! the allocation holding this aligned record */
+    void *raw;
+} avl_sync;
+
+static avl_sync *__avl_sync_create(const struct avl_config *cfg)
+{
+#ifdef _AVL_HAVE_ATOMIC
+    void *raw = cfg->_alloc(sizeof(avl_sync) + _AVL_CACHE_LINE);
+    if (NULL == raw)
+    {
+        return NULL;
+    }
+    avl_sync *y = (avl_sync *)_AVL_ALIGN((uintptr_t)raw, _AVL_CACHE_LINE);
+    memset(y, 0, sizeof(avl_sync));
+    y->raw = raw;
+    y->epoch = 1;
+    size_t i;
+    for (i = 0; i < _AVL_MAX_READERS; i++)
+    {
+        y->readers[i]._sync = y;
+    }
+    return y;
+#else
+    (void)cfg;
+    return NULL;
+#endif
+}
+
+/*! @brief spin a while, then let the thread being waited for run, it is likely preempted */
+static void __avl_backoff(size_t *spins)
+{
+    if (++*spins >= _AVL_SPIN_LIMIT)
+    {
+#if defined(_AVL_HAVE_PTHREAD)
+        sched_yield();
+#endif
+        *spins = 0;
+    }
+}
+
+/*! @brief start a read section, wait for the writer to leave the set in a stable state */
+static size_t __avl_set_read_begin(const struct avl_set *s)
+{
+    if (NULL == s->_sync)
+    {
+        return 0;
+    }
+    size_t _spins = 0;
+    while (1)
+    {
+        size_t seq = _AVL_LOAD(&s->_sync->seq, __ATOMIC_ACQUIRE);
+        if (0 == (seq & 1))
+        {
+            return seq;
+        }
+        /*! @note a change only spans its stores */
+        __avl_backoff(&_spins);
+    }
+}
+
+/*! @brief whether the reads since __avl_set_read_begin() saw a stable set, otherwise they are retried */
+static int __avl_set_read_validate(const struct avl_set *s, size_t seq)
+{
+    if (NULL == s->_sync)
+    {
+        return 1;
+    }
+    _AVL_FENCE(__ATOMIC_ACQUIRE);
+    return seq == _AVL_LOAD(&s->_sync->seq, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief open a change, right before the first store the readers can see
+ * @note lookups of the writer come before it, the readers run along with them; opening an open change does nothing
+ */
+static void __avl_set_write_begin(struct avl_set *s)
+{
+    avl_sync *y = s->_sync;
+    if (y && 0 == (y->seq & 1))
+    {
+        _AVL_STORE(&y->seq, y->seq + 1, __ATOMIC_RELAXED);
+        _AVL_FENCE(__ATOMIC_RELEASE);
+    }
+}
+
+/*! @brief make the content of fresh slots visible to the readers before the links to them */
+static void __avl_set_publish(const struct avl_set *s)
+{
+    if (s->_sync)
+    {
+        _AVL_FENCE(__ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief set up an avl_set
+ * @param at [optional] storage of the avl_set, allocated if NULL
+ * @return the avl_set, NULL on error
+ */
+static struct avl_set *__avl_set_init(struct avl_set *at, avl_compare cmp, avl_destruct kdtor, avl_destruct vdtor,
+                                      size_t vsize, const struct avl_config *cfg)
+{
+    if (NULL == cmp)
+    {
+        return NULL;
+    }
+
+    struct avl_config _config = {
+        ._alloc = malloc,
+        ._dealloc = free,
+        ._reserve = _AVL_DEFAULT_RESERVE};
+
+    if (cfg)
+    {
+        if (cfg->_alloc && cfg->_dealloc)
+        {
+            _config._alloc = cfg->_alloc;
+            _config._dealloc = cfg->_dealloc;
+        }
+        if (cfg->_reserve > 0)
+        {
+            _config._reserve = cfg->_reserve;
+        }
+        _config._options = cfg->_options;
+        _config._key_size = cfg->_key_size;
+        _config._key_prefix = cfg->_key_prefix;
+        if (cfg->_arena_alloc && cfg->_arena_dealloc)
+        {
+            _config._arena_alloc = cfg->_arena_alloc;
+            _config._arena_dealloc = cfg->_arena_dealloc;
+            _config._arena_ctx = cfg->_arena_ctx;
+        }
+        _config._arena_policy = cfg->_arena_policy;
+        _config._arena_node = cfg->_arena_node;
+        /*! @note above half, a shrink would leave less headroom than a growth */
+        _config._shrink_percent = (cfg->_shrink_percent > 50) ? 50 : cfg->_shrink_percent;
+    }
+    if (_config._reserve > _AVL_MAX_SLOTS)
+    {
+        return NULL;
+    }
+    if ((_config._options & AVL_SET_CONCURRENT) && (_config._options & AVL_SET_SNAPSHOTS))
+    {
+        /*! @note the readers of a concurrent set do not follow copied slots */
+        return NULL;
+    }
+#ifndef _AVL_HAVE_ATOMIC
+    if (_config._options & AVL_SET_CONCURRENT)
+    {
+        /*! @note without the __atomic builtins the readers would get no ordering at all */
+        return NULL;
+    }
+#endif
+
+    struct avl_set *_s = at ? at : (struct avl_set *)(_config._alloc(sizeof(struct avl_set)));
+    if (NULL == _s)
+    {
+        /*! @note panic */
+        return NULL;
+    }
+
+    memset(_s, 0, sizeof(struct avl_set));
+    /*! @brief initialization */
+    _s->_compare = cmp;
+    _s->_config = _config;
+    _s->_key_destruct = kdtor;
+    _s->_value_destruct = vdtor;
+    _s->_rindex = _AVL_NIL;
+    _s->_version = 1;
+    _s->_size = 0;
+
+    /*! @brief slot layout */
+    _s->_stride = sizeof(avl_node);
+    if (_config._options & AVL_SET_ORDER_STATISTICS)
+    {
+        _s->_count_off = _s->_stride;
+        _s->_stride += sizeof(uint32_t);
+    }
+    if (_config._options & AVL_SET_SNAPSHOTS)
+    {
+        _s->_birth_off = _s->_stride;
+        _s->_stride += sizeof(uint32_t);
+    }
+    _s->_stride = _AVL_ALIGN(_s->_stride, sizeof(uintptr_t));
+    if (_config._key_prefix)
+    {
+        /*! @note next to the node, a descent decides most steps without touching the key */
+        _s->_stride = _AVL_ALIGN(_s->_stride, sizeof(uint64_t));
+        _s->_prefix_off = _s->_stride;
+        _s->_stride += sizeof(uint64_t);
+    }
+    _s->_key_off = _s->_stride;
+    _s->_key_size = _config._key_size;
+    _s->_stride += _config._key_size ? _AVL_ALIGN(_config._key_size, sizeof(uintptr_t)) : sizeof(uintptr_t);
+    _s->_value_off = _s->_stride;
+    _s->_value_size = vsize;
+    _s->_stride += _AVL_ALIGN(vsize, sizeof(uintptr_t));
+    if (_s->_prefix_off)
+    {
+        _s->_stride = _AVL_ALIGN(_s->_stride, sizeof(uint64_t));
+    }
+
+    __avl_set_segment(_s);
+    _config._reserve = __avl_set_round_reserve(_s, _config._reserve);
+    _s->_config._reserve = _config._reserve;
+    _s->_segs_cap = __avl_set_nsegs(_s, _config._reserve);
+    _s->_segs = __avl_set_arena_create(_s, _config._reserve, _s->_segs_cap);
+    if (NULL == _s->_segs)
+    {
+        if (NULL == at)
+            _config._dealloc(_s);
+        return NULL;
+    }
+    __avl_set_reset_slots(_s, 0);
+    if (_config._options & AVL_SET_CONCURRENT)
+    {
+        _s->_sync = __avl_sync_create(&_config);
+        if (NULL == _s->_sync)
+        {
+            __avl_set_arena_destroy(_s, _s->_segs, _config._reserve);
+            if (NULL == at)
+                _config._dealloc(_s);
+            return NULL;
+        }
+    }
+    if (_config._options & AVL_SET_SNAPSHOTS)
+    {
+        _s->_snap = (avl_snap *)(_config._alloc(sizeof(avl_snap)));
+        if (NULL == _s->_snap)
+        {
+            __avl_set_arena_destroy(_s, _s->_segs, _config._reserve);
+            if (NULL == at)
+                _config._dealloc(_s);
+            return NULL;
+        }
+        memset(_s->_snap, 0, sizeof(avl_snap));
+        _s->_snap->version = 1;
+    }
+    return _s;
+}
+
+static struct avl_set *__avl_set_create(avl_compare cmp, avl_destruct kdtor, avl_destruct vdtor, size_t vsize,
+                                        const struct avl_config *cfg)
+{
+    return __avl_set_init(NULL, cmp, kdtor, vdtor, vsize, cfg);
+}
+
+struct avl_set *avl_set_create(avl_compare cmp, avl_destruct kdtor, const struct avl_config *cfg)
+{
+    return __avl_set_create(cmp, kdtor, NULL, 0, cfg);
+}
+
+uint64_t avl_string_prefix(const void *k)
+{
+    const unsigned char *_c = (const unsigned char *)k;
+    uint64_t p = 0;
+    size_t i;
+    /*! @note big-endian, the bytes after the terminator stay 0 as a shorter string sorts first */
+    for (i = 0; i < sizeof(uint64_t); i++)
+    {
+        p <<= 8;
+        if (*_c)
+        {
+            p |= *_c++;
+        }
+    }
+    return p;
+}
+
+/*! @brief destruct the key and the value held by slot e */
+static void __avl_set_destruct(struct avl_set *s, uint32_t e)
+{
+    if (s->_key_destruct)
+    {
+        s->_key_destruct(__avl_key(s, e));
+    }
+    if (s->_value_destruct)
+    {
+        s->_value_destruct(_AVL_VALUE(s, e));
+    }
+}
+
+/*! @brief give slot e back to the available slots */
+static void __avl_set_release(struct avl_set *s, uint32_t e)
+{
+    memset(_AVL_ELEM(s, e), 0, s->_stride);
+    __avl_set_put_slot(s, e);
+}
+
+/*! @brief make room for n more entries in a list of *cap retired ones, used of them taken, doubled when full */
+static int __avl_limbo_room(const struct avl_config *cfg, avl_limbo **list, size_t *cap, size_t used, size_t n)
+{
+    if (used + n <= *cap)
+    {
+        return 0;
+    }
+    size_t _cap = _AVL_MAX(_AVL_MAX(used + n, 2 * *cap), (size_t)_AVL_RECLAIM_THRESHOLD);
+    /*! manually reallocate : _config has no realloc */
+    avl_limbo *_list = (avl_limbo *)(cfg->_alloc(sizeof(avl_limbo) * _cap));
+    if (NULL == _list)
+    {
+        return -1;
+    }
+    if (*list)
+    {
+        memcpy(_list, *list, sizeof(avl_limbo) * used);
+        cfg->_dealloc(*list);
+    }
+    *list = _list;
+    *cap = _cap;
+    return 0;
+}
+
+/*! @brief make room for n more retired slots before a change, 0 if the set is not concurrent */
+static int __avl_sync_room(struct avl_set *s, size_t n)
+{
+    avl_sync *y = s->_sync;
+    return y ? __avl_limbo_room(&s->_config, &y->limbo, &y->lcap, y->nlimbo, n) : 0;
+}
+
+/**
+ * @brief destruct and recycle the retired slots, and free the retired arenas, no reader can reach anymore
+ * @param wait spin until the readers let everything go, which never happens from inside a read section
+ */
+static void __avl_set_reclaim(struct avl_set *s, int wait)
+{
+    avl_sync *y = s->_sync;
+    size_t _spins = 0;
+    while (1)
+    {
+        /*! @note pairs with the fence of avl_set_reader_enter(), a reader not seen here sees the unlinks */
+        _AVL_FENCE(__ATOMIC_SEQ_CST);
+        size_t _oldest = (size_t)-1;
+        size_t i;
+        for (i = 0; i < _AVL_MAX_READERS; i++)
+        {
+            size_t _epoch = _AVL_LOAD(&y->readers[i]._epoch, __ATOMIC_ACQUIRE);
+            if (_epoch && _epoch < _oldest)
+            {
+                _oldest = _epoch;
+            }
+        }
+        size_t n = 0;
+        for (i = 0; i < y->nlimbo; i++)
+        {
+            if (y->limbo[i].epoch >= _oldest)
+            {
+                y->limbo[n++] = y->limbo[i];
+                continue;
+            }
+            if (y->limbo[i].destruct)
+            {
+                __avl_set_destruct(s, y->limbo[i].slot);
+            }
+            __avl_set_release(s, y->limbo[i].slot);
+        }
+        y->nlimbo = n;
+        if (0 == n && y->lcap > _AVL_RECLAIM_THRESHOLD)
+        {
+            /*! @note the room a large change has made is given back once it is reclaimed */
+            s->_config._dealloc(y->limbo);
+            y->limbo = NULL;
+            y->lcap = 0;
+        }
+        n = 0;
+        for (i = 0; i < y->narenas; i++)
+        {
+            if (y->arenas[i].epoch >= _oldest)
+            {
+                y->arenas[n++] = y->arenas[i];
+                continue;
+            }
+            if (y->arenas[i].bytes)
+            {
+                __avl_arena_free(&s->_config, y->arenas[i].arena, y->arenas[i].bytes);
+            }
+            else
+            {
+                s->_config._dealloc(y->arenas[i].arena);
+            }
+        }
+        y->narenas = n;
+        if (!wait || (0 == y->nlimbo && 0 == y->narenas))
+        {
+            break;
+        }
+        /*! @note a read section only spans its lookups */
+        __avl_backoff(&_spins);
+    }
+}
+
+/*! @brief wait for the readers to let go of every retired slot, outside of any change */
+static void __avl_set_synchronize(struct avl_set *s)
+{
+    avl_sync *y = s->_sync;
+    if (y && (y->nlimbo || y->narenas))
+    {
+#if !defined(NDEBUG) && defined(_AVL_HAVE_PTHREAD)
+        size_t i;
+        for (i = 0; i < _AVL_MAX_READERS; i++)
+        {
+            /*! @note the writer would wait for its own read section forever */
+            assert(!_AVL_LOAD(&y->readers[i]._epoch, __ATOMIC_ACQUIRE) ||
+                   !pthread_equal(y->readers[i]._owner, pthread_self()));
+        }
+#endif
+        /*! @note readers entering from now on cannot reach what is retired */
+        _AVL_STORE(&y->epoch, y->epoch + 1, __ATOMIC_SEQ_CST);
+        __avl_set_reclaim(s, 1);
+    }
+}
+
+/**
+ * @brief recycle unlinked slot e, once the concurrent readers are done with it
+ * @param destruct destruct the key and the value too, 0 if they are handed to the caller
+ */
+static void __avl_set_retire(struct avl_set *s, uint32_t e, int destruct)
+{
+    avl_sync *y = s->_sync;
+    if (__avl_set_shared(s))
+    {
+        /*! @note older copies of the element may be held by snapshots, they share its key */
+        __avl_set_bury(s, e, destruct);
+        return;
+    }
+    if (NULL == y)
+    {
+        if (destruct)
+        {
+            __avl_set_destruct(s, e);
+        }
+        __avl_set_release(s, e);
+        return;
+    }
+    /*! @note the change has made room for it, see __avl_sync_room() */
+    assert(y->nlimbo < y->lcap);
+    avl_limbo *l = &y->limbo[y->nlimbo++];
+    l->epoch = y->epoch;
+    l->arena = NULL;
+    l->slot = e;
+    l->destruct = (uint32_t)destruct;
+    y->retired = 1;
+}
+
+/*! @brief close the change if one is open, and reclaim what it has retired */
+static void __avl_set_write_end(struct avl_set *s)
+{
+    avl_sync *y = s->_sync;
+    if (y)
+    {
+        if (y->seq & 1)
+        {
+            _AVL_STORE(&y->seq, y->seq + 1, __ATOMIC_RELEASE);
+        }
+        if (y->retired)
+        {
+            /*! @note readers entering from now on cannot reach what this change has retired */
+            _AVL_STORE(&y->epoch, y->epoch + 1, __ATOMIC_SEQ_CST);
+            y->retired = 0;
+            if (y->nlimbo >= _AVL_RECLAIM_THRESHOLD || y->narenas)
+            {
+                __avl_set_reclaim(s, 0);
+            }
+        }
+    }
+}
+
+struct avl_reader *avl_set_reader_register(struct avl_set *s)
+{
+    assert(s);
+    avl_sync *y = s->_sync;
+    if (NULL == y)
+    {
+        return NULL;
+    }
+#ifdef _AVL_HAVE_ATOMIC
+    size_t i;
+    for (i = 0; i < _AVL_MAX_READERS; i++)
+    {
+        int _free = 0;
+        if (__atomic_compare_exchange_n(&y->readers[i]._used, &_free, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            return &y->readers[i];
+        }
+    }
+#endif
+    return NULL;
+}
+
+void avl_set_reader_unregister(struct avl_reader *r)
+{
+    if (r)
+    {
+        assert(0 == r->_epoch);
+        _AVL_STORE(&r->_used, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void avl_set_reader_enter(struct avl_reader *r)
+{
+    assert(r && 0 == r->_epoch);
+#if !defined(NDEBUG) && defined(_AVL_HAVE_PTHREAD)
+    r->_owner = pthread_self();
+#endif
+    _AVL_STORE(&r->_epoch, _AVL_LOAD(&r->_sync->epoch, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    /*! @note the epoch is published before any read of the set */
+    _AVL_FENCE(__ATOMIC_SEQ_CST);
+}
+
+void avl_set_reader_exit(struct avl_reader *r)
+{
+    assert(r && r->_epoch);
+    _AVL_STORE(&r->_epoch, 0, __ATOMIC_RELEASE);
+}
+
+size_t avl_set_size(const struct avl_set *s)
+{
+    return s->_size;
+}
+
+/*! @brief drop all the elements without destructing them */
+static void __avl_set_reset(struct avl_set *s)
+{
+    size_t k;
+    for (k = 0; k < __avl_set_nsegs(s, s->_config._reserve); k++)
+    {
+        memset(_AVL_ELEM(s, k << s->_seg_shift), 0, __avl_set_seg_bytes(s, s->_config._reserve, k));
+    }
+    s->_size = 0;
+    s->_rindex = _AVL_NIL;
+    s->_version++;
+
+    /*! @note maintain available slots */
+    __avl_set_reset_slots(s, 0);
+}
+
+static void __avl_set_auto_shrink(struct avl_set *s, size_t deleted);
+
+void avl_set_clear(struct avl_set *s)
+{
+    /*! @note a mapped set is read-only */
+    if (s && NULL == s->_map)
+    {
+        if ((__avl_set_shared(s) && 0 != __avl_snap_room(s, s->_size)) || 0 != __avl_sync_room(s, s->_size))
+        {
+            /*! @note the snapshots or the readers hold every element, there is no room to keep them */
+            return;
+        }
+        __avl_set_write_begin(s);
+        size_t _cleared = s->_size;
+        int _keep = s->_sync || __avl_set_shared(s);
+        if ((s->_key_destruct || s->_value_destruct || _keep) && _AVL_NIL != s->_rindex)
+        {
+            /*! @note walk the tree, one pending right child per level at most */
+            uint32_t _pending[AVL_MAX_HEIGHT + 1];
+            size_t _depth = 0;
+            _pending[_depth++] = s->_rindex;
+            while (_depth)
+            {
+                uint32_t e = _pending[--_depth];
+                uint32_t left = _avl_left(_AVL_NODE(s, e));
+                uint32_t right = _avl_right(_AVL_NODE(s, e));
+                if (_AVL_NIL != right)
+                    _pending[_depth++] = right;
+                if (_AVL_NIL != left)
+                    _pending[_depth++] = left;
+                if (_keep)
+                {
+                    /*! @note readers or snapshots may still walk the detached nodes */
+                    __avl_set_retire(s, e, 1);
+                }
+                else
+                {
+                    __avl_set_destruct(s, e);
+                }
+            }
+        }
+        if (_keep)
+        {
+            s->_size = 0;
+            s->_rindex = _AVL_NIL;
+            s->_version++;
+        }
+        else
+        {
+            __avl_set_reset(s);
+        }
+        __avl_set_write_end(s);
+        __avl_set_auto_shrink(s, _cleared);
+    }
+}
+
+/*! @brief map the file at path read-only, *bytes is set to its size */
+static void *__avl_file_map(const char *path, size_t *bytes)
+{
+    void *map = NULL;
+#if defined(_AVL_HAVE_MMAP)
+    int fd = open(path, O_RDONLY);
+    if (0 > fd)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (0 == fstat(fd, &st) && 0 < st.st_size)
+    {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == map)
+        {
+            map = NULL;
+        }
+        *bytes = (size_t)st.st_size;
+    }
+    /*! @note the mapping outlives the descriptor */
+    close(fd);
+#else
+    /*! @note without mmap, the file is read into memory at once */
+    FILE *f = fopen(path, "rb");
+    if (NULL == f)
+    {
+        return NULL;
+    }
+    long _end = (0 == fseek(f, 0, SEEK_END)) ? ftell(f) : -1;
+    if (0 < _end && 0 == fseek(f, 0, SEEK_SET))
+    {
+        map = malloc((size_t)_end);
+        if (map && 1 != fread(map, (size_t)_end, 1, f))
+        {
+            free(map);
+            map = NULL;
+        }
+        *bytes = (size_t)_end;
+    }
+    fclose(f);
+#endif
+    return map;
+}
+
+static void __avl_file_unmap(void *map, size_t bytes)
+{
+#if defined(_AVL_HAVE_MMAP)
+    munmap(map, bytes);
+#else
+    (void)bytes;
+    free(map);
+#endif
+}
+
+/*! @brief free everything an emptied avl_set holds but its own storage */
+static void __avl_set_fini(struct avl_set *s)
+{
+    avl_deallocate _f = s->_config._dealloc;
+    avl_sync *y = s->_sync;
+    if (y)
+    {
+        /*! @note no reader is left, everything retired goes now */
+        __avl_set_reclaim(s, 1);
+        if (y->limbo)
+            _f(y->limbo);
+        if (y->arenas)
+            _f(y->arenas);
+        _f(y->raw);
+        s->_sync = NULL;
+    }
+    avl_snap *z = s->_snap;
+    if (z)
+    {
+        /*! @note the snapshots must be released before */
+        assert(NULL == z->newest);
+        _f(z->dead);
+        _f(z);
+        s->_snap = NULL;
+    }
+    /*! free tree array */
+    if (s->_map)
+    {
+        __avl_file_unmap(s->_map, s->_map_bytes);
+        s->_map = NULL;
+        _f(s->_segs);
+    }
+    else
+    {
+        __avl_set_arena_destroy(s, s->_segs, s->_config._reserve);
+    }
+    s->_segs = NULL;
+    if (s->_handed)
+    {
+        _f(s->_handed);
+    }
+    memset(s, 0, sizeof(struct avl_set));
+}
+
+void avl_set_destroy(struct avl_set *s)
+{
+    avl_set_clear(s);
+    if (s)
+    {
+        avl_deallocate _f = s->_config._dealloc;
+        __avl_set_fini(s);
+        _f(s);
+    }
+}
+
+/*! @brief enlarge the arena to new_rsv_size slots */
+static int __avl_set_grow(struct avl_set *s, size_t new_rsv_size)
+{
+    if (new_rsv_size > _AVL_MAX_SLOTS || new_rsv_size <= s->_config._reserve)
+    {
+        /*! @note slot indices are exhausted */
+        return -1;
+    }
+    new_rsv_size = __avl_set_round_reserve(s, new_rsv_size);
+    /*! @note a set growing again keeps its arena whole */
+    __avl_set_undrain(s);
+    size_t _old_rsv = s->_config._reserve;
+    size_t _old_nsegs = __avl_set_nsegs(s, _old_rsv);
+    size_t _new_nsegs = __avl_set_nsegs(s, new_rsv_size);
+    /*! @note the first segment is moved while it grows to a whole segment, the others never move */
+    int _move = (_old_rsv <= s->_seg_mask);
+    uint8_t *nseg0 = NULL;
+    if (_move)
+    {
+        nseg0 = (uint8_t *)__avl_arena_alloc(&s->_config, __avl_set_seg_bytes(s, new_rsv_size, 0));
+    }
+    /*! @note a full directory is doubled */
+    uint8_t **nsegs = s->_segs;
+    size_t _cap = s->_segs_cap;
+    if (_new_nsegs > _cap)
+    {
+        _cap = _AVL_MAX(_new_nsegs, 2 * _cap);
+        nsegs = (uint8_t **)(s->_config._alloc(sizeof(uint8_t *) * _cap));
+    }
+    /*! @note a concurrent set retires the first segment and the directory it replaces */
+    avl_sync *y = s->_sync;
+    if ((_move && NULL == nseg0) || NULL == nsegs ||
+        (y && 0 != __avl_limbo_room(&s->_config, &y->arenas, &y->acap, y->narenas, 2)) ||
+        0 != __avl_set_segs_alloc(s, nsegs, new_rsv_size, _old_nsegs, _new_nsegs))
+    {
+        if (nseg0)
+            __avl_arena_free(&s->_config, nseg0, __avl_set_seg_bytes(s, new_rsv_size, 0));
+        if (nsegs && nsegs != s->_segs)
+            s->_config._dealloc(nsegs);
+        return -1;
+    }
+
+    /*! manually reallocate : copy the first segment, links are slot indices so they stay valid */
+    size_t _old_bytes = __avl_set_seg_bytes(s, _old_rsv, 0);
+    if (_move)
+    {
+        memcpy(nseg0, s->_segs[0], _old_bytes);
+        memset(nseg0 + _old_bytes, 0, __avl_set_seg_bytes(s, new_rsv_size, 0) - _old_bytes);
+    }
+    if (nsegs != s->_segs)
+    {
+        memcpy(nsegs, s->_segs, sizeof(uint8_t *) * _old_nsegs);
+        memset(nsegs + _new_nsegs, 0, sizeof(uint8_t *) * (_cap - _new_nsegs));
+    }
+    uint8_t *_old_seg0 = s->_segs[0];
+    uint8_t **_old_segs = s->_segs;
+
+    /*! the new setup */
+    __avl_set_publish(s);
+    if (y)
+    {
+        /*! @note a reader loading the new capacity loads the new directory, see __avl_set_read_node() */
+        if (_move)
+            _AVL_STORE(&nsegs[0], nseg0, __ATOMIC_RELEASE);
+        _AVL_STORE(&s->_segs, nsegs, __ATOMIC_RELEASE);
+        _AVL_STORE(&s->_segs_cap, _cap, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        if (_move)
+            nsegs[0] = nseg0;
+        s->_segs = nsegs;
+        s->_segs_cap = _cap;
+    }
+
+    if (y)
+    {
+        /*! @note readers may still walk the old first segment and the old directory, they go once they are done */
+        if (_move)
+        {
+            avl_limbo *l = &y->arenas[y->narenas++];
+            l->epoch = y->epoch;
+            l->arena = _old_seg0;
+            l->bytes = _old_bytes;
+        }
+        if (nsegs != _old_segs)
+        {
+            avl_limbo *l = &y->arenas[y->narenas++];
+            l->epoch = y->epoch;
+            l->arena = _old_segs;
+            l->bytes = 0;
+        }
+        y->retired = 1;
+    }
+    else
+    {
+        /*! clean up what was moved */
+        if (_move)
+            __avl_arena_free(&s->_config, _old_seg0, _old_bytes);
+        if (nsegs != _old_segs)
+            s->_config._dealloc(_old_segs);
+    }
+
+    _AVL_STAT(s, grows, 1);
+    _AVL_STAT(s, grow_bytes, (_move ? _old_bytes : 0) + (nsegs != _old_segs ? sizeof(uint8_t *) * _old_nsegs : 0));
+
+    /*! @note the released slots keep their links, the new slots follow the never used ones */
+    s->_slots.avail += new_rsv_size - _old_rsv;
+    s->_config._reserve = new_rsv_size;
+    return 0;
+}
+
+static int __avl_set_reserve_one(struct avl_set *s)
+{
+    if (s->_map)
+    {
+        /*! @note a mapped set is read-only */
+        return -1;
+    }
+    /*! @note a change shared with snapshots copies the slots on its way, and buries them */
+    size_t _needed = __avl_set_shared(s) ? _AVL_COPY_RESERVE + 1 : 1;
+    if (1 < _needed && 0 != __avl_snap_room(s, _needed))
+    {
+        return -1;
+    }
+    if (0 != __avl_sync_room(s, 1))
+    {
+        /*! @note a change of a concurrent set may retire the element it replaces */
+        return -1;
+    }
+    /*! ensure enough size */
+    if (s->_slots.avail >= _needed)
+    {
+        /*! @note there is still enough room for one element */
+        return 0;
+    }
+    if (s->_sync)
+    {
+        /*! @note the retired slots may be free already */
+        __avl_set_reclaim(s, 0);
+        if (s->_slots.avail)
+        {
+            return 0;
+        }
+    }
+    size_t new_rsv_size = s->_config._reserve + (s->_config._reserve / 2) + _AVL_DEFAULT_RESERVE;
+    if (s->_config._reserve > s->_seg_mask)
+    {
+        /*! @note one segment at a time, an insertion never waits for more than one to be allocated */
+        new_rsv_size = s->_config._reserve + s->_seg_mask + 1;
+    }
+    else if (new_rsv_size > s->_seg_mask + 1)
+    {
+        /*! @note the first segment grows up to a whole segment, and no further */
+        new_rsv_size = s->_seg_mask + 1;
+    }
+    if (new_rsv_size < s->_config._reserve + _needed)
+    {
+        new_rsv_size = s->_config._reserve + _needed;
+    }
+    if (new_rsv_size > _AVL_MAX_SLOTS)
+    {
+        new_rsv_size = _AVL_MAX_SLOTS;
+    }
+    return __avl_set_grow(s, new_rsv_size);
+}
+
+/*! @struct avl_path */
+typedef struct _avl_path
+{
+    /*! where the ancestor at depth 0 is linked, the root of the set or of a detached tree */
+    uint32_t *root;
+    /*! number of recorded ancestors */
+    size_t depth;
+    /*! ancestor slots, from the root down */
+    uint32_t slot[AVL_MAX_HEIGHT];
+    /*! direction taken at each ancestor, -1 for left and 1 for right */
+    signed char dir[AVL_MAX_HEIGHT];
+} avl_path;
+
+static void __avl_path_push(avl_path *p, uint32_t e, int dir)
+{
+    assert(p->depth < AVL_MAX_HEIGHT);
+    p->slot[p->depth] = e;
+    p->dir[p->depth] = (signed char)dir;
+    p->depth++;
+}
+
+/*! @brief record the ancestors lo to hi - 1 of the path from the slots of a cursor, each taking the link to the next */
+static void __avl_path_fill(struct avl_set *s, avl_path *p, const uint32_t *slot, size_t lo, size_t hi)
+{
+    for (; lo < hi; lo++)
+    {
+        p->slot[lo] = slot[lo];
+        p->dir[lo] = (signed char)((slot[lo + 1] == _avl_left(_AVL_NODE(s, slot[lo]))) ? -1 : 1);
+    }
+}
+
+/*! @brief make child the subtree found below the d-th ancestor of the path */
+static void __avl_set_relink(struct avl_set *s, const avl_path *p, size_t d, uint32_t child)
+{
+    uint32_t *_link = p->root;
+    uint32_t _v = child;
+    s->_version++;
+    if (0 != d)
+    {
+        avl_node *n = _AVL_NODE(s, p->slot[d - 1]);
+        _link = (0 > p->dir[d - 1]) ? &n->left : &n->right;
+        _v = (*_link & _AVL_HEAVY_BIT) | child;
+    }
+    if (s->_sync)
+    {
+        /*! @note a reader following the link sees the slot it leads to, and the directory holding it */
+        _AVL_STORE(_link, _v, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        *_link = _v;
+    }
+}
+
+/*! @brief make the ancestors of the path from the d-th on private to the set, before they are changed */
+static void __avl_set_own_path(struct avl_set *s, avl_path *p, size_t d)
+{
+    for (; d < p->depth; d++)
+    {
+        if (__avl_set_frozen(s, p->slot[d]))
+        {
+            p->slot[d] = __avl_set_copy(s, p->slot[d]);
+            __avl_set_relink(s, p, d, p->slot[d]);
+        }
+    }
+}
+
+/**
+ * @brief walk up after the subtree below the path has grown by one level, from the ancestor at depth hi - 1 to lo
+ * @param rotated [optional] set to the depth of the rotated ancestor, left as it is if none
+ * @return 1 if the path has grown by one level from lo on
+ */
+static int __avl_set_insert_retrace(struct avl_set *s, const avl_path *p, size_t lo, size_t hi, size_t *rotated)
+{
+    size_t d = hi;
+    while (d-- > lo)
+    {
+        avl_node *n = _AVL_NODE(s, p->slot[d]);
+        int bf = __avl_balance_factor(n) - p->dir[d];
+        if (-1 <= bf && bf <= 1)
+        {
+            __avl_set_balance_factor(n, bf);
+            if (0 == bf)
+            {
+                /*! @note the lower side caught up, height is kept */
+                return 0;
+            }
+            continue;
+        }
+        /*! @note a rotation after insertion always restores the previous height */
+        int shrunk = 0;
+        __avl_set_relink(s, p, d, __avl_rebalance(s, p->slot[d], bf, &shrunk));
+        if (rotated)
+        {
+            *rotated = d;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief walk up after the subtree below the path has shrunk by one level
+ * @return 1 if the whole path has shrunk by one level
+ */
+static int __avl_set_delete_retrace(struct avl_set *s, const avl_path *p)
+{
+    size_t d = p->depth;
+    while (d--)
+    {
+        avl_node *n = _AVL_NODE(s, p->slot[d]);
+        int bf = __avl_balance_factor(n) + p->dir[d];
+        if (-1 <= bf && bf <= 1)
+        {
+            __avl_set_balance_factor(n, bf);
+            if (0 != bf)
+            {
+                /*! @note the other side is still as high as before */
+                return 0;
+            }
+            continue;
+        }
+        int shrunk = 0;
+        __avl_set_relink(s, p, d, __avl_rebalance(s, p->slot[d], bf, &shrunk));
+        if (0 == shrunk)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief detach slot e, the child of the last ancestor of the path, then recycle it
+ * @param destruct destruct the element too, 0 if it is handed to the caller
+ * @note the ancestors must be private to the set, see __avl_set_own_path()
+ */
+static void __avl_set_unlink(struct avl_set *s, avl_path *p, uint32_t e, int destruct)
+{
+    avl_node *self = _AVL_NODE(s, e);
+    uint32_t left = _avl_left(self);
+    uint32_t right = _avl_right(self);
+    size_t d = p->depth;
+    if (_AVL_NIL != left && _AVL_NIL != right)
+    {
+        /*! @note take the neighbour from the higher side, which has at most one child */
+        int dir = (0 > __avl_balance_factor(self)) ? 1 : -1;
+        __avl_path_push(p, e, dir);
+        uint32_t victim = (0 < dir) ? right : left;
+        while (1)
+        {
+            avl_node *v = _AVL_NODE(s, victim);
+            uint32_t _next = (0 < dir) ? _avl_left(v) : _avl_right(v);
+            if (_AVL_NIL == _next)
+            {
+                break;
+            }
+            __avl_path_push(p, victim, -dir);
+            victim = _next;
+        }
+        /*! @note the target and the way down to the victim are changed as well */
+        __avl_set_own_path(s, p, d);
+        e = p->slot[d];
+        self = _AVL_NODE(s, e);
+        victim = __avl_set_own_child(s, p->slot[p->depth - 1], p->dir[p->depth - 1]);
+        avl_node *v = _AVL_NODE(s, victim);
+        /*! @note detach the victim from its parent, which may be the target itself */
+        __avl_set_relink(s, p, p->depth, (0 < dir) ? _avl_right(v) : _avl_left(v));
+        /*! @note the victim takes over the links and the balance of the target */
+        _AVL_STORE(&v->left, self->left, __ATOMIC_RELAXED);
+        _AVL_STORE(&v->right, self->right, __ATOMIC_RELAXED);
+        if (s->_count_off)
+        {
+            _AVL_COUNT(s, victim) = _AVL_COUNT(s, e);
+        }
+        p->slot[d] = victim;
+        __avl_set_relink(s, p, d, victim);
+    }
+    else
+    {
+        /*! @note a leaf is replaced by NIL, otherwise by its only child */
+        __avl_set_relink(s, p, d, (_AVL_NIL == left) ? right : left);
+    }
+    if (s->_count_off)
+    {
+        /*! @note every node left on the path loses one element */
+        size_t i;
+        for (i = 0; i < p->depth; i++)
+        {
+            _AVL_COUNT(s, p->slot[i])--;
+        }
+    }
+    /*! @note target slot can be recycled */
+    __avl_set_retire(s, e, destruct);
+    __avl_set_delete_retrace(s, p);
+}
+
+/*! @brief slot of k in the tree under root, NIL if not found */
+static uint32_t __avl_set_search(struct avl_set *s, uint32_t root, const void *k)
+{
+    uint32_t e = root;
+    size_t _depth = 0;
+    uint64_t kp = __avl_set_prefix(s, k);
+    while (_AVL_NIL != e)
+    {
+        if (AVL_MAX_HEIGHT == _depth++)
+        {
+            /*! @note only a torn read of a concurrent set goes that deep, it is retried */
+            return _AVL_NIL;
+        }
+        avl_node *self = __avl_set_read_node(s, e);
+        if (NULL == self)
+        {
+            return _AVL_NIL;
+        }
+        int cmpret = __avl_set_compare_at(s, k, kp, self);
+        if (0 == cmpret)
+        {
+            /*! @brief found */
+            break;
+        }
+        e = __avl_set_read_link(s, self, cmpret);
+    }
+    /*! @brief NIL if not found */
+    return e;
+}
+
+void *avl_set_search(struct avl_set *s, const void *k)
+{
+    assert(s);
+    void *_found = NULL;
+    size_t _seq = 0;
+    do
+    {
+        _seq = __avl_set_read_begin(s);
+        uint32_t e = __avl_set_search(s, __avl_set_read_root(s), k);
+        /*! @brief NULL if not found */
+        _found = (_AVL_NIL == e) ? NULL : __avl_set_read_key(s, e);
+    } while (!__avl_set_read_validate(s, _seq));
+    return _found;
+}
+
+/**
+ * @brief the element of slot e as handed to the caller, who owns it from now on
+ * @note an inline key is copied out of the arena, the slot is recycled; the room is made by __avl_set_hand_room()
+ */
+static void *__avl_set_hand_over(struct avl_set *s, uint32_t e)
+{
+    if (0 == s->_key_size)
+    {
+        return (void *)_AVL_KEY(s, e);
+    }
+    memcpy(s->_handed, _AVL_INLINE_KEY(s, e), s->_key_size);
+    return s->_handed;
+}
+
+/*! @brief make room for an inline key handed to the caller, before any change */
+static int __avl_set_hand_room(struct avl_set *s)
+{
+    if (s->_key_size && NULL == s->_handed)
+    {
+        s->_handed = s->_config._alloc(s->_key_size);
+    }
+    return (s->_key_size && NULL == s->_handed) ? -1 : 0;
+}
+
+/**
+ * @brief record the path from the root down to k
+ * @return slot of k, NIL if k is absent and the path leads to the edge where k belongs
+ */
+static uint32_t __avl_set_descend(struct avl_set *s, const void *k, avl_path *path)
+{
+    uint32_t e = s->_rindex;
+    uint64_t kp = __avl_set_prefix(s, k);
+    path->root = &s->_rindex;
+    path->depth = 0;
+    while (_AVL_NIL != e)
+    {
+        avl_node *self = _AVL_NODE(s, e);
+        int cmpret = __avl_set_compare_at(s, k, kp, self);
+        if (0 == cmpret)
+        {
+            break;
+        }
+        __avl_path_push(path, e, (0 > cmpret) ? -1 : 1);
+        e = (0 > cmpret) ? _avl_left(self) : _avl_right(self);
+    }
+    return e;
+}
+
+/**
+ * @brief point the cursor to slot e, attached below the path and retraced with a rotation at depth r
+ * @param kept ancestors the cursor already holds at the head of its path, up to r
+ * @note a rotation rearranges the ancestors at the depths r to r + 2 only, r is the depth of the path if none
+ */
+static void __avl_cursor_attached(struct avl_set_cursor *c, const avl_path *p, size_t kept, size_t r, uint32_t e)
+{
+    size_t n = kept;
+    size_t i;
+    for (i = kept; i < r && i < p->depth; i++)
+    {
+        c->_path[n++] = p->slot[i];
+    }
+    if (r < p->depth)
+    {
+        if (p->dir[r] == p->dir[r + 1])
+        {
+            /*! @note single rotation, the child takes the place of the unbalanced ancestor */
+            c->_path[n++] = p->slot[r + 1];
+            i = r + 2;
+        }
+        else if (r + 2 < p->depth)
+        {
+            /*! @note double rotation, so does the grandchild, its child towards e is one of the two above it */
+            c->_path[n++] = p->slot[r + 2];
+            c->_path[n++] = (p->dir[r + 2] == p->dir[r]) ? p->slot[r + 1] : p->slot[r];
+            i = r + 3;
+        }
+        else
+        {
+            /*! @note double rotation around e itself */
+            i = p->depth;
+        }
+    }
+    for (; i < p->depth; i++)
+    {
+        c->_path[n++] = p->slot[i];
+    }
+    c->_path[n++] = e;
+    c->_depth = n;
+}
+
+/**
+ * @brief insert k into a new slot at the edge the path leads to, the set must have a free slot
+ * @param rec first ancestor recorded in the path, those above it are read from the path of c
+ * @param v [optional] value stored with k, zero-filled if NULL
+ * @param c [optional unless rec] cursor moved to k
+ * @return the new slot
+ * @note the ancestors of the cursor are read in chunks doubling in length, only as far as the retrace climbs, so
+ * with a set keeping no order statistics and sharing no slot, the cursor follows k in amortized O(1)
+ */
+static uint32_t __avl_set_attach(struct avl_set *s, avl_path *path, size_t rec, void *k, const void *v,
+                                 struct avl_set_cursor *c)
+{
+    uint32_t empty_slot = __avl_set_take_slot(s);
+    if (_AVL_NIL == empty_slot)
+    {
+        assert(0);
+        return _AVL_NIL;
+    }
+    avl_node *ret = _AVL_NODE(s, empty_slot);
+    ret->left = _AVL_NIL;
+    ret->right = _AVL_NIL;
+    if (s->_birth_off)
+    {
+        _AVL_BIRTH(s, empty_slot) = s->_snap->version;
+    }
+    __avl_store_key(s, (uint32_t)empty_slot, k);
+    __avl_store_value(s, (uint32_t)empty_slot, v);
+    __avl_set_write_begin(s);
+    s->_size++;
+    __avl_set_own_path(s, path, rec);
+    __avl_set_publish(s);
+    __avl_set_relink(s, path, path->depth, (uint32_t)empty_slot);
+    if (s->_count_off)
+    {
+        assert(0 == rec);
+        /*! @note every ancestor gains one element */
+        _AVL_COUNT(s, empty_slot) = 1;
+        size_t d;
+        for (d = 0; d < path->depth; d++)
+        {
+            _AVL_COUNT(s, path->slot[d])++;
+        }
+    }
+    /*! @note do some AVL stuff */
+    size_t _rotated = path->depth;
+    size_t _kept = rec ? rec + 1 : 0;
+    size_t _top = path->depth;
+    size_t _chunk = _AVL_RETRACE_CHUNK;
+    while (0 < _top)
+    {
+        size_t _lo = (_top > _chunk) ? _top - _chunk : 0;
+        if (rec && rec >= _lo)
+        {
+            /*! @note the relink of a rotation at _lo reads the ancestor above it as well */
+            size_t _from = _lo ? _lo - 1 : 0;
+            __avl_path_fill(s, path, c->_path, _from, rec);
+            rec = _from;
+        }
+        if (!__avl_set_insert_retrace(s, path, _lo, _top, &_rotated))
+        {
+            break;
+        }
+        _top = _lo;
+        _chunk *= 2;
+    }
+    if (c)
+    {
+        __avl_cursor_attached(c, path, (_kept < _rotated) ? _kept : _rotated, _rotated, (uint32_t)empty_slot);
+    }
+#if defined(AVL_STATS)
+    {
+        size_t _height = (size_t)__avl_set_height(s, s->_rindex);
+        if (_height > s->_stats.max_height)
+        {
+            s->_stats.max_height = _height;
+        }
+    }
+#endif
+    return (uint32_t)empty_slot;
+}
+
+/**
+ * @brief assign k and v to slot e, found at the end of the path, a concurrent or shared set must have a free slot
+ * @param prev [optional] set to the previous element with AVL_ASSIGN_DETACH, destroyed otherwise
+ * @return slot holding k, a fresh one when the readers or the snapshots may hold e
+ */
+static uint32_t __avl_set_assign(struct avl_set *s, avl_path *path, uint32_t e, void *k, const void *v,
+                                 enum avl_assign assign, void **prev)
+{
+    int _detach = (AVL_ASSIGN_DETACH == assign);
+    if (_detach)
+    {
+        *prev = __avl_set_hand_over(s, e);
+    }
+    __avl_set_write_begin(s);
+    if (s->_sync || __avl_set_shared(s))
+    {
+        /*! @note readers or snapshots may hold the previous element, a fresh slot takes its place */
+        __avl_set_own_path(s, path, 0);
+        uint32_t _fresh = __avl_set_take_slot(s);
+        memcpy(_AVL_ELEM(s, _fresh), _AVL_ELEM(s, e), s->_key_off);
+        if (s->_birth_off)
+        {
+            _AVL_BIRTH(s, _fresh) = s->_snap->version;
+        }
+        __avl_store_key(s, _fresh, k);
+        __avl_store_value(s, _fresh, v);
+        __avl_set_publish(s);
+        __avl_set_relink(s, path, path->depth, _fresh);
+        __avl_set_retire(s, e, !_detach);
+        return _fresh;
+    }
+    if (!_detach)
+    {
+        /*! @note key duplicated, destroy the previous element*/
+        __avl_set_destruct(s, e);
+    }
+    __avl_store_key(s, e, k);
+    __avl_store_value(s, e, v);
+    return e;
+}
+
+/**
+ * @brief find the slot of k, or insert k if it is absent
+ * @param v [optional] value stored with a new or replacing k, zero-filled if NULL
+ * @param assign on duplication, keep the previous element, or store k instead and destroy or detach the previous one
+ * @param inserted set to 1 if a new slot is taken for k
+ * @param prev [optional] on duplication, the kept or the detached element, required to detach
+ * @return slot of k, NIL on allocation failure
+ * @note the change is opened after the descent, the caller closes it with __avl_set_write_end()
+ * @note an element found and kept needs no room, only a change reserves the slots
+ */
+static uint32_t __avl_set_emplace(struct avl_set *s, void *k, const void *v, enum avl_assign assign, int *inserted,
+                                  void **prev)
+{
+    *inserted = 0;
+    assert(AVL_ASSIGN_DETACH != assign || prev);
+    avl_path path;
+    uint32_t e = __avl_set_descend(s, k, &path);
+    if (_AVL_NIL != e && AVL_ASSIGN_KEEP == assign)
+    {
+        if (prev)
+        {
+            *prev = __avl_key(s, e);
+        }
+        return e;
+    }
+    /*! @note a new slot is needed for k, or for the copy of an element the readers or the snapshots may hold */
+    if (s->_map || ((_AVL_NIL == e || s->_sync || __avl_set_shared(s)) && 0 != __avl_set_reserve_one(s)))
+    {
+        /*! @note a mapped set is read-only, the others are out of room */
+        return _AVL_NIL;
+    }
+    if (_AVL_NIL != e)
+    {
+        return __avl_set_assign(s, &path, e, k, v, assign, prev);
+    }
+    *inserted = 1;
+    return __avl_set_attach(s, &path, 0, k, v, NULL);
+}
+
+int avl_set_insert_or_assign(struct avl_set *s, void *k, enum avl_assign assign, void **prev)
+{
+    assert(s);
+    int inserted = 0;
+    if (prev)
+    {
+        *prev = NULL;
+    }
+    if (AVL_ASSIGN_DETACH == assign && (NULL == prev || 0 != __avl_set_hand_room(s)))
+    {
+        /*! @note nobody would take the detached element */
+        return -1;
+    }
+    uint32_t e = __avl_set_emplace(s, k, NULL, assign, &inserted, prev);
+    __avl_set_write_end(s);
+    if (_AVL_NIL == e)
+    {
+        return -1;
+    }
+    if (AVL_ASSIGN_DETACH == assign && !inserted)
+    {
+        /*! @note the caller owns the detached element once no reader can reach it */
+        __avl_set_synchronize(s);
+    }
+    /*! success on size increasing, no change means duplicated*/
+    return inserted ? 0 : 1;
+}
+
+int avl_set_insert(struct avl_set *s, void *k)
+{
+    return avl_set_insert_or_assign(s, k, AVL_ASSIGN_REPLACE, NULL);
+}
+
+void *avl_set_find_or_insert(struct avl_set *s, void *k, int *inserted)
+{
+    assert(s);
+    int _inserted = 0;
+    uint32_t e = __avl_set_emplace(s, k, NULL, AVL_ASSIGN_KEEP, &_inserted, NULL);
+    __avl_set_write_end(s);
+    if (inserted)
+    {
+        *inserted = _inserted;
+    }
+    return (_AVL_NIL == e) ? NULL : __avl_key(s, e);
+}
+
+/**
+ * @brief remove k from the set
+ * @param out [optional] set to the removed element, handed to the caller instead of being destroyed
+ * @return the number of removed elements
+ * @note the change is opened after the descent, the caller closes it with __avl_set_write_end()
+ */
+static int __avl_set_erase(struct avl_set *s, const void *k, void **out)
+{
+    avl_path path;
+    uint32_t e = __avl_set_descend(s, k, &path);
+    if (_AVL_NIL == e || s->_map)
+    {
+        /*! @note target not found, or the set is read-only */
+        return 0;
+    }
+    if (0 != __avl_sync_room(s, 1))
+    {
+        return 0;
+    }
+    __avl_set_write_begin(s);
+    if (__avl_set_shared(s))
+    {
+        /*! @note the copies of the shared slots need room */
+        if (0 != __avl_set_reserve_one(s))
+        {
+            return 0;
+        }
+        __avl_set_own_path(s, &path, 0);
+    }
+    if (out)
+    {
+        *out = __avl_set_hand_over(s, e);
+    }
+    __avl_set_unlink(s, &path, e, NULL == out);
+    /*! update size */
+    s->_size--;
+    return 1;
+}
+
+int avl_set_delete(struct avl_set *s, const void *k)
+{
+    assert(s);
+    int _erased = __avl_set_erase(s, k, NULL);
+    __avl_set_write_end(s);
+    if (_erased)
+    {
+        __avl_set_auto_shrink(s, 1);
+    }
+    return _erased ? 0 : -1;
+}
+
+void *avl_set_extract(struct avl_set *s, const void *k)
+{
+    assert(s);
+    void *_found = NULL;
+    if (0 != __avl_set_hand_room(s))
+    {
+        return NULL;
+    }
+    int _erased = __avl_set_erase(s, k, &_found);
+    __avl_set_write_end(s);
+    if (_erased)
+    {
+        /*! @note the caller owns the element once no reader can reach it */
+        __avl_set_synchronize(s);
+        __avl_set_auto_shrink(s, 1);
+    }
+    return _found;
+}
+
+void *avl_set_cursor_get(const struct avl_set_cursor *c)
+{
+    assert(c);
+    if (0 == c->_depth)
+    {
+        /*! @brief out of range */
+        return NULL;
+    }
+    return __avl_set_read_key(c->_set, c->_path[c->_depth - 1]);
+}
+
+/*! @brief extend the path of the cursor to the leftmost (dir < 0) or rightmost element below e */
+static void *__avl_cursor_descend(struct avl_set_cursor *c, uint32_t e, int dir)
+{
+    struct avl_set *s = c->_set;
+    while (_AVL_NIL != e)
+    {
+        if (AVL_MAX_HEIGHT == c->_depth)
+        {
+            /*! @note only a torn read of a concurrent set goes that deep, it is retried */
+            assert(s->_sync);
+            c->_depth = 0;
+            return NULL;
+        }
+        avl_node *n = __avl_set_read_node(s, e);
+        if (NULL == n)
+        {
+            c->_depth = 0;
+            return NULL;
+        }
+        c->_path[c->_depth++] = e;
+        e = __avl_set_read_link(s, n, dir);
+    }
+    return avl_set_cursor_get(c);
+}
+
+/*! @brief move the cursor one step forward (dir > 0) or backward */
+static void *__avl_cursor_step(struct avl_set_cursor *c, int dir)
+{
+    struct avl_set *s = c->_set;
+    if (0 == c->_depth)
+    {
+        return NULL;
+    }
+    /*! @note a hint is trusted at the element avl_set_insert_hint() left it at only */
+    c->_version = 0;
+    avl_node *n = __avl_set_read_node(s, c->_path[c->_depth - 1]);
+    uint32_t child = n ? __avl_set_read_link(s, n, dir) : _AVL_NIL;
+    if (_AVL_NIL != child)
+    {
+        /*! @note the neighbour is the extreme element of the subtree on that side */
+        return __avl_cursor_descend(c, child, -dir);
+    }
+    /*! @note otherwise climb until we come up from the other side */
+    while (1)
+    {
+        uint32_t from = c->_path[--c->_depth];
+        if (0 == c->_depth)
+        {
+            return NULL;
+        }
+        avl_node *parent = __avl_set_read_node(s, c->_path[c->_depth - 1]);
+        if (parent && from == __avl_set_read_link(s, parent, -dir))
+        {
+            return avl_set_cursor_get(c);
+        }
+    }
+}
+
+/*! @brief position the cursor under root to the first element greater than k (strict) or not less than k */
+static void *__avl_cursor_seek(struct avl_set *s, uint32_t root, const void *k, struct avl_set_cursor *c, int strict)
+{
+    size_t _found = 0;
+    uint32_t e = root;
+    uint64_t kp = __avl_set_prefix(s, k);
+    c->_set = s;
+    c->_depth = 0;
+    c->_version = 0;
+    while (_AVL_NIL != e)
+    {
+        avl_node *self = __avl_set_read_node(s, e);
+        if (NULL == self || AVL_MAX_HEIGHT == c->_depth)
+        {
+            /*! @note only a torn read of a concurrent set goes that deep, it is retried */
+            assert(s->_sync);
+            c->_depth = 0;
+            return NULL;
+        }
+        int cmpret = __avl_set_compare_at(s, k, kp, self);
+        c->_path[c->_depth++] = e;
+        if (0 > cmpret || (0 == cmpret && !strict))
+        {
+            /*! @note candidate, a closer one can only be on the left */
+            _found = c->_depth;
+            if (0 == cmpret)
+            {
+                break;
+            }
+            e = __avl_set_read_link(s, self, -1);
+        }
+        else
+        {
+            e = __avl_set_read_link(s, self, 1);
+        }
+    }
+    /*! @note the ancestors of the candidate are a prefix of the path */
+    c->_depth = _found;
+    return avl_set_cursor_get(c);
+}
+
+/*! @brief position the cursor to the first (dir < 0) or the last element */
+static void *__avl_cursor_edge(struct avl_set *s, struct avl_set_cursor *c, int dir)
+{
+    void *_found = NULL;
+    do
+    {
+        c->_seq = __avl_set_read_begin(s);
+        c->_set = s;
+        c->_depth = 0;
+        c->_version = 0;
+        _found = __avl_cursor_descend(c, __avl_set_read_root(s), dir);
+    } while (!__avl_set_read_validate(s, c->_seq));
+    return _found;
+}
+
+/*! @brief position the cursor to the neighbour of k, next (dir > 0) or previous one */
+static void *__avl_cursor_reseek(struct avl_set *s, const void *k, struct avl_set_cursor *c, int dir)
+{
+    uint32_t _root = __avl_set_read_root(s);
+    if (0 < dir)
+    {
+        return __avl_cursor_seek(s, _root, k, c, 1);
+    }
+    if (__avl_cursor_seek(s, _root, k, c, 0))
+    {
+        return __avl_cursor_step(c, -1);
+    }
+    /*! @note every element is less than k */
+    c->_depth = 0;
+    return __avl_cursor_descend(c, _root, 1);
+}
+
+/*! @brief move the cursor one step forward (dir > 0) or backward, finding its way back after a change */
+static void *__avl_cursor_move(struct avl_set_cursor *c, int dir)
+{
+    struct avl_set *s = c->_set;
+    if (NULL == s->_sync || 0 == c->_depth)
+    {
+        return __avl_cursor_step(c, dir);
+    }
+    /*! @note the current element stays alive until the reader exits, even if deleted meanwhile */
+    const void *k = avl_set_cursor_get(c);
+    while (1)
+    {
+        size_t _seq = __avl_set_read_begin(s);
+        void *_found = (_seq == c->_seq) ? __avl_cursor_step(c, dir) : __avl_cursor_reseek(s, k, c, dir);
+        if (__avl_set_read_validate(s, _seq))
+        {
+            c->_seq = _seq;
+            return _found;
+        }
+    }
+}
+
+/*! @brief position the cursor to the first element greater than k (strict) or not less than k */
+static void *__avl_cursor_bound(struct avl_set *s, const void *k, struct avl_set_cursor *c, int strict)
+{
+    void *_found = NULL;
+    do
+    {
+        c->_seq = __avl_set_read_begin(s);
+        _found = __avl_cursor_seek(s, __avl_set_read_root(s), k, c, strict);
+    } while (!__avl_set_read_validate(s, c->_seq));
+    return _found;
+}
+
+void *avl_set_first(struct avl_set *s, struct avl_set_cursor *c)
+{
+    assert(s && c);
+    return __avl_cursor_edge(s, c, -1);
+}
+
+void *avl_set_last(struct avl_set *s, struct avl_set_cursor *c)
+{
+    assert(s && c);
+    return __avl_cursor_edge(s, c, 1);
+}
+
+void *avl_set_next(struct avl_set_cursor *c)
+{
+    assert(c);
+    return __avl_cursor_move(c, 1);
+}
+
+void *avl_set_prev(struct avl_set_cursor *c)
+{
+    assert(c);
+    return __avl_cursor_move(c, -1);
+}
+
+void *avl_set_lower_bound(struct avl_set *s, const void *k, struct avl_set_cursor *c)
+{
+    assert(s && c);
+    return __avl_cursor_bound(s, k, c, 0);
+}
+
+void *avl_set_upper_bound(struct avl_set *s, const void *k, struct avl_set_cursor *c)
+{
+    assert(s && c);
+    return __avl_cursor_bound(s, k, c, 1);
+}
+
+/**
+ * @brief record the path to the edge where k belongs, starting from the element of the cursor
+ * @param rec set to the first ancestor recorded in the path, those above it are left in the cursor
+ * @return 0 if k falls right after that element, otherwise -1 and the path is to be recorded from the root
+ * @note the hint left by the last change of the set is trusted along with the successor of its element; any other
+ * cursor is checked through its links, and its path is recorded from the root
+ */
+static int __avl_set_hint_path(struct avl_set *s, const void *k, struct avl_set_cursor *c, avl_path *path,
+                               size_t *rec)
+{
+    path->root = &s->_rindex;
+    path->depth = 0;
+    *rec = 0;
+    if (c->_set != s || 0 == c->_depth || c->_path[0] != s->_rindex)
+    {
+        return -1;
+    }
+    uint32_t _succ = _AVL_NIL;
+    size_t i;
+    if (c->_version == s->_version && 0 == s->_count_off && !__avl_set_shared(s))
+    {
+        /*! @note nothing has changed since the hint was left, the ancestors are read from it when needed */
+        _succ = c->_succ;
+        *rec = c->_depth - 1;
+        path->depth = *rec;
+    }
+    else
+    {
+        /*! @note a stale cursor is caught by its links, a path of the tree needs no comparison */
+        for (i = 0; i + 1 < c->_depth; i++)
+        {
+            avl_node *n = _AVL_NODE(s, c->_path[i]);
+            if (c->_path[i + 1] == _avl_left(n))
+            {
+                __avl_path_push(path, c->_path[i], -1);
+            }
+            else if (c->_path[i + 1] == _avl_right(n))
+            {
+                __avl_path_push(path, c->_path[i], 1);
+            }
+            else
+            {
+                return -1;
+            }
+        }
+    }
+    uint64_t kp = __avl_set_prefix(s, k);
+    uint32_t e = c->_path[c->_depth - 1];
+    if (0 >= __avl_set_compare_at(s, k, kp, _AVL_NODE(s, e)))
+    {
+        return -1;
+    }
+    /*! @note the edge right after the element is the leftmost one of its right subtree */
+    __avl_path_push(path, e, 1);
+    for (e = _avl_right(_AVL_NODE(s, e)); _AVL_NIL != e; e = _avl_left(_AVL_NODE(s, e)))
+    {
+        __avl_path_push(path, e, -1);
+    }
+    /*! @note k must also stay below the successor, the last element the path turns left at */
+    for (i = path->depth; i > *rec; i--)
+    {
+        if (0 > path->dir[i - 1])
+        {
+            _succ = path->slot[i - 1];
+            break;
+        }
+    }
+    if (_AVL_NIL != _succ && 0 <= __avl_set_compare_at(s, k, kp, _AVL_NODE(s, _succ)))
+    {
+        return -1;
+    }
+    /*! @note so is the successor of k once inserted */
+    c->_succ = _succ;
+    return 0;
+}
+
+int avl_set_insert_hint(struct avl_set *s, void *k, struct avl_set_cursor *hint)
+{
+    assert(s && hint);
+    int ret = 0;
+    if (0 != __avl_set_reserve_one(s))
+    {
+        ret = -1;
+    }
+    else
+    {
+        avl_path path;
+        if (hint->_set != s || 0 == hint->_depth)
+        {
+            /*! @note without a position, appending is the best guess */
+            hint->_set = s;
+            hint->_depth = 0;
+            hint->_version = 0;
+            __avl_cursor_descend(hint, s->_rindex, 1);
+        }
+        uint32_t e = _AVL_NIL;
+        size_t _rec = 0;
+        int _hinted = (0 == __avl_set_hint_path(s, k, hint, &path, &_rec));
+        if (!_hinted)
+        {
+            e = __avl_set_descend(s, k, &path);
+        }
+        if (_AVL_NIL != e)
+        {
+            /*! @note key duplicated, replaced as avl_set_insert() does, the descent already recorded the path */
+            e = __avl_set_assign(s, &path, e, k, NULL, AVL_ASSIGN_REPLACE, NULL);
+            __avl_cursor_attached(hint, &path, 0, path.depth, e);
+            ret = 1;
+        }
+        else
+        {
+            __avl_set_attach(s, &path, _rec, k, NULL, hint);
+        }
+        /*! @note the successor is known after a hinted insertion only, the next one checks the links otherwise */
+        hint->_version = _hinted ? s->_version : 0;
+    }
+    __avl_set_write_end(s);
+    hint->_seq = __avl_set_read_begin(s);
+    return ret;
+}
+
+/*! @brief number of elements less than k, the set must maintain order statistics */
+static size_t __avl_set_rank(struct avl_set *s, const void *k)
+{
+    size_t _rank = 0;
+    size_t _depth = 0;
+    uint32_t e = __avl_set_read_root(s);
+    uint64_t kp = __avl_set_prefix(s, k);
+    while (_AVL_NIL != e && AVL_MAX_HEIGHT > _depth++)
+    {
+        avl_node *self = __avl_set_read_node(s, e);
+        if (NULL == self)
+        {
+            /*! @note a torn read of a concurrent set, it is retried */
+            break;
+        }
+        int cmpret = __avl_set_compare_at(s, k, kp, self);
+        if (0 < cmpret)
+        {
+            /*! @note the left subtree and e itself are less than k */
+            _rank += __avl_set_read_count(s, __avl_set_read_link(s, self, -1)) + 1;
+            e = __avl_set_read_link(s, self, 1);
+        }
+        else
+        {
+            e = __avl_set_read_link(s, self, -1);
+        }
+    }
+    return _rank;
+}
+
+int avl_set_rank(struct avl_set *s, const void *k, size_t *rank)
+{
+    assert(s && rank);
+    if (0 == s->_count_off)
+    {
+        return -1;
+    }
+    size_t _seq = 0;
+    do
+    {
+        _seq = __avl_set_read_begin(s);
+        *rank = __avl_set_rank(s, k);
+    } while (!__avl_set_read_validate(s, _seq));
+    return 0;
+}
+
+/*! @brief the i-th element in order, the set must maintain order statistics */
+static void *__avl_set_select(struct avl_set *s, size_t i, struct avl_set_cursor *c)
+{
+    if (i >= s->_size)
+    {
+        return NULL;
+    }
+    if (c)
+    {
+        c->_set = s;
+        c->_depth = 0;
+        c->_version = 0;
+    }
+    uint32_t e = __avl_set_read_root(s);
+    size_t _depth = 0;
+    while (1)
+    {
+        avl_node *self = (_AVL_NIL == e) ? NULL : __avl_set_read_node(s, e);
+        if (NULL == self || AVL_MAX_HEIGHT == _depth++)
+        {
+            /*! @note only a torn read of a concurrent set gets lost, it is retried */
+            assert(s->_sync);
+            if (c)
+                c->_depth = 0;
+            return NULL;
+        }
+        if (c)
+        {
+            c->_path[c->_depth++] = e;
+        }
+        uint32_t _left = __avl_set_read_link(s, self, -1);
+        size_t _lcount = __avl_set_read_count(s, _left);
+        if (i == _lcount)
+        {
+            return __avl_key_at(s, self);
+        }
+        else if (i < _lcount)
+        {
+            e = _left;
+        }
+        else
+        {
+            i -= _lcount + 1;
+            e = __avl_set_read_link(s, self, 1);
+        }
+    }
+}
+
+void *avl_set_select(struct avl_set *s, size_t i, struct avl_set_cursor *c)
+{
+    assert(s);
+    if (0 == s->_count_off)
+    {
+        return NULL;
+    }
+    void *_found = NULL;
+    size_t _seq = 0;
+    do
+    {
+        _seq = __avl_set_read_begin(s);
+        _found = __avl_set_select(s, i, c);
+    } while (!__avl_set_read_validate(s, _seq));
+    if (c)
+    {
+        c->_seq = _seq;
+    }
+    return _found;
+}
+
+int avl_set_count_range(struct avl_set *s, const void *from, const void *to, size_t *count)
+{
+    assert(s && count);
+    if (0 == s->_count_off)
+    {
+        return -1;
+    }
+    size_t _lo = 0;
+    size_t _hi = 0;
+    size_t _seq = 0;
+    do
+    {
+        _seq = __avl_set_read_begin(s);
+        _lo = __avl_set_rank(s, from);
+        _hi = __avl_set_rank(s, to);
+    } while (!__avl_set_read_validate(s, _seq));
+    *count = (_hi > _lo) ? (_hi - _lo) : 0;
+    return 0;
+}
+
+struct avl_map *avl_map_create(avl_compare cmp, avl_destruct kdtor, avl_destruct vdtor, size_t value_size,
+                               const struct avl_config *cfg)
+{
+    if (0 == value_size)
+    {
+        value_size = sizeof(void *);
+    }
+    return (struct avl_map *)__avl_set_create(cmp, kdtor, vdtor, value_size, cfg);
+}
+
+size_t avl_map_size(const struct avl_map *m)
+{
+    return avl_set_size(&(m->_set));
+}
+
+void avl_map_clear(struct avl_map *m)
+{
+    avl_set_clear(m ? &(m->_set) : NULL);
+}
+
+void avl_map_destroy(struct avl_map *m)
+{
+    avl_set_destroy(m ? &(m->_set) : NULL);
+}
+
+void *avl_map_get(struct avl_map *m, const void *k)
+{
+    assert(m);
+    struct avl_set *s = &(m->_set);
+    void *_found = NULL;
+    size_t _seq = 0;
+    do
+    {
+        _seq = __avl_set_read_begin(s);
+        uint32_t e = __avl_set_search(s, __avl_set_read_root(s), k);
+        avl_node *n = (_AVL_NIL == e) ? NULL : __avl_set_read_node(s, e);
+        _found = n ? (void *)((uint8_t *)n + s->_value_off) : NULL;
+    } while (!__avl_set_read_validate(s, _seq));
+    return _found;
+}
+
+int avl_map_put(struct avl_map *m, void *k, const void *v)
+{
+    assert(m);
+    struct avl_set *s = &(m->_set);
+    int inserted = 0;
+    uint32_t e = __avl_set_emplace(s, k, v, AVL_ASSIGN_REPLACE, &inserted, NULL);
+    __avl_set_write_end(s);
+    if (_AVL_NIL == e)
+    {
+        return -1;
+    }
+    return inserted ? 0 : 1;
+}
+
+int avl_map_erase(struct avl_map *m, const void *k)
+{
+    assert(m);
+    return avl_set_delete(&(m->_set), k);
+}
+
+void *avl_map_get_or_insert(struct avl_map *m, void *k, int *inserted)
+{
+    assert(m);
+    struct avl_set *s = &(m->_set);
+    int _inserted = 0;
+    uint32_t e = __avl_set_emplace(s, k, NULL, AVL_ASSIGN_KEEP, &_inserted, NULL);
+    __avl_set_write_end(s);
+    if (inserted)
+    {
+        *inserted = _inserted;
+    }
+    return (_AVL_NIL == e) ? NULL : _AVL_VALUE(s, e);
+}
+
+/*! @brief height of a tree of n elements built by __avl_set_build() */
+static int __avl_build_height(size_t n)
+{
+    int h = 0;
+    while (n)
+    {
+        h++;
+        n >>= 1;
+    }
+    return h;
+}
+
+/**
+ * @brief link the slots [lo, hi) into a perfectly balanced tree, the i-th element in order being in slot i
+ * @param map [optional] slot of the i-th element is map[i] instead of i
+ * @return root of the tree, NIL if the range is empty
+ */
+static uint32_t __avl_set_build(struct avl_set *s, const uint32_t *map, size_t lo, size_t hi)
+{
+    if (lo >= hi)
+    {
+        return _AVL_NIL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    uint32_t e = map ? map[mid] : (uint32_t)mid;
+    avl_node *n = _AVL_NODE(s, e);
+    n->left = __avl_set_build(s, map, lo, mid);
+    n->right = __avl_set_build(s, map, mid + 1, hi);
+    __avl_set_balance_factor(n, __avl_build_height(mid - lo) - __avl_build_height(hi - mid - 1));
+    if (s->_count_off)
+    {
+        _AVL_COUNT(s, e) = (uint32_t)(hi - lo);
+    }
+    return e;
+}
+
+/*! @brief take the slots [0, n) of an empty set for a tree to be built by __avl_set_build() */
+static int __avl_set_take_prefix(struct avl_set *s, size_t n)
+{
+    assert(0 == s->_size);
+    if (n > s->_config._reserve && 0 != __avl_set_grow(s, n))
+    {
+        return -1;
+    }
+    /*! @note the remaining slots are still available */
+    __avl_set_reset_slots(s, n);
+    s->_size = n;
+    return 0;
+}
+
+int avl_set_build_sorted(struct avl_set *s, void **keys, size_t n)
+{
+    assert(s);
+    if (0 != s->_size || __avl_set_shared(s) || s->_map)
+    {
+        /*! @note the snapshots may still hold the slots to be taken */
+        return -1;
+    }
+#ifndef NDEBUG
+    size_t j;
+    for (j = 1; j < n; j++)
+    {
+        assert(0 > s->_compare(keys[j - 1], keys[j]));
+    }
+#endif
+    /*! @note the slots [0, n) must not be held by the readers anymore */
+    __avl_set_synchronize(s);
+    __avl_set_write_begin(s);
+    int _ret = __avl_set_take_prefix(s, n);
+    if (0 == _ret)
+    {
+        size_t i;
+        for (i = 0; i < n; i++)
+        {
+            __avl_store_key(s, (uint32_t)i, keys[i]);
+            __avl_store_value(s, (uint32_t)i, NULL);
+        }
+        uint32_t _root = __avl_set_build(s, NULL, 0, n);
+        __avl_set_publish(s);
+        _AVL_STORE(&s->_rindex, _root, __ATOMIC_RELAXED);
+    }
+    __avl_set_write_end(s);
+    return _ret;
+}
+
+size_t avl_set_search_batch(struct avl_set *s, void *const *keys, size_t n, void **out)
+{
+    assert(s);
+    size_t _found = 0;
+    size_t base;
+    if (s->_sync)
+    {
+        /*! @note a concurrent set validates each lookup on its own */
+        for (base = 0; base < n; base++)
+        {
+            out[base] = avl_set_search(s, keys[base]);
+            _found += out[base] ? 1 : 0;
+        }
+        return _found;
+    }
+    for (base = 0; base < n; base += _AVL_BATCH_WIDTH)
+    {
+        uint32_t _cur[_AVL_BATCH_WIDTH];
+        /*! @note pointer keys take two rounds per level: prefetch the key, then compare */
+        unsigned char _key_ready[_AVL_BATCH_WIDTH];
+        uint64_t _kp[_AVL_BATCH_WIDTH];
+        size_t _width = (n - base < _AVL_BATCH_WIDTH) ? (n - base) : _AVL_BATCH_WIDTH;
+        size_t _active = 0;
+        size_t i;
+        for (i = 0; i < _width; i++)
+        {
+            out[base + i] = NULL;
+            _cur[i] = s->_rindex;
+            _key_ready[i] = 0;
+            _kp[i] = __avl_set_prefix(s, keys[base + i]);
+            if (_AVL_NIL != _cur[i])
+            {
+                _AVL_PREFETCH(_AVL_ELEM(s, _cur[i]));
+                _active++;
+            }
+        }
+        while (_active)
+        {
+            for (i = 0; i < _width; i++)
+            {
+                uint32_t e = _cur[i];
+                if (_AVL_NIL == e)
+                {
+                    continue;
+                }
+                avl_node *self = _AVL_NODE(s, e);
+                int cmpret;
+                if (s->_prefix_off && _kp[i] != _AVL_PREFIX(s, e))
+                {
+                    /*! @note the prefixes decide without the key */
+                    cmpret = __avl_set_compare_at(s, keys[base + i], _kp[i], self);
+                }
+                else if (0 == s->_key_size && !_key_ready[i])
+                {
+                    _AVL_PREFETCH((const void *)_AVL_KEY(s, e));
+                    _key_ready[i] = 1;
+                    continue;
+                }
+                else
+                {
+                    _key_ready[i] = 0;
+                    cmpret = _AVL_COMPARE(s, keys[base + i], __avl_key(s, e));
+                }
+                if (0 == cmpret)
+                {
+                    /*! @brief found */
+                    out[base + i] = __avl_key(s, e);
+                    _found++;
+                    e = _AVL_NIL;
+                }
+                else
+                {
+                    e = (0 > cmpret) ? _avl_left(self) : _avl_right(self);
+                }
+                _cur[i] = e;
+                if (_AVL_NIL == e)
+                {
+                    _active--;
+                }
+                else
+                {
+                    /*! @note the miss overlaps with the other lookups of this round */
+                    _AVL_PREFETCH(_AVL_ELEM(s, e));
+                }
+            }
+        }
+    }
+    return _found;
+}
+
+/*! @brief record the slots of the subtree in order, return the number of slots */
+static size_t __avl_set_flatten(const struct avl_set *s, uint32_t e, uint32_t *out)
+{
+    uint32_t _pending[AVL_MAX_HEIGHT];
+    size_t _depth = 0;
+    size_t n = 0;
+    while (_AVL_NIL != e || _depth)
+    {
+        while (_AVL_NIL != e)
+        {
+            _pending[_depth++] = e;
+            e = _avl_left(_AVL_NODE(s, e));
+        }
+        e = _pending[--_depth];
+        out[n++] = e;
+        e = _avl_right(_AVL_NODE(s, e));
+    }
+    return n;
+}
+
+typedef void *(*avl_task)(void *);
+
+/*! @brief run fn on each of the count tasks, one thread per task */
+static void __avl_run_tasks(avl_task fn, void *tasks, size_t task_size, size_t count)
+{
+    uint8_t *_t = (uint8_t *)tasks;
+    size_t i;
+#if defined(_AVL_HAVE_PTHREAD)
+    pthread_t _threads[_AVL_MAX_THREADS];
+    int _spawned[_AVL_MAX_THREADS];
+    assert(count <= _AVL_MAX_THREADS);
+    for (i = 1; i < count; i++)
+    {
+        _spawned[i] = (0 == pthread_create(&_threads[i], NULL, fn, _t + i * task_size));
+        if (!_spawned[i])
+        {
+            /*! @note fall back to the calling thread */
+            fn(_t + i * task_size);
+        }
+    }
+    if (count)
+    {
+        fn(_t);
+    }
+    for (i = 1; i < count; i++)
+    {
+        if (_spawned[i])
+        {
+            pthread_join(_threads[i], NULL);
+        }
+    }
+#else
+    for (i = 0; i < count; i++)
+    {
+        fn(_t + i * task_size);
+    }
+#endif
+}
+
+/*! @struct avl_tree */
+typedef struct _avl_tree
+{
+    /*! root slot, NIL for an empty tree */
+    uint32_t root;
+    /*! number of levels */
+    int height;
+} avl_tree;
+
+static avl_tree __avl_tree_of(uint32_t root, int height)
+{
+    avl_tree t;
+    t.root = root;
+    t.height = height;
+    return t;
+}
+
+/**
+ * @brief join two detached trees of the arena with slot k in between
+ * @note every element of l is less than k, which is less than every element of r
+ */
+static avl_tree __avl_set_join3(struct avl_set *s, avl_tree l, uint32_t k, avl_tree r)
+{
+    avl_node *nk = _AVL_NODE(s, k);
+    if (l.height <= r.height + 1 && r.height <= l.height + 1)
+    {
+        nk->left = l.root;
+        nk->right = r.root;
+        __avl_set_balance_factor(nk, l.height - r.height);
+        _avl_update_count(s, k);
+        return __avl_tree_of(k, _AVL_MAX(l.height, r.height) + 1);
+    }
+    /*! @note walk down the inner spine of the higher tree to a subtree as high as the lower tree */
+    int dir = (l.height > r.height) ? 1 : -1;
+    avl_tree high = (0 < dir) ? l : r;
+    avl_tree low = (0 < dir) ? r : l;
+    uint32_t _root = high.root;
+    avl_path path;
+    path.root = &_root;
+    path.depth = 0;
+    uint32_t c = high.root;
+    int h = high.height;
+    while (h > low.height + 1)
+    {
+        avl_node *n = _AVL_NODE(s, c);
+        int bf = __avl_balance_factor(n);
+        __avl_path_push(&path, c, dir);
+        h -= (0 < dir) ? (1 + (0 < bf)) : (1 + (0 > bf));
+        c = (0 < dir) ? _avl_right(n) : _avl_left(n);
+    }
+    nk->left = (0 < dir) ? c : low.root;
+    nk->right = (0 < dir) ? low.root : c;
+    __avl_set_balance_factor(nk, (0 < dir) ? (h - low.height) : (low.height - h));
+    _avl_update_count(s, k);
+    __avl_set_relink(s, &path, path.depth, k);
+    if (s->_count_off)
+    {
+        size_t d = path.depth;
+        while (d--)
+        {
+            _avl_update_count(s, path.slot[d]);
+        }
+    }
+    /*! @note the subtree at c has grown by one level, as on insertion */
+    int grown = __avl_set_insert_retrace(s, &path, 0, path.depth, NULL);
+    return __avl_tree_of(_root, high.height + grown);
+}
+
+/*! @brief join two detached trees of the arena, every element of l is less than every element of r */
+static avl_tree __avl_set_join2(struct avl_set *s, avl_tree l, avl_tree r)
+{
+    if (_AVL_NIL == l.root)
+    {
+        return r;
+    }
+    if (_AVL_NIL == r.root)
+    {
+        return l;
+    }
+    /*! @note detach the smallest element of r, it becomes the middle slot */
+    uint32_t _root = r.root;
+    avl_path path;
+    path.root = &_root;
+    path.depth = 0;
+    uint32_t k = r.root;
+    while (_AVL_NIL != _avl_left(_AVL_NODE(s, k)))
+    {
+        __avl_path_push(&path, k, -1);
+        k = _avl_left(_AVL_NODE(s, k));
+    }
+    __avl_set_relink(s, &path, path.depth, _avl_right(_AVL_NODE(s, k)));
+    if (s->_count_off)
+    {
+        size_t d;
+        for (d = 0; d < path.depth; d++)
+        {
+            _AVL_COUNT(s, path.slot[d])--;
+        }
+    }
+    int shrunk = __avl_set_delete_retrace(s, &path);
+    r = __avl_tree_of(_root, r.height - shrunk);
+    return __avl_set_join3(s, l, k, r);
+}
+
+/*! @brief split a detached tree into the elements less than k and the others */
+static void __avl_set_split(struct avl_set *s, avl_tree t, const void *k, avl_tree *lo, avl_tree *hi)
+{
+    if (_AVL_NIL == t.root)
+    {
+        *lo = t;
+        *hi = t;
+        return;
+    }
+    avl_node *n = _AVL_NODE(s, t.root);
+    int bf = __avl_balance_factor(n);
+    avl_tree l = __avl_tree_of(_avl_left(n), t.height - 1 - (0 > bf));
+    avl_tree r = __avl_tree_of(_avl_right(n), t.height - 1 - (0 < bf));
+    avl_tree _lo;
+    avl_tree _hi;
+    int cmpret = _AVL_COMPARE(s, k, __avl_key(s, t.root));
+    if (0 < cmpret)
+    {
+        /*! @note the root and its left subtree are less than k */
+        __avl_set_split(s, r, k, &_lo, &_hi);
+        *lo = __avl_set_join3(s, l, t.root, _lo);
+        *hi = _hi;
+    }
+    else
+    {
+        __avl_set_split(s, l, k, &_lo, &_hi);
+        *lo = _lo;
+        *hi = __avl_set_join3(s, _hi, t.root, r);
+    }
+}
+
+/**
+ * @brief move k elements of another set, given in order, into new slots of s
+ * @param t [out] a balanced tree of the moved elements, detached from s
+ * @return 0 on success, -1 on allocation failure
+ */
+static int __avl_set_adopt(struct avl_set *s, const struct avl_set *from, const uint32_t *order, size_t k, avl_tree *t)
+{
+    size_t _free = s->_config._reserve - s->_size;
+    if (k > _free && 0 != __avl_set_grow(s, s->_config._reserve + (k - _free)))
+    {
+        return -1;
+    }
+    uint32_t *slots = (uint32_t *)(s->_config._alloc(sizeof(uint32_t) * (k + 1)));
+    if (NULL == slots)
+    {
+        return -1;
+    }
+    size_t i;
+    for (i = 0; i < k; i++)
+    {
+        uint32_t e = __avl_set_take_slot(s);
+        slots[i] = e;
+        /*! @note same layout, the key and the value are copied as they are */
+        memcpy(_AVL_ELEM(s, e) + s->_key_off, _AVL_ELEM(from, order[i]) + s->_key_off, s->_stride - s->_key_off);
+        if (s->_prefix_off)
+        {
+            _AVL_PREFIX(s, e) = _AVL_PREFIX(from, order[i]);
+        }
+    }
+    *t = __avl_tree_of(__avl_set_build(s, slots, 0, k), __avl_build_height(k));
+    s->_config._dealloc(slots);
+    return 0;
+}
+
+/*! @brief whether the elements of a and b have the same layout and order */
+static int __avl_set_alike(const struct avl_set *a, const struct avl_set *b)
+{
+    return a->_compare == b->_compare && a->_stride == b->_stride && a->_key_size == b->_key_size &&
+           a->_count_off == b->_count_off && a->_value_size == b->_value_size &&
+           a->_config._key_prefix == b->_config._key_prefix;
+}
+
+/*! @brief whether the elements of a and b can be moved between their arenas */
+static int __avl_set_compatible(const struct avl_set *a, const struct avl_set *b)
+{
+    return a != b && __avl_set_alike(a, b) && !a->_sync && !b->_sync && !__avl_set_shared(a) &&
+           !__avl_set_shared(b) && !a->_map && !b->_map;
+}
+
+/*! @brief count the smaller of two subtrees in O(min), return 0 if a is smaller, 1 otherwise */
+static int __avl_set_smaller(const struct avl_set *s, uint32_t a, uint32_t b, size_t *count)
+{
+    uint32_t _pending[2][AVL_MAX_HEIGHT + 1];
+    size_t _depth[2] = {0, 0};
+    size_t _count = 0;
+    if (_AVL_NIL != a)
+        _pending[0][_depth[0]++] = a;
+    if (_AVL_NIL != b)
+        _pending[1][_depth[1]++] = b;
+    /*! @note walk both trees in lockstep until one of them is exhausted */
+    while (_depth[0] && _depth[1])
+    {
+        int i;
+        for (i = 0; i < 2; i++)
+        {
+            _depth[i]--;
+            avl_node *n = _AVL_NODE(s, _pending[i][_depth[i]]);
+            if (_AVL_NIL != _avl_right(n))
+                _pending[i][_depth[i]++] = _avl_right(n);
+            if (_AVL_NIL != _avl_left(n))
+                _pending[i][_depth[i]++] = _avl_left(n);
+        }
+        _count++;
+    }
+    *count = _count;
+    return _depth[0] ? 1 : 0;
+}
+
+int avl_set_split(struct avl_set *s, const void *pivot, struct avl_set **lo, struct avl_set **hi)
+{
+    assert(s && lo && hi);
+    if (s->_sync || __avl_set_shared(s) || s->_map)
+    {
+        /*! @note the readers or the snapshots cannot follow elements into another set */
+        return -1;
+    }
+    avl_tree _lo;
+    avl_tree _hi;
+    __avl_set_split(s, __avl_tree_of(s->_rindex, __avl_set_height(s, s->_rindex)), pivot, &_lo, &_hi);
+    size_t _count = 0;
+    int _larger_lo = __avl_set_smaller(s, _lo.root, _hi.root, &_count);
+    avl_tree _small = _larger_lo ? _hi : _lo;
+
+    /*! @note the smaller half moves into a new set, s keeps the larger one */
+    struct avl_config _config = s->_config;
+    _config._reserve = _count ? _count : _AVL_DEFAULT_RESERVE;
+    struct avl_set *n = __avl_set_create(s->_compare, s->_key_destruct, s->_value_destruct, s->_value_size, &_config);
+    uint32_t *order = (uint32_t *)(s->_config._alloc(sizeof(uint32_t) * (_count + 1)));
+    avl_tree _moved;
+    if (NULL == n || NULL == order || 0 != __avl_set_adopt(n, s, order, __avl_set_flatten(s, _small.root, order), &_moved))
+    {
+        if (n)
+            avl_set_destroy(n);
+        if (order)
+            s->_config._dealloc(order);
+        /*! @note put the halves back together */
+        s->_rindex = __avl_set_join2(s, _lo, _hi).root;
+        s->_version++;
+        return -1;
+    }
+    n->_rindex = _moved.root;
+    n->_size = _count;
+    size_t i;
+    for (i = 0; i < _count; i++)
+    {
+        __avl_set_release(s, order[i]);
+    }
+    s->_config._dealloc(order);
+    s->_rindex = _larger_lo ? _lo.root : _hi.root;
+    s->_version++;
+    s->_size -= _count;
+    *lo = _larger_lo ? s : n;
+    *hi = _larger_lo ? n : s;
+    return 0;
+}
+
+/*! @brief exchange the elements of a and b along with their arenas */
+static void __avl_set_swap_arenas(struct avl_set *a, struct avl_set *b)
+{
+    struct avl_set _t = *a;
+    a->_segs = b->_segs;
+    a->_segs_cap = b->_segs_cap;
+    a->_slots = b->_slots;
+    a->_size = b->_size;
+    a->_rindex = b->_rindex;
+    a->_version++;
+    a->_config._reserve = b->_config._reserve;
+    b->_segs = _t._segs;
+    b->_segs_cap = _t._segs_cap;
+    b->_slots = _t._slots;
+    b->_size = _t._size;
+    b->_rindex = _t._rindex;
+    b->_version++;
+    b->_config._reserve = _t._config._reserve;
+    if (a->_snap && b->_snap)
+    {
+        /*! @note the slots of either arena were written up to its own version */
+        a->_snap->version = b->_snap->version = _AVL_MAX(a->_snap->version, b->_snap->version);
+    }
+}
+
+/*! @brief let a take the arena of b if b is larger, the fewer elements are moved, return 1 if swapped */
+static int __avl_set_take_larger(struct avl_set *a, struct avl_set *b)
+{
+    if (b->_size > a->_size && __avl_arena_same(&a->_config, &b->_config))
+    {
+        __avl_set_swap_arenas(a, b);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief move all the elements of b into new slots of a, b keeps them until it is reset
+ * @param t [out] a balanced tree of the moved elements, detached from a
+ * @return 0 on success, -1 on allocation failure
+ */
+static int __avl_set_move_all(struct avl_set *a, const struct avl_set *b, avl_tree *t)
+{
+    uint32_t *order = (uint32_t *)(b->_config._alloc(sizeof(uint32_t) * (b->_size + 1)));
+    if (NULL == order)
+    {
+        return -1;
+    }
+    int ret = __avl_set_adopt(a, b, order, __avl_set_flatten(b, b->_rindex, order), t);
+    b->_config._dealloc(order);
+    return ret;
+}
+
+int avl_set_join(struct avl_set *a, struct avl_set *b)
+{
+    assert(a && b);
+    if (!__avl_set_compatible(a, b))
+    {
+        return -1;
+    }
+    if (0 == b->_size)
+    {
+        return 0;
+    }
+    if (a->_size)
+    {
+        struct avl_set_cursor c;
+        if (0 <= _AVL_COMPARE(a, avl_set_last(a, &c), avl_set_first(b, &c)))
+        {
+            /*! @note the elements of a must all be less than those of b */
+            return -1;
+        }
+    }
+    int _swapped = __avl_set_take_larger(a, b);
+    avl_tree _moved;
+    if (0 != __avl_set_move_all(a, b, &_moved))
+    {
+        if (_swapped)
+            __avl_set_swap_arenas(a, b);
+        return -1;
+    }
+    avl_tree _kept = __avl_tree_of(a->_rindex, __avl_set_height(a, a->_rindex));
+    a->_rindex = (_swapped ? __avl_set_join2(a, _moved, _kept) : __avl_set_join2(a, _kept, _moved)).root;
+    a->_version++;
+    a->_size += b->_size;
+    __avl_set_reset(b);
+    return 0;
+}
+
+enum avl_set_op
+{
+    _AVL_UNION,
+    _AVL_INTERSECTION,
+    _AVL_DIFFERENCE
+};
+
+/*! @struct avl_merge_task */
+typedef struct _avl_merge_task
+{
+    enum avl_set_op op;
+    struct avl_set *a;
+    struct avl_set *b;
+    /*! the range of this task, [lo, hi), NULL for no bound */
+    const void *lo;
+    const void *hi;
+    /*! picked elements in order, slots of b are tagged with _AVL_HEAVY_BIT */
+    uint32_t *picked;
+    size_t npicked;
+    size_t cap;
+    int failed;
+    /*! the result, and the position of the first picked element in it */
+    struct avl_set *r;
+    size_t offset;
+} avl_merge_task;
+
+static int __avl_merge_pick(avl_merge_task *t, const struct avl_set_cursor *c, int from_b)
+{
+    if (t->npicked == t->cap)
+    {
+        size_t _cap = t->cap ? t->cap * 2 : _AVL_MIN_TASK_SIZE;
+        uint32_t *_picked = (uint32_t *)(t->a->_config._alloc(sizeof(uint32_t) * _cap));
+        if (NULL == _picked)
+        {
+            t->failed = 1;
+            return -1;
+        }
+        if (t->picked)
+        {
+            memcpy(_picked, t->picked, sizeof(uint32_t) * t->npicked);
+            t->a->_config._dealloc(t->picked);
+        }
+        t->picked = _picked;
+        t->cap = _cap;
+    }
+    uint32_t e = c->_path[c->_depth - 1];
+    t->picked[t->npicked++] = from_b ? (e | _AVL_HEAVY_BIT) : e;
+    return 0;
+}
+
+/*! @brief position a cursor to the first element not less than k, or to the first element without k */
+static void *__avl_merge_seek(struct avl_set *s, const void *k, struct avl_set_cursor *c)
+{
+    if (NULL == k)
+    {
+        c->_set = s;
+        c->_depth = 0;
+        c->_version = 0;
+        return __avl_cursor_descend(c, s->_rindex, -1);
+    }
+    return __avl_cursor_seek(s, s->_rindex, k, c, 0);
+}
+
+/*! @brief whether the cursor is at an element and short of the slot end */
+static int __avl_merge_before(const struct avl_set_cursor *c, uint32_t end)
+{
+    return c->_depth && end != c->_path[c->_depth - 1];
+}
+
+/*! @brief slot of the first element not less than k, NIL if none or without k */
+static uint32_t __avl_merge_end(struct avl_set *s, const void *k)
+{
+    struct avl_set_cursor c;
+    if (NULL == k || NULL == __avl_merge_seek(s, k, &c))
+    {
+        return _AVL_NIL;
+    }
+    return c._path[c._depth - 1];
+}
+
+/**
+ * @brief move the cursor to the first element not less than k
+ * @note one step first and a seek from the root only if k is further, a skip costs O(1) among dense elements and
+ * O(log n) among sparse ones
+ * @note k is an element of the other set short of its slot end, the skip cannot pass the slot end of this one
+ */
+static void __avl_merge_skip(struct avl_set_cursor *c, const void *k)
+{
+    void *e = __avl_cursor_step(c, 1);
+    if (e && 0 > _AVL_COMPARE(c->_set, e, k))
+    {
+        __avl_cursor_seek(c->_set, c->_set->_rindex, k, c, 0);
+    }
+}
+
+/*! @brief compare the elements at the cursors of a and b, on their cached prefixes first */
+static int __avl_merge_compare(const avl_merge_task *t, const struct avl_set_cursor *ca,
+                               const struct avl_set_cursor *cb)
+{
+    uint32_t y = cb->_path[cb->_depth - 1];
+    uint64_t yp = t->b->_prefix_off ? _AVL_PREFIX(t->b, y) : 0;
+    return -__avl_set_compare_at(t->a, __avl_key(t->b, y), yp, _AVL_NODE(t->a, ca->_path[ca->_depth - 1]));
+}
+
+/*! @brief pass 1: merge the range of the task and pick the elements of the result */
+static void *__avl_merge_range(void *arg)
+{
+    avl_merge_task *t = (avl_merge_task *)arg;
+    int keep_only_a = (_AVL_INTERSECTION != t->op);
+    int keep_only_b = (_AVL_UNION == t->op);
+    int keep_both = (_AVL_DIFFERENCE != t->op);
+    struct avl_set_cursor ca;
+    struct avl_set_cursor cb;
+    uint32_t ea = __avl_merge_end(t->a, t->hi);
+    uint32_t eb = __avl_merge_end(t->b, t->hi);
+    __avl_merge_seek(t->a, t->lo, &ca);
+    __avl_merge_seek(t->b, t->lo, &cb);
+    while (1)
+    {
+        int x = __avl_merge_before(&ca, ea);
+        int y = __avl_merge_before(&cb, eb);
+        if (!x && !y)
+        {
+            break;
+        }
+        int cmpret = !x ? 1 : (!y ? -1 : __avl_merge_compare(t, &ca, &cb));
+        if (0 > cmpret)
+        {
+            if (keep_only_a)
+            {
+                if (0 != __avl_merge_pick(t, &ca, 0))
+                    break;
+                __avl_cursor_step(&ca, 1);
+            }
+            else if (y)
+            {
+                /*! @note the elements of a before the one of b are left out */
+                __avl_merge_skip(&ca, avl_set_cursor_get(&cb));
+            }
+            else
+            {
+                break;
+            }
+        }
+        else if (0 < cmpret)
+        {
+            if (keep_only_b)
+            {
+                if (0 != __avl_merge_pick(t, &cb, 1))
+                    break;
+                __avl_cursor_step(&cb, 1);
+            }
+            else if (x)
+            {
+                __avl_merge_skip(&cb, avl_set_cursor_get(&ca));
+            }
+            else
+            {
+                break;
+            }
+        }
+        else
+        {
+            /*! @note duplicated, the element of b is taken as avl_set_insert() would replace the one of a */
+            if (keep_both && 0 != __avl_merge_pick(t, &cb, 1))
+                break;
+            __avl_cursor_step(&ca, 1);
+            __avl_cursor_step(&cb, 1);
+        }
+    }
+    return NULL;
+}
+
+/*! @brief pass 2: copy the picked elements into their slots of r */
+static void *__avl_merge_copy(void *arg)
+{
+    avl_merge_task *t = (avl_merge_task *)arg;
+    struct avl_set *r = t->r;
+    size_t k;
+    for (k = 0; k < t->npicked; k++)
+    {
+        uint32_t e = t->picked[k] & _AVL_LINK_MASK;
+        const struct avl_set *from = (t->picked[k] & _AVL_HEAVY_BIT) ? t->b : t->a;
+        uint32_t i = (uint32_t)(t->offset + k);
+        /*! @note same layout, the key and the value are copied as they are */
+        memcpy(_AVL_ELEM(r, i) + r->_key_off, _AVL_ELEM(from, e) + r->_key_off, r->_stride - r->_key_off);
+        if (r->_prefix_off)
+        {
+            _AVL_PREFIX(r, i) = _AVL_PREFIX(from, e);
+        }
+        if (r->_birth_off)
+        {
+            _AVL_BIRTH(r, i) = r->_snap->version;
+        }
+    }
+    return NULL;
+}
+
+/*! @brief record in order the keys of the subtree down to the given depth, return their count */
+static size_t __avl_set_top_keys(const struct avl_set *s, uint32_t e, int depth, const void **out)
+{
+    if (_AVL_NIL == e || 0 == depth)
+    {
+        return 0;
+    }
+    avl_node *n = _AVL_NODE(s, e);
+    size_t k = __avl_set_top_keys(s, _avl_left(n), depth - 1, out);
+    out[k++] = __avl_key(s, e);
+    return k + __avl_set_top_keys(s, _avl_right(n), depth - 1, out + k);
+}
+
+/**
+ * @brief merge a and b into a new avl_set, leaving them untouched
+ * @note the order is cut into one range per thread at the upper nodes of the larger set, the top levels of an AVL
+ * tree being complete. Each thread merges its range with two cursors, then copies the elements it picked into its
+ * part of a prefix of the new arena; the prefix is linked into a balanced tree on the calling thread at last.
+ */
+static struct avl_set *__avl_set_merge(struct avl_set *a, struct avl_set *b, unsigned int nthreads,
+                                       enum avl_set_op op)
+{
+    assert(a && b);
+    if (!__avl_set_alike(a, b) || a->_sync || b->_sync || a->_map || b->_map)
+    {
+        return NULL;
+    }
+    nthreads = (nthreads > _AVL_MAX_THREADS) ? _AVL_MAX_THREADS : (nthreads ? nthreads : 1);
+    size_t _tasks = (a->_size + b->_size) / _AVL_MIN_TASK_SIZE + 1;
+    if (_tasks > nthreads)
+        _tasks = nthreads;
+    struct avl_set *_larger = (a->_size >= b->_size) ? a : b;
+    const void *_keys[2 * _AVL_MAX_THREADS];
+    size_t _nkeys = __avl_set_top_keys(_larger, _larger->_rindex, __avl_build_height(_tasks), _keys);
+    if (_tasks > _nkeys)
+        _tasks = _nkeys ? _nkeys : 1;
+
+    avl_merge_task _t[_AVL_MAX_THREADS];
+    size_t c;
+    for (c = 0; c < _tasks; c++)
+    {
+        memset(&_t[c], 0, sizeof(avl_merge_task));
+        _t[c].op = op;
+        _t[c].a = a;
+        _t[c].b = b;
+        _t[c].lo = c ? _keys[c * _nkeys / _tasks] : NULL;
+        _t[c].hi = (c + 1 < _tasks) ? _keys[(c + 1) * _nkeys / _tasks] : NULL;
+    }
+    __avl_run_tasks(__avl_merge_range, _t, sizeof(avl_merge_task), _tasks);
+
+    size_t _total = 0;
+    int _failed = 0;
+    for (c = 0; c < _tasks; c++)
+    {
+        _failed |= _t[c].failed;
+        _t[c].offset = _total;
+        _total += _t[c].npicked;
+    }
+    struct avl_set *r = NULL;
+    if (!_failed)
+    {
+        struct avl_config _config = a->_config;
+        _config._reserve = _total ? _total : _AVL_DEFAULT_RESERVE;
+        /*! @note the elements are still owned by a and b */
+        r = __avl_set_create(a->_compare, NULL, NULL, a->_value_size, &_config);
+    }
+    if (r && 0 != __avl_set_take_prefix(r, _total))
+    {
+        avl_set_destroy(r);
+        r = NULL;
+    }
+    if (r)
+    {
+        for (c = 0; c < _tasks; c++)
+        {
+            _t[c].r = r;
+        }
+        __avl_run_tasks(__avl_merge_copy, _t, sizeof(avl_merge_task), _tasks);
+        r->_rindex = __avl_set_build(r, NULL, 0, _total);
+    }
+    for (c = 0; c < _tasks; c++)
+    {
+        if (_t[c].picked)
+            a->_config._dealloc(_t[c].picked);
+    }
+    return r;
+}
+
+struct avl_set *avl_set_union(struct avl_set *a, struct avl_set *b, unsigned int nthreads)
+{
+    return __avl_set_merge(a, b, nthreads, _AVL_UNION);
+}
+
+struct avl_set *avl_set_intersection(struct avl_set *a, struct avl_set *b, unsigned int nthreads)
+{
+    return __avl_set_merge(a, b, nthreads, _AVL_INTERSECTION);
+}
+
+struct avl_set *avl_set_difference(struct avl_set *a, struct avl_set *b, unsigned int nthreads)
+{
+    return __avl_set_merge(a, b, nthreads, _AVL_DIFFERENCE);
+}
+
+size_t avl_set_erase_range(struct avl_set *s, const void *from, const void *to)
+{
+    assert(s);
+    if (0 == s->_size || 0 <= _AVL_COMPARE(s, from, to) || s->_map)
+    {
+        return 0;
+    }
+    if (s->_sync || __avl_set_shared(s))
+    {
+        /*! @note one element at a time, each change opened after its descent and closed after its deletion */
+        /*! @note the readers never see a detached subtree, the snapshots keep sharing what is left untouched */
+        size_t _count = 0;
+        struct avl_set_cursor c;
+        void *e;
+        while ((e = avl_set_lower_bound(s, from, &c)) && 0 > _AVL_COMPARE(s, e, to) && __avl_set_erase(s, e, NULL))
+        {
+            __avl_set_write_end(s);
+            _count++;
+        }
+        __avl_set_write_end(s);
+        return _count;
+    }
+    avl_tree _lo;
+    avl_tree _mid;
+    avl_tree _hi;
+    __avl_set_split(s, __avl_tree_of(s->_rindex, __avl_set_height(s, s->_rindex)), from, &_lo, &_hi);
+    __avl_set_split(s, _hi, to, &_mid, &_hi);
+
+    /*! @note destroy the detached range */
+    size_t _erased = 0;
+    if (_AVL_NIL != _mid.root)
+    {
+        uint32_t _pending[AVL_MAX_HEIGHT + 1];
+        size_t _depth = 0;
+        _pending[_depth++] = _mid.root;
+        while (_depth)
+        {
+            uint32_t e = _pending[--_depth];
+            uint32_t left = _avl_left(_AVL_NODE(s, e));
+            uint32_t right = _avl_right(_AVL_NODE(s, e));
+            if (_AVL_NIL != right)
+                _pending[_depth++] = right;
+            if (_AVL_NIL != left)
+                _pending[_depth++] = left;
+            __avl_set_retire(s, e, 1);
+            _erased++;
+        }
+    }
+    s->_rindex = __avl_set_join2(s, _lo, _hi).root;
+    s->_version++;
+    s->_size -= _erased;
+    __avl_set_auto_shrink(s, _erased);
+    return _erased;
+}
+
+/*! @brief append the nodes of the subtree e in breadth-first order to out, return the count */
+static size_t __avl_set_order_bfs(const struct avl_set *s, uint32_t e, uint32_t *out)
+{
+    size_t n = 0;
+    size_t i;
+    if (_AVL_NIL != e)
+    {
+        out[n++] = e;
+    }
+    /*! @note out is the queue itself */
+    for (i = 0; i < n; i++)
+    {
+        avl_node *self = _AVL_NODE(s, out[i]);
+        if (_AVL_NIL != _avl_left(self))
+            out[n++] = _avl_left(self);
+        if (_AVL_NIL != _avl_right(self))
+            out[n++] = _avl_right(self);
+    }
+    return n;
+}
+
+static void __avl_set_order_veb(const struct avl_set *s, uint32_t e, int h, uint32_t *out, size_t *n);
+
+/*! @brief lay out the subtrees hanging depth levels below e, from the left to the right, each h levels deep */
+static void __avl_set_order_veb_bottoms(const struct avl_set *s, uint32_t e, int depth, int h, uint32_t *out,
+                                        size_t *n)
+{
+    if (_AVL_NIL == e)
+    {
+        return;
+    }
+    if (0 == depth)
+    {
+        __avl_set_order_veb(s, e, h, out, n);
+        return;
+    }
+    avl_node *self = _AVL_NODE(s, e);
+    __avl_set_order_veb_bottoms(s, _avl_left(self), depth - 1, h, out, n);
+    __avl_set_order_veb_bottoms(s, _avl_right(self), depth - 1, h, out, n);
+}
+
+/**
+ * @brief append the nodes of the top h levels of the subtree e in van Emde Boas order to out
+ * @note the top half of the levels is laid out first, then each subtree below it, all recursively
+ */
+static void __avl_set_order_veb(const struct avl_set *s, uint32_t e, int h, uint32_t *out, size_t *n)
+{
+    if (_AVL_NIL == e || 0 >= h)
+    {
+        return;
+    }
+    if (1 == h)
+    {
+        out[(*n)++] = e;
+        return;
+    }
+    int _top = h / 2;
+    __avl_set_order_veb(s, e, _top, out, n);
+    __avl_set_order_veb_bottoms(s, e, _top, h - _top, out, n);
+}
+
+/*! @brief move the elements to the first slots of a new arena of _reserve slots, in the given layout */
+static int __avl_set_relayout(struct avl_set *s, enum avl_layout layout, size_t _reserve)
+{
+    if (s->_sync || __avl_set_shared(s) || s->_map)
+    {
+        /*! @note the readers and the snapshots hold slot indices, a mapped set is read-only */
+        return -1;
+    }
+    assert(_reserve >= s->_size && _reserve > 0);
+    /*! @note the new arena, seen through a copy of the set */
+    struct avl_set _n = *s;
+    _n._config._reserve = __avl_set_round_reserve(s, _reserve);
+    _n._segs_cap = __avl_set_nsegs(s, _n._config._reserve);
+    _n._segs = __avl_set_arena_create(s, _n._config._reserve, _n._segs_cap);
+    /*! @note the new order of the old slots, then the new index of each old slot */
+    uint32_t *order = (uint32_t *)(s->_config._alloc(sizeof(uint32_t) * (s->_size + 1)));
+    uint32_t *renum = (uint32_t *)(s->_config._alloc(sizeof(uint32_t) * s->_config._reserve));
+    if (NULL == _n._segs || NULL == order || NULL == renum)
+    {
+        if (_n._segs)
+            __avl_set_arena_destroy(s, _n._segs, _n._config._reserve);
+        if (order)
+            s->_config._dealloc(order);
+        if (renum)
+            s->_config._dealloc(renum);
+        return -1;
+    }
+    size_t n = 0;
+    if (AVL_LAYOUT_VAN_EMDE_BOAS == layout)
+    {
+        __avl_set_order_veb(s, s->_rindex, __avl_set_height(s, s->_rindex), order, &n);
+    }
+    else
+    {
+        n = __avl_set_order_bfs(s, s->_rindex, order);
+    }
+    assert(n == s->_size);
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        renum[order[i]] = (uint32_t)i;
+    }
+    for (i = 0; i < n; i++)
+    {
+        memcpy(_AVL_ELEM(&_n, i), _AVL_ELEM(s, order[i]), s->_stride);
+        avl_node *self = _AVL_NODE(&_n, i);
+        uint32_t left = _avl_left(self);
+        uint32_t right = _avl_right(self);
+        /*! @note the heavy bits stay, only the indices change */
+        _avl_set_left(self, (_AVL_NIL == left) ? _AVL_NIL : renum[left]);
+        _avl_set_right(self, (_AVL_NIL == right) ? _AVL_NIL : renum[right]);
+    }
+    s->_rindex = n ? renum[s->_rindex] : _AVL_NIL;
+    s->_version++;
+    __avl_set_arena_destroy(s, s->_segs, s->_config._reserve);
+    s->_segs = _n._segs;
+    s->_segs_cap = _n._segs_cap;
+    s->_config._reserve = _n._config._reserve;
+    /*! @note the free slots follow the tree */
+    __avl_set_reset_slots(s, n);
+    s->_config._dealloc(order);
+    s->_config._dealloc(renum);
+    return 0;
+}
+
+int avl_set_compact(struct avl_set *s, enum avl_layout layout)
+{
+    assert(s);
+    return __avl_set_relayout(s, layout, s->_config._reserve);
+}
+
+int avl_set_shrink_to_fit(struct avl_set *s)
+{
+    assert(s);
+    size_t _reserve = __avl_set_round_reserve(s, _AVL_MAX(s->_size, (size_t)1));
+    if (_reserve >= s->_config._reserve)
+    {
+        return (s->_sync || __avl_set_shared(s) || s->_map) ? -1 : 0;
+    }
+    return __avl_set_relayout(s, AVL_LAYOUT_BREADTH_FIRST, _reserve);
+}
+
+/*! @brief cut a drained arena at its limit, a smaller first segment is the only one copied */
+static void __avl_set_cut(struct avl_set *s)
+{
+    avl_slots *f = &s->_slots;
+    size_t _old = s->_config._reserve;
+    size_t _reserve = f->limit;
+    size_t _old_bytes = __avl_set_seg_bytes(s, _old, 0);
+    size_t _bytes = __avl_set_seg_bytes(s, _reserve, 0);
+    if (_bytes < _old_bytes)
+    {
+        uint8_t *nseg0 = (uint8_t *)__avl_arena_alloc(&s->_config, _bytes);
+        if (NULL == nseg0)
+        {
+            /*! @note the cut is retried on the next deletion */
+            return;
+        }
+        memcpy(nseg0, s->_segs[0], _bytes);
+        __avl_arena_free(&s->_config, s->_segs[0], _old_bytes);
+        s->_segs[0] = nseg0;
+    }
+    __avl_set_segs_free(s, s->_segs, _old, __avl_set_nsegs(s, _reserve), __avl_set_nsegs(s, _old));
+    s->_config._reserve = _reserve;
+    /*! @note the spilled slots and the ones never used are gone with the segments */
+    f->avail -= _old - _reserve;
+    if (f->mark > _reserve)
+    {
+        f->mark = _reserve;
+    }
+    f->spill = _AVL_NIL;
+    __avl_set_undrain(s);
+}
+
+/**
+ * @brief take up to steps steps of the drain of the arena, cut it once every slot from the limit up is free
+ * @note a step sorts one released slot, or looks at one slot from the limit up and moves its element below the
+ * limit, which costs a descent from the root to the element
+ */
+static void __avl_set_drain(struct avl_set *s, size_t steps)
+{
+    avl_slots *f = &s->_slots;
+    for (; f->limit && steps; steps--)
+    {
+        uint32_t e = (_AVL_NIL == f->sorted) ? f->head : _AVL_NODE(s, f->sorted)->left;
+        if (_AVL_NIL != e)
+        {
+            /*! @note the released slots are sorted first, the ones from the limit up are spilled */
+            if (e < f->limit)
+            {
+                f->sorted = e;
+                continue;
+            }
+            uint32_t _next = _AVL_NODE(s, e)->left;
+            if (_AVL_NIL == f->sorted)
+                f->head = _next;
+            else
+                _AVL_NODE(s, f->sorted)->left = _next;
+            __avl_set_spill_slot(s, e);
+        }
+        else if (f->scan > f->limit)
+        {
+            e = (uint32_t)--f->scan;
+            if ((_AVL_NIL | _AVL_HEAVY_BIT) == _AVL_NODE(s, e)->right)
+            {
+                /*! @note a spilled slot */
+                continue;
+            }
+            if (_AVL_NIL == f->head && f->mark >= f->limit)
+            {
+                /*! @note the set grew back, no room is left below the limit */
+                __avl_set_undrain(s);
+                return;
+            }
+            avl_path p;
+            uint32_t _found = __avl_set_descend(s, __avl_key(s, e), &p);
+            assert(_found == e);
+            (void)_found;
+            uint32_t _to = __avl_set_take_slot(s);
+            memcpy(_AVL_ELEM(s, _to), _AVL_ELEM(s, e), s->_stride);
+            __avl_set_relink(s, &p, p.depth, _to);
+            __avl_set_release(s, e);
+        }
+        else
+        {
+            __avl_set_cut(s);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief shrink the arena once the elements fill less than _shrink_percent of it, leaving room to grow
+ * @param deleted elements just deleted, each one pays for _AVL_DRAIN_STEPS steps of the drain
+ */
+static void __avl_set_auto_shrink(struct avl_set *s, size_t deleted)
+{
+    if (s->_sync || __avl_set_shared(s) || s->_map)
+    {
+        /*! @note the readers and the snapshots hold slot indices, a mapped set is read-only */
+        return;
+    }
+    avl_slots *f = &s->_slots;
+    /*! @note an arena of less than 100 slots is left as it is */
+    if (0 == f->limit && s->_size < s->_config._reserve / 100 * s->_config._shrink_percent)
+    {
+        /*! @note room for half as many more elements, the arena grows again only after the set grows by half */
+        size_t _reserve = __avl_set_round_reserve(s, s->_size + (s->_size / 2) + _AVL_DEFAULT_RESERVE);
+        if (_reserve < s->_config._reserve)
+        {
+            /*! @note the elements from the limit up move down a few at a time, no deletion moves them all */
+            f->limit = _reserve;
+            f->sorted = _AVL_NIL;
+            f->scan = _AVL_MAX(f->mark, _reserve);
+        }
+    }
+    __avl_set_drain(s, deleted * _AVL_DRAIN_STEPS);
+}
+
+void avl_set_get_stats(struct avl_set *s, struct avl_set_stats *stats)
+{
+    assert(s && stats);
+    memset(stats, 0, sizeof(struct avl_set_stats));
+#if defined(AVL_STATS)
+    stats->counting = 1;
+#ifdef _AVL_HAVE_ATOMIC
+    /*! @note readers of a concurrent set may be counting their comparisons meanwhile */
+    stats->compares = __atomic_load_n(&s->_stats.compares, __ATOMIC_RELAXED);
+#else
+    stats->compares = s->_stats.compares;
+#endif
+    stats->prefix_decisions = s->_stats.prefix_decisions;
+    stats->rotate_right = s->_stats.rotations[0];
+    stats->rotate_left = s->_stats.rotations[1];
+    stats->rotate_left_right = s->_stats.rotations[2];
+    stats->rotate_right_left = s->_stats.rotations[3];
+    stats->grows = s->_stats.grows;
+    stats->grow_bytes = s->_stats.grow_bytes;
+    stats->max_height = s->_stats.max_height;
+#endif
+    stats->size = s->_size;
+    stats->height = (size_t)__avl_set_height(s, s->_rindex);
+    stats->max_height = _AVL_MAX(stats->max_height, stats->height);
+    stats->reserve = s->_config._reserve;
+    stats->free_slots = s->_slots.avail;
+    stats->live_bytes = s->_size * s->_stride;
+    if (s->_map)
+    {
+        stats->arena_bytes = s->_map_bytes;
+    }
+    else
+    {
+        size_t k;
+        for (k = 0; k < __avl_set_nsegs(s, s->_config._reserve); k++)
+        {
+            stats->arena_bytes += __avl_set_seg_bytes(s, s->_config._reserve, k);
+        }
+    }
+}
+
+/**
+ * @brief check the subtree under e, at depth d
+ * @param prev the last slot met in order, NIL before the first one
+ * @param n number of the slots met so far
+ * @return height of the subtree, -1 if it breaks an invariant
+ */
+static int __avl_set_check(struct avl_set *s, uint32_t e, size_t d, uint32_t *prev, size_t *n, size_t *depths,
+                           size_t ndepths)
+{
+    if (_AVL_NIL == e)
+    {
+        return 0;
+    }
+    /*! @note a cycle goes deeper than any AVL tree */
+    if (e >= s->_config._reserve || AVL_MAX_HEIGHT <= d)
+    {
+        return -1;
+    }
+    avl_node *self = _AVL_NODE(s, e);
+    if ((self->left & _AVL_HEAVY_BIT) && (self->right & _AVL_HEAVY_BIT))
+    {
+        return -1;
+    }
+    size_t _before = *n;
+    int hl = __avl_set_check(s, _avl_left(self), d + 1, prev, n, depths, ndepths);
+    /*! @note the comparisons of the check are not counted */
+    if (0 > hl || (_AVL_NIL != *prev && 0 <= s->_compare(__avl_key(s, *prev), __avl_key(s, e))))
+    {
+        return -1;
+    }
+    *prev = e;
+    (*n)++;
+    if (depths && d < ndepths)
+    {
+        depths[d]++;
+    }
+    int hr = __avl_set_check(s, _avl_right(self), d + 1, prev, n, depths, ndepths);
+    if (0 > hr || hl - hr != __avl_balance_factor(self))
+    {
+        return -1;
+    }
+    if (s->_count_off && _AVL_COUNT(s, e) != *n - _before)
+    {
+        return -1;
+    }
+    return _AVL_MAX(hl, hr) + 1;
+}
+
+int avl_set_validate(struct avl_set *s, size_t *depths, size_t ndepths)
+{
+    assert(s);
+    if (depths)
+    {
+        memset(depths, 0, sizeof(size_t) * ndepths);
+    }
+    uint32_t _prev = _AVL_NIL;
+    size_t _n = 0;
+    if (0 > __avl_set_check(s, s->_rindex, 0, &_prev, &_n, depths, ndepths) || _n != s->_size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*! @brief whether a live snapshot holds the dead slot d, or the key it shares with older copies */
+static int __avl_snap_holds(const avl_snap *z, const avl_dead *d)
+{
+    const struct avl_snapshot *t;
+    for (t = z->oldest; t && t->_version < d->death; t = t->_next)
+    {
+        if (d->destruct || t->_version >= d->birth)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+struct avl_snapshot *avl_set_snapshot(struct avl_set *s)
+{
+    assert(s);
+    avl_snap *z = s->_snap;
+    if (NULL == z)
+    {
+        return NULL;
+    }
+    struct avl_snapshot *t = (struct avl_snapshot *)(s->_config._alloc(sizeof(struct avl_snapshot)));
+    if (NULL == t)
+    {
+        return NULL;
+    }
+    t->_set = s;
+    t->_root = s->_rindex;
+    t->_version = z->version;
+    t->_size = s->_size;
+    t->_prev = z->newest;
+    t->_next = NULL;
+    if (z->newest)
+    {
+        z->newest->_next = t;
+    }
+    else
+    {
+        z->oldest = t;
+    }
+    z->newest = t;
+    /*! @note the slots written so far are shared now, the set copies them before any change */
+    z->frozen = z->version++;
+    return t;
+}
+
+void avl_set_snapshot_release(struct avl_snapshot *snap)
+{
+    if (NULL == snap)
+    {
+        return;
+    }
+    struct avl_set *s = snap->_set;
+    avl_snap *z = s->_snap;
+    if (snap->_prev)
+        snap->_prev->_next = snap->_next;
+    else
+        z->oldest = snap->_next;
+    if (snap->_next)
+        snap->_next->_prev = snap->_prev;
+    else
+        z->newest = snap->_prev;
+    z->frozen = z->newest ? z->newest->_version : 0;
+    s->_config._dealloc(snap);
+
+    /*! @note recycle what no snapshot holds anymore */
+    size_t i;
+    size_t _kept = 0;
+    for (i = 0; i < z->ndead; i++)
+    {
+        avl_dead *d = &z->dead[i];
+        if (__avl_snap_holds(z, d))
+        {
+            z->dead[_kept++] = *d;
+            continue;
+        }
+        if (d->destruct)
+        {
+            __avl_set_destruct(s, d->slot);
+        }
+        __avl_set_release(s, d->slot);
+    }
+    z->ndead = _kept;
+    if (NULL == z->newest)
+    {
+        /*! @note nothing is dead without snapshots */
+        assert(0 == z->ndead);
+        s->_config._dealloc(z->dead);
+        z->dead = NULL;
+        z->dcap = 0;
+    }
+}
+
+size_t avl_snapshot_size(const struct avl_snapshot *snap)
+{
+    assert(snap);
+    return snap->_size;
+}
+
+void *avl_snapshot_search(const struct avl_snapshot *snap, const void *k)
+{
+    assert(snap);
+    uint32_t e = __avl_set_search(snap->_set, snap->_root, k);
+    return (_AVL_NIL == e) ? NULL : __avl_key(snap->_set, e);
+}
+
+void *avl_snapshot_first(const struct avl_snapshot *snap, struct avl_set_cursor *c)
+{
+    assert(snap && c);
+    c->_set = snap->_set;
+    c->_depth = 0;
+    c->_version = 0;
+    return __avl_cursor_descend(c, snap->_root, -1);
+}
+
+void *avl_snapshot_last(const struct avl_snapshot *snap, struct avl_set_cursor *c)
+{
+    assert(snap && c);
+    c->_set = snap->_set;
+    c->_depth = 0;
+    c->_version = 0;
+    return __avl_cursor_descend(c, snap->_root, 1);
+}
+
+void *avl_snapshot_lower_bound(const struct avl_snapshot *snap, const void *k, struct avl_set_cursor *c)
+{
+    assert(snap && c);
+    return __avl_cursor_seek(snap->_set, snap->_root, k, c, 0);
+}
+
+void *avl_snapshot_upper_bound(const struct avl_snapshot *snap, const void *k, struct avl_set_cursor *c)
+{
+    assert(snap && c);
+    return __avl_cursor_seek(snap->_set, snap->_root, k, c, 1);
+}
+
+/*! @brief bytes of the file header, the arena follows it aligned */
+#define _AVL_FILE_HEADER (64)
+/*! @brief "CAVL", read back swapped on a host of the other byte order */
+#define _AVL_FILE_MAGIC (0x4C564143u)
+#define _AVL_FILE_VERSION (1u)
+
+/*! @struct avl_file_header */
+typedef struct _avl_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    /*! sizeof(uintptr_t) of the writer, the slot layout depends on it */
+    uint32_t word;
+    /*! slot layout, as in ::avl_set */
+    uint32_t stride;
+    uint32_t count_off;
+    uint32_t key_off;
+    uint32_t key_size;
+    uint32_t value_off;
+    uint32_t value_size;
+    /*! number of the slots, all of them in the tree */
+    uint32_t size;
+    uint32_t root;
+    uint8_t _pad[_AVL_FILE_HEADER - 11 * sizeof(uint32_t)];
+} avl_file_header;
+
+/*! @struct avl_save */
+typedef struct _avl_save
+{
+    FILE *f;
+    struct avl_set *s;
+    /*! the next element of s to be written */
+    struct avl_set_cursor c;
+    /*! one slot being written */
+    uint8_t *slot;
+    int failed;
+} avl_save;
+
+/*! @brief write the slots [lo, hi) in order, the i-th element in slot i, linked as by __avl_set_build() */
+static void __avl_set_save_range(avl_save *w, size_t lo, size_t hi)
+{
+    if (lo >= hi)
+    {
+        return;
+    }
+    struct avl_set *s = w->s;
+    size_t mid = lo + (hi - lo) / 2;
+    __avl_set_save_range(w, lo, mid);
+    memset(w->slot, 0, s->_stride);
+    avl_node *n = (avl_node *)w->slot;
+    n->left = (lo < mid) ? (uint32_t)(lo + (mid - lo) / 2) : _AVL_NIL;
+    n->right = (mid + 1 < hi) ? (uint32_t)(mid + 1 + (hi - mid - 1) / 2) : _AVL_NIL;
+    __avl_set_balance_factor(n, __avl_build_height(mid - lo) - __avl_build_height(hi - mid - 1));
+    if (s->_count_off)
+    {
+        *(uint32_t *)(w->slot + s->_count_off) = (uint32_t)(hi - lo);
+    }
+    memcpy(w->slot + s->_key_off, _AVL_ELEM(s, w->c._path[w->c._depth - 1]) + s->_key_off, s->_stride - s->_key_off);
+    if (1 != fwrite(w->slot, s->_stride, 1, w->f))
+    {
+        w->failed = 1;
+    }
+    __avl_cursor_step(&w->c, 1);
+    __avl_set_save_range(w, mid + 1, hi);
+}
+
+/**
+ * @brief create a new file next to path, to be renamed over it once it is whole
+ * @param tmp [out] its name, path followed by a unique suffix where mkstemp() is available
+ */
+static FILE *__avl_save_open(const struct avl_set *s, const char *path, char **tmp)
+{
+    size_t n = strlen(path);
+    *tmp = (char *)(s->_config._alloc(n + sizeof(".XXXXXX")));
+    if (NULL == *tmp)
+    {
+        return NULL;
+    }
+    memcpy(*tmp, path, n);
+    FILE *f = NULL;
+#if defined(_AVL_HAVE_MMAP)
+    memcpy(*tmp + n, ".XXXXXX", sizeof(".XXXXXX"));
+    int fd = mkstemp(*tmp);
+    if (0 <= fd)
+    {
+        /*! @note mkstemp() creates the file for its owner only, keep the mode of the replaced file */
+        struct stat st;
+        fchmod(fd, (0 == stat(path, &st)) ? (st.st_mode & 0777) : 0644);
+        f = fdopen(fd, "wb");
+        if (NULL == f)
+        {
+            close(fd);
+            remove(*tmp);
+        }
+    }
+#else
+    memcpy(*tmp + n, ".tmp", sizeof(".tmp"));
+    f = fopen(*tmp, "wb");
+#endif
+    if (NULL == f)
+    {
+        s->_config._dealloc(*tmp);
+        *tmp = NULL;
+    }
+    return f;
+}
+
+int avl_set_save(struct avl_set *s, const char *path)
+{
+    assert(s && path);
+    if (0 == s->_key_size)
+    {
+        /*! @note the pointed keys are not in the arena */
+        return -1;
+    }
+    avl_save w;
+    memset(&w, 0, sizeof(avl_save));
+    w.s = s;
+    w.slot = (uint8_t *)(s->_config._alloc(s->_stride));
+    char *tmp = NULL;
+    w.f = w.slot ? __avl_save_open(s, path, &tmp) : NULL;
+    if (NULL == w.f)
+    {
+        if (w.slot)
+            s->_config._dealloc(w.slot);
+        return -1;
+    }
+    avl_file_header h;
+    memset(&h, 0, sizeof(avl_file_header));
+    h.magic = _AVL_FILE_MAGIC;
+    h.version = _AVL_FILE_VERSION;
+    h.word = sizeof(uintptr_t);
+    h.stride = (uint32_t)s->_stride;
+    h.count_off = (uint32_t)s->_count_off;
+    h.key_off = (uint32_t)s->_key_off;
+    h.key_size = (uint32_t)s->_key_size;
+    h.value_off = (uint32_t)s->_value_off;
+    h.value_size = (uint32_t)s->_value_size;
+    h.size = (uint32_t)s->_size;
+    /*! @note the saved tree is perfectly balanced, its root is the middle element */
+    h.root = s->_size ? (uint32_t)(s->_size / 2) : _AVL_NIL;
+    w.failed = (1 != fwrite(&h, sizeof(avl_file_header), 1, w.f));
+    avl_set_first(s, &w.c);
+    __avl_set_save_range(&w, 0, s->_size);
+    if (0 != fflush(w.f))
+    {
+        w.failed = 1;
+    }
+#if defined(_AVL_HAVE_MMAP)
+    if (!w.failed && 0 != fsync(fileno(w.f)))
+    {
+        w.failed = 1;
+    }
+#endif
+    if (0 != fclose(w.f))
+    {
+        w.failed = 1;
+    }
+    /*! @note the file is replaced as a whole, the processes mapping the previous one keep reading it */
+    if (w.failed || 0 != rename(tmp, path))
+    {
+        remove(tmp);
+        w.failed = 1;
+    }
+    s->_config._dealloc(tmp);
+    s->_config._dealloc(w.slot);
+    return w.failed ? -1 : 0;
+}
+
+/*! @brief whether the header describes an arena of the given bytes this build can read */
+static int __avl_file_valid(const avl_file_header *h, size_t bytes)
+{
+    if (_AVL_FILE_MAGIC != h->magic || _AVL_FILE_VERSION != h->version || sizeof(uintptr_t) != h->word)
+    {
+        return 0;
+    }
+    if (0 == h->key_size || 0 != h->stride % sizeof(uintptr_t) || sizeof(avl_node) > h->key_off ||
+        (size_t)h->key_off + h->key_size > h->stride || (size_t)h->value_off + h->value_size > h->stride ||
+        (h->count_off && h->count_off + sizeof(uint32_t) > h->key_off))
+    {
+        return 0;
+    }
+    if (h->size >= _AVL_MAX_SLOTS || (bytes - _AVL_FILE_HEADER) / h->stride != h->size ||
+        (bytes - _AVL_FILE_HEADER) % h->stride)
+    {
+        return 0;
+    }
+    return h->size ? h->root < h->size : _AVL_NIL == h->root;
+}
+
+struct avl_set *avl_set_open_mmap(const char *path, avl_compare cmp)
+{
+    assert(path);
+    if (NULL == cmp)
+    {
+        return NULL;
+    }
+    size_t bytes = 0;
+    void *map = __avl_file_map(path, &bytes);
+    if (NULL == map)
+    {
+        return NULL;
+    }
+    const avl_file_header *h = (const avl_file_header *)map;
+    struct avl_set *s = NULL;
+    if (bytes >= _AVL_FILE_HEADER && __avl_file_valid(h, bytes))
+    {
+        s = (struct avl_set *)(malloc(sizeof(struct avl_set)));
+    }
+    if (NULL == s)
+    {
+        __avl_file_unmap(map, bytes);
+        return NULL;
+    }
+    memset(s, 0, sizeof(struct avl_set));
+    s->_compare = cmp;
+    s->_config._alloc = malloc;
+    s->_config._dealloc = free;
+    s->_config._reserve = h->size;
+    s->_config._options = h->count_off ? AVL_SET_ORDER_STATISTICS : 0;
+    s->_config._key_size = h->key_size;
+    s->_size = h->size;
+    s->_rindex = h->root;
+    s->_version = 1;
+    s->_stride = h->stride;
+    s->_count_off = h->count_off;
+    s->_key_off = h->key_off;
+    s->_key_size = h->key_size;
+    s->_value_off = h->value_off;
+    s->_value_size = h->value_size;
+    /*! @note no slot is free, nothing can be inserted */
+    __avl_set_reset_slots(s, h->size);
+    __avl_set_segment(s);
+    s->_segs_cap = _AVL_MAX(__avl_set_nsegs(s, h->size), (size_t)1);
+    s->_segs = (uint8_t **)(malloc(sizeof(uint8_t *) * s->_segs_cap));
+    if (NULL == s->_segs)
+    {
+        free(s);
+        __avl_file_unmap(map, bytes);
+        return NULL;
+    }
+    size_t k;
+    for (k = 0; k < s->_segs_cap; k++)
+    {
+        /*! @note the segments are consecutive in the file, no entry is biased */
+        s->_segs[k] = (uint8_t *)map + _AVL_FILE_HEADER;
+    }
+    s->_map = map;
+    s->_map_bytes = bytes;
+    return s;
+}
+
+/*! @brief bytes buffered between the set and the ::avl_write or ::avl_read callbacks */
+#define _AVL_STREAM_CHUNK (64 * 1024)
+/*! @brief "CAVS", the first bytes of a stream */
+#define _AVL_STREAM_MAGIC "CAVS"
+#define _AVL_STREAM_VERSION (1u)
+
+/*! @struct avl_stream */
+typedef struct _avl_stream
+{
+    avl_write write;
+    avl_read read;
+    void *ctx;
+    /*! one chunk, the bytes to be written are [0, len), the bytes read but not consumed [pos, len) */
+    uint8_t *buf;
+    size_t len;
+    size_t pos;
+    int failed;
+} avl_stream;
+
+static void __avl_stream_flush(avl_stream *t)
+{
+    if (t->len && !t->failed && 0 != t->write(t->ctx, t->buf, t->len))
+    {
+        t->failed = 1;
+    }
+    t->len = 0;
+}
+
+static void __avl_stream_put(avl_stream *t, const void *p, size_t n)
+{
+    const uint8_t *_p = (const uint8_t *)p;
+    while (n)
+    {
+        if (_AVL_STREAM_CHUNK == t->len)
+        {
+            __avl_stream_flush(t);
+        }
+        size_t _n = _AVL_STREAM_CHUNK - t->len;
+        if (_n > n)
+            _n = n;
+        memcpy(t->buf + t->len, _p, _n);
+        t->len += _n;
+        _p += _n;
+        n -= _n;
+    }
+}
+
+/*! @brief seven bits per byte, the lowest first, the top bit set on all but the last byte */
+static void __avl_stream_put_varint(avl_stream *t, size_t v)
+{
+    uint8_t _b[(sizeof(size_t) * 8 + 6) / 7];
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        _b[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    _b[n++] = (uint8_t)v;
+    __avl_stream_put(t, _b, n);
+}
+
+/*! @brief read exactly n bytes, return 0 on success */
+static int __avl_stream_get(avl_stream *t, void *p, size_t n)
+{
+    uint8_t *_p = (uint8_t *)p;
+    while (n)
+    {
+        if (t->pos == t->len)
+        {
+            t->pos = 0;
+            t->len = t->failed ? 0 : t->read(t->ctx, t->buf, _AVL_STREAM_CHUNK);
+            if (0 == t->len)
+            {
+                /*! @note the stream ended early */
+                t->failed = 1;
+                return -1;
+            }
+        }
+        size_t _n = t->len - t->pos;
+        if (_n > n)
+            _n = n;
+        memcpy(_p, t->buf + t->pos, _n);
+        t->pos += _n;
+        _p += _n;
+        n -= _n;
+    }
+    return 0;
+}
+
+static int __avl_stream_get_varint(avl_stream *t, size_t *v)
+{
+    size_t _shift = 0;
+    *v = 0;
+    while (_shift < sizeof(size_t) * 8)
+    {
+        uint8_t _b = 0;
+        if (0 != __avl_stream_get(t, &_b, 1))
+        {
+            return -1;
+        }
+        *v |= (size_t)(_b & 0x7F) << _shift;
+        if (0 == (_b & 0x80))
+        {
+            return 0;
+        }
+        _shift += 7;
+    }
+    t->failed = 1;
+    return -1;
+}
+
+/*! @brief make *buf hold at least n bytes, keeping its content */
+static int __avl_stream_reserve(const struct avl_set *s, uint8_t **buf, size_t *cap, size_t n)
+{
+    if (n <= *cap)
+    {
+        return 0;
+    }
+    size_t _cap = _AVL_MAX(n, 2 * *cap);
+    uint8_t *_buf = (uint8_t *)(s->_config._alloc(_cap));
+    if (NULL == _buf)
+    {
+        return -1;
+    }
+    if (*buf)
+    {
+        memcpy(_buf, *buf, *cap);
+        s->_config._dealloc(*buf);
+    }
+    *buf = _buf;
+    *cap = _cap;
+    return 0;
+}
+
+int avl_set_serialize(struct avl_set *s, avl_write write, void *ctx, avl_key_encode encode, unsigned int options)
+{
+    assert(s && write);
+    if (NULL == encode && 0 == s->_key_size)
+    {
+        /*! @note the bytes of a pointed key are unknown */
+        return -1;
+    }
+    avl_stream t;
+    memset(&t, 0, sizeof(avl_stream));
+    t.write = write;
+    t.ctx = ctx;
+    t.buf = (uint8_t *)(s->_config._alloc(_AVL_STREAM_CHUNK));
+    /*! @note the previous and the current encoded keys, as large as the largest key */
+    uint8_t *_keys[2] = {NULL, NULL};
+    size_t _caps[2] = {0, 0};
+    size_t _lens[2] = {0, 0};
+    int _cur = 0;
+    int _front = (options & AVL_STREAM_FRONT_CODING) ? 1 : 0;
+    if (NULL == t.buf)
+    {
+        return -1;
+    }
+    __avl_stream_put(&t, _AVL_STREAM_MAGIC, 4);
+    __avl_stream_put_varint(&t, _AVL_STREAM_VERSION);
+    __avl_stream_put_varint(&t, (size_t)_front);
+    __avl_stream_put_varint(&t, s->_size);
+    struct avl_set_cursor c;
+    void *k;
+    for (k = avl_set_first(s, &c); k && !t.failed; k = avl_set_next(&c))
+    {
+        size_t n = s->_key_size;
+        if (encode)
+        {
+            n = encode(k, _keys[_cur], _caps[_cur]);
+            if (n > _caps[_cur])
+            {
+                if (0 != __avl_stream_reserve(s, &_keys[_cur], &_caps[_cur], n))
+                {
+                    t.failed = 1;
+                    break;
+                }
+                encode(k, _keys[_cur], _caps[_cur]);
+            }
+        }
+        else if (0 != __avl_stream_reserve(s, &_keys[_cur], &_caps[_cur], n))
+        {
+            t.failed = 1;
+            break;
+        }
+        else
+        {
+            memcpy(_keys[_cur], k, n);
+        }
+        _lens[_cur] = n;
+        size_t _shared = 0;
+        if (_front)
+        {
+            /*! @note the prefix shared with the previous key is only counted */
+            size_t _max = (n < _lens[!_cur]) ? n : _lens[!_cur];
+            while (_shared < _max && _keys[_cur][_shared] == _keys[!_cur][_shared])
+            {
+                _shared++;
+            }
+            __avl_stream_put_varint(&t, _shared);
+        }
+        __avl_stream_put_varint(&t, n - _shared);
+        __avl_stream_put(&t, _keys[_cur] + _shared, n - _shared);
+        _cur = !_cur;
+    }
+    __avl_stream_flush(&t);
+    s->_config._dealloc(t.buf);
+    if (_keys[0])
+        s->_config._dealloc(_keys[0]);
+    if (_keys[1])
+        s->_config._dealloc(_keys[1]);
+    return t.failed ? -1 : 0;
+}
+
+struct avl_set *avl_set_deserialize(avl_read read, void *ctx, avl_key_decode decode, avl_compare cmp,
+                                    avl_destruct dtor, const struct avl_config *cfg)
+{
+    assert(read);
+    if (NULL == cmp || (NULL == decode && (NULL == cfg || 0 == cfg->_key_size)))
+    {
+        return NULL;
+    }
+    struct avl_set *s = __avl_set_create(cmp, dtor, NULL, 0, cfg);
+    if (NULL == s)
+    {
+        return NULL;
+    }
+    avl_stream t;
+    memset(&t, 0, sizeof(avl_stream));
+    t.read = read;
+    t.ctx = ctx;
+    t.buf = (uint8_t *)(s->_config._alloc(_AVL_STREAM_CHUNK));
+    uint8_t *_key = NULL;
+    size_t _cap = 0;
+    char _magic[4];
+    size_t _version = 0;
+    size_t _front = 0;
+    size_t n = 0;
+    if (NULL == t.buf || 0 != __avl_stream_get(&t, _magic, 4) || 0 != memcmp(_magic, _AVL_STREAM_MAGIC, 4) ||
+        0 != __avl_stream_get_varint(&t, &_version) || _AVL_STREAM_VERSION != _version ||
+        0 != __avl_stream_get_varint(&t, &_front) || 1 < _front || 0 != __avl_stream_get_varint(&t, &n) ||
+        n > _AVL_MAX_SLOTS)
+    {
+        n = 0;
+        t.failed = 1;
+    }
+    /*! @note the stream is sorted, the i-th key goes into slot i and the tree is built at the end */
+    size_t i;
+    size_t _len = 0;
+    for (i = 0; i < n; i++)
+    {
+        size_t _shared = 0;
+        size_t _suffix = 0;
+        /*! @note the count of the stream is not trusted, the arena grows with the keys actually read */
+        size_t _grow = _AVL_MAX(i + 1, 2 * s->_config._reserve);
+        if ((i >= s->_config._reserve && 0 != __avl_set_grow(s, (_grow < n) ? _grow : n)) ||
+            (_front && 0 != __avl_stream_get_varint(&t, &_shared)) || _shared > _len ||
+            0 != __avl_stream_get_varint(&t, &_suffix) || _suffix > ((size_t)-1) / 2 ||
+            0 != __avl_stream_reserve(s, &_key, &_cap, _shared + _suffix + 1) ||
+            0 != __avl_stream_get(&t, _key + _shared, _suffix))
+        {
+            t.failed = 1;
+            break;
+        }
+        _len = _shared + _suffix;
+        void *k = decode ? decode(_key, _len) : ((_len == s->_key_size) ? _key : NULL);
+        if (NULL == k)
+        {
+            t.failed = 1;
+            break;
+        }
+        __avl_store_key(s, (uint32_t)i, k);
+        if (i && 0 <= cmp(__avl_key(s, (uint32_t)(i - 1)), __avl_key(s, (uint32_t)i)))
+        {
+            /*! @note out of order, the key is owned by the set already */
+            i++;
+            t.failed = 1;
+            break;
+        }
+    }
+    /*! @note the keys taken so far, all of them unless it failed, are destroyed with the set on failure */
+    __avl_set_take_prefix(s, i);
+    __avl_set_publish(s);
+    s->_rindex = __avl_set_build(s, NULL, 0, s->_size);
+    s->_version++;
+    if (t.buf)
+        s->_config._dealloc(t.buf);
+    if (_key)
+        s->_config._dealloc(_key);
+    if (t.failed)
+    {
+        avl_set_destroy(s);
+        return NULL;
+    }
+    return s;
+}
+
+/*! @struct avl_shard */
+typedef struct _avl_shard
+{
+#if defined(_AVL_HAVE_PTHREAD)
+    pthread_mutex_t lock;
+#endif
+    /*! the avl_set of the shard, NULL until it is set up in _storage */
+    struct avl_set *set;
+    /*! @note the header of the avl_set, written on every change, lives in the shard with its lock */
+    struct avl_set _storage;
+} avl_shard;
+
+/*! @brief bytes between two shards, the lock and the avl_set header of each shard have their own cache lines */
+#define _AVL_SHARD_STRIDE _AVL_ALIGN(sizeof(avl_shard), _AVL_CACHE_LINE)
+
+struct avl_sharded_set
+{
+    avl_compare _compare;
+    /*! hash partitioner, NULL for the range partitioner */
+    avl_hash _hash;
+    /*! upper bounds of the shards but the last one, exclusive, with the range partitioner */
+    void **_bounds;
+    size_t _nshards;
+    avl_deallocate _dealloc;
+    /*! shards, _AVL_SHARD_STRIDE bytes each, aligned to a cache line */
+    uint8_t *_shards;
+    /*! the allocation holding the shards */
+    void *_raw;
+    /*! a cursor per shard and the heap of the merged walk, with the hash partitioner */
+    struct avl_set_cursor *_cursors;
+    size_t *_heap;
+};
+
+#define _AVL_SHARD(ss, i) ((avl_shard *)((ss)->_shards + (i)*_AVL_SHARD_STRIDE))
+
+static void __avl_shard_lock(avl_shard *h)
+{
+#if defined(_AVL_HAVE_PTHREAD)
+    pthread_mutex_lock(&h->lock);
+#else
+    (void)h;
+#endif
+}
+
+static void __avl_shard_unlock(avl_shard *h)
+{
+#if defined(_AVL_HAVE_PTHREAD)
+    pthread_mutex_unlock(&h->lock);
+#else
+    (void)h;
+#endif
+}
+
+/*! @brief the shard holding k */
+static avl_shard *__avl_sharded_set_shard(const struct avl_sharded_set *ss, const void *k)
+{
+    if (1 == ss->_nshards)
+    {
+        return _AVL_SHARD(ss, 0);
+    }
+    if (ss->_hash)
+    {
+        return _AVL_SHARD(ss, ss->_hash(k) % ss->_nshards);
+    }
+    /*! @note the first shard whose upper bound is greater than k */
+    size_t lo = 0;
+    size_t hi = ss->_nshards - 1;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (0 > ss->_compare(k, ss->_bounds[mid]))
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return _AVL_SHARD(ss, lo);
+}
+
+static struct avl_sharded_set *__avl_sharded_set_create(avl_compare cmp, avl_destruct dtor, avl_hash hash,
+                                                        void *const *bounds, size_t nshards,
+                                                        const struct avl_config *cfg)
+{
+    if (NULL == cmp || 0 == nshards || (cfg && (cfg->_options & AVL_SET_CONCURRENT)))
+    {
+        return NULL;
+    }
+    struct avl_config _config = {
+        ._alloc = malloc,
+        ._dealloc = free,
+        ._reserve = _AVL_DEFAULT_RESERVE};
+    if (cfg)
+    {
+        _config = *cfg;
+        if (NULL == cfg->_alloc || NULL == cfg->_dealloc)
+        {
+            _config._alloc = malloc;
+            _config._dealloc = free;
+        }
+    }
+    /*! @note the reserve is spread over the shards */
+    _config._reserve = _config._reserve / nshards + 1;
+
+    struct avl_sharded_set *ss = (struct avl_sharded_set *)(_config._alloc(sizeof(struct avl_sharded_set)));
+    if (NULL == ss)
+    {
+        return NULL;
+    }
+    memset(ss, 0, sizeof(struct avl_sharded_set));
+    ss->_compare = cmp;
+    ss->_hash = hash;
+    ss->_nshards = nshards;
+    ss->_dealloc = _config._dealloc;
+    ss->_raw = _config._alloc(nshards * _AVL_SHARD_STRIDE + _AVL_CACHE_LINE);
+    if (bounds && nshards > 1)
+    {
+        ss->_bounds = (void **)(_config._alloc(sizeof(void *) * (nshards - 1)));
+        if (ss->_bounds)
+        {
+            memcpy(ss->_bounds, bounds, sizeof(void *) * (nshards - 1));
+        }
+    }
+    if (hash && nshards > 1)
+    {
+        ss->_cursors = (struct avl_set_cursor *)(_config._alloc(sizeof(struct avl_set_cursor) * nshards));
+        ss->_heap = (size_t *)(_config._alloc(sizeof(size_t) * nshards));
+    }
+    if (NULL == ss->_raw || (bounds && nshards > 1 && NULL == ss->_bounds) ||
+        (hash && nshards > 1 && (NULL == ss->_cursors || NULL == ss->_heap)))
+    {
+        avl_sharded_set_destroy(ss);
+        return NULL;
+    }
+    ss->_shards = (uint8_t *)_AVL_ALIGN((uintptr_t)ss->_raw, _AVL_CACHE_LINE);
+    memset(ss->_shards, 0, nshards * _AVL_SHARD_STRIDE);
+    size_t i;
+    for (i = 0; i < nshards; i++)
+    {
+#if defined(_AVL_HAVE_PTHREAD)
+        pthread_mutex_init(&_AVL_SHARD(ss, i)->lock, NULL);
+#endif
+    }
+    for (i = 0; i < nshards; i++)
+    {
+        avl_shard *h = _AVL_SHARD(ss, i);
+        h->set = __avl_set_init(&h->_storage, cmp, dtor, NULL, 0, &_config);
+        if (NULL == h->set)
+        {
+            avl_sharded_set_destroy(ss);
+            return NULL;
+        }
+    }
+    return ss;
+}
+
+struct avl_sharded_set *avl_sharded_set_create(avl_compare cmp, avl_destruct dtor, avl_hash hash, size_t nshards,
+                                               const struct avl_config *cfg)
+{
+    if (NULL == hash && nshards > 1)
+    {
+        return NULL;
+    }
+    return __avl_sharded_set_create(cmp, dtor, hash, NULL, nshards, cfg);
+}
+
+struct avl_sharded_set *avl_sharded_set_create_ranges(avl_compare cmp, avl_destruct dtor, void *const *bounds,
+                                                      size_t nbounds, const struct avl_config *cfg)
+{
+    if (NULL == bounds && nbounds)
+    {
+        return NULL;
+    }
+#ifndef NDEBUG
+    size_t j;
+    for (j = 1; j < nbounds; j++)
+    {
+        assert(0 > cmp(bounds[j - 1], bounds[j]));
+    }
+#endif
+    return __avl_sharded_set_create(cmp, dtor, NULL, bounds, nbounds + 1, cfg);
+}
+
+void avl_sharded_set_destroy(struct avl_sharded_set *ss)
+{
+    if (ss)
+    {
+        size_t i;
+        for (i = 0; ss->_shards && i < ss->_nshards; i++)
+        {
+            avl_shard *h = _AVL_SHARD(ss, i);
+            /*! @note the shards after a failed creation have no avl_set */
+            if (h->set)
+            {
+                avl_set_clear(h->set);
+                __avl_set_fini(h->set);
+            }
+#if defined(_AVL_HAVE_PTHREAD)
+            pthread_mutex_destroy(&h->lock);
+#endif
+        }
+        avl_deallocate _f = ss->_dealloc;
+        if (ss->_raw)
+            _f(ss->_raw);
+        if (ss->_bounds)
+            _f(ss->_bounds);
+        if (ss->_cursors)
+            _f(ss->_cursors);
+        if (ss->_heap)
+            _f(ss->_heap);
+        _f(ss);
+    }
+}
+
+size_t avl_sharded_set_size(struct avl_sharded_set *ss)
+{
+    assert(ss);
+    size_t _size = 0;
+    size_t i;
+    for (i = 0; i < ss->_nshards; i++)
+    {
+        avl_shard *h = _AVL_SHARD(ss, i);
+        __avl_shard_lock(h);
+        _size += avl_set_size(h->set);
+        __avl_shard_unlock(h);
+    }
+    return _size;
+}
+
+int avl_sharded_set_insert(struct avl_sharded_set *ss, void *k)
+{
+    assert(ss);
+    avl_shard *h = __avl_sharded_set_shard(ss, k);
+    __avl_shard_lock(h);
+    int _ret = avl_set_insert(h->set, k);
+    __avl_shard_unlock(h);
+    return _ret;
+}
+
+int avl_sharded_set_delete(struct avl_sharded_set *ss, const void *k)
+{
+    assert(ss);
+    avl_shard *h = __avl_sharded_set_shard(ss, k);
+    __avl_shard_lock(h);
+    int _ret = avl_set_delete(h->set, k);
+    __avl_shard_unlock(h);
+    return _ret;
+}
+
+int avl_sharded_set_contains(struct avl_sharded_set *ss, const void *k)
+{
+    assert(ss);
+    avl_shard *h = __avl_sharded_set_shard(ss, k);
+    __avl_shard_lock(h);
+    int _ret = (NULL != avl_set_search(h->set, k));
+    __avl_shard_unlock(h);
+    return _ret;
+}
+
+/*! @brief restore the min-heap of the shard cursors from position i down, ordered by their current elements */
+static void __avl_shard_heap_down(const struct avl_sharded_set *ss, struct avl_set_cursor *cur, size_t *heap, size_t n,
+                                  size_t i)
+{
+    while (1)
+    {
+        size_t _min = i;
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        if (l < n && 0 > ss->_compare(avl_set_cursor_get(&cur[heap[l]]), avl_set_cursor_get(&cur[heap[_min]])))
+            _min = l;
+        if (r < n && 0 > ss->_compare(avl_set_cursor_get(&cur[heap[r]]), avl_set_cursor_get(&cur[heap[_min]])))
+            _min = r;
+        if (_min == i)
+        {
+            return;
+        }
+        size_t _t = heap[i];
+        heap[i] = heap[_min];
+        heap[_min] = _t;
+        i = _min;
+    }
+}
+
+size_t avl_sharded_set_foreach(struct avl_sharded_set *ss, avl_visit visit, void *arg)
+{
+    assert(ss && visit);
+    size_t _visited = 0;
+    size_t i;
+    /*! @note the shards are always locked in the same order, no other thread locks more than one */
+    for (i = 0; i < ss->_nshards; i++)
+    {
+        __avl_shard_lock(_AVL_SHARD(ss, i));
+    }
+    if (NULL == ss->_cursors)
+    {
+        /*! @note the ranges follow each other, the shards are walked one after another */
+        int _stop = 0;
+        for (i = 0; i < ss->_nshards && !_stop; i++)
+        {
+            struct avl_set_cursor c;
+            void *e;
+            for (e = avl_set_first(_AVL_SHARD(ss, i)->set, &c); e && !_stop; e = avl_set_next(&c))
+            {
+                _visited++;
+                _stop = visit(e, arg);
+            }
+        }
+    }
+    else
+    {
+        /*! @note a k-way merge, the heap keeps the shards by their current elements */
+        struct avl_set_cursor *cur = ss->_cursors;
+        size_t *heap = ss->_heap;
+        size_t n = 0;
+        for (i = 0; i < ss->_nshards; i++)
+        {
+            if (avl_set_first(_AVL_SHARD(ss, i)->set, &cur[i]))
+            {
+                heap[n++] = i;
+            }
+        }
+        for (i = n / 2; i > 0; i--)
+        {
+            __avl_shard_heap_down(ss, cur, heap, n, i - 1);
+        }
+        while (n)
+        {
+            _visited++;
+            if (visit(avl_set_cursor_get(&cur[heap[0]]), arg))
+            {
+                break;
+            }
+            if (NULL == avl_set_next(&cur[heap[0]]))
+            {
+                heap[0] = heap[--n];
+            }
+            __avl_shard_heap_down(ss, cur, heap, n, 0);
+        }
+    }
+    for (i = ss->_nshards; i > 0; i--)
+    {
+        __avl_shard_unlock(_AVL_SHARD(ss, i - 1));
+    }
+    return _visited;
 }
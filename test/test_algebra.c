@@ -0,0 +1,201 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+static size_t _destructed = 0;
+
+void int_destruct(void *p)
+{
+    _destructed++;
+    free(p);
+}
+
+#define N_ELEMENTS (100000)
+
+/* a holds the multiples of _step, b the multiples of 3 */
+static int _step = 2;
+
+void fill(struct avl_set *a, struct avl_set *b)
+{
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        int *_v = NULL;
+        if (0 == i % _step)
+        {
+            _v = (int *)malloc(sizeof(int));
+            *_v = i;
+            ASSERT_AND_ABORT(0 == avl_set_insert(a, _v));
+        }
+        if (0 == i % 3)
+        {
+            _v = (int *)malloc(sizeof(int));
+            *_v = i;
+            ASSERT_AND_ABORT(0 == avl_set_insert(b, _v));
+        }
+    }
+}
+
+void check(struct avl_set *r, int (*member)(int))
+{
+    struct avl_set_cursor c;
+    size_t _count = 0;
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        void *_rslt = avl_set_search(r, &i);
+        ASSERT_AND_ABORT(member(i) ? (_rslt && i == *(const int *)_rslt) : (NULL == _rslt));
+        _count += member(i);
+    }
+    ASSERT_AND_ABORT(_count == avl_set_size(r));
+    ASSERT_AND_ABORT(0 == avl_set_validate(r, NULL, 0));
+    int _prev = -1;
+    void *_e = NULL;
+    for (_e = avl_set_first(r, &c); _e; _e = avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(_prev < *(const int *)_e);
+        _prev = *(const int *)_e;
+    }
+}
+
+int in_union(int i)
+{
+    return 0 == i % _step || 0 == i % 3;
+}
+
+int in_intersection(int i)
+{
+    return 0 == i % _step && 0 == i % 3;
+}
+
+int in_difference(int i)
+{
+    return 0 == i % _step && 0 != i % 3;
+}
+
+int in_reverse_difference(int i)
+{
+    return 0 != i % _step && 0 == i % 3;
+}
+
+/* r holds copies of the elements of a and b, these keep owning them */
+void check_operands(struct avl_set *a, struct avl_set *b, size_t na, size_t nb)
+{
+    ASSERT_AND_ABORT(na == avl_set_size(a) && nb == avl_set_size(b));
+    ASSERT_AND_ABORT(0 == avl_set_validate(a, NULL, 0) && 0 == avl_set_validate(b, NULL, 0));
+    ASSERT_AND_ABORT(0 == _destructed);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int _threads[3] = {1, 4, 64};
+    /* a larger than b, then a much smaller than b */
+    int _steps[2] = {2, 2000};
+    size_t t = 0;
+    size_t k = 0;
+    for (k = 0; k < 2; k++)
+    {
+        _step = _steps[k];
+        for (t = 0; t < 3; t++)
+        {
+            struct avl_set *a = avl_set_create(int_compare, int_destruct, NULL);
+            struct avl_set *b = avl_set_create(int_compare, int_destruct, NULL);
+            struct avl_set *r = NULL;
+
+            fill(a, b);
+            size_t na = avl_set_size(a);
+            size_t nb = avl_set_size(b);
+            _destructed = 0;
+            r = avl_set_union(a, b, _threads[t]);
+            ASSERT_AND_ABORT(r);
+            check(r, in_union);
+            check_operands(a, b, na, nb);
+            /* of two equal elements the one of b is taken */
+            int _six = 6;
+            ASSERT_AND_ABORT(avl_set_search(r, &_six) == avl_set_search(b, &_six));
+            printf("%u threads: union of %zu elements\n", _threads[t], avl_set_size(r));
+            avl_set_destroy(r);
+
+            r = avl_set_intersection(a, b, _threads[t]);
+            ASSERT_AND_ABORT(r);
+            check(r, in_intersection);
+            check_operands(a, b, na, nb);
+            printf("%u threads: intersection of %zu elements\n", _threads[t], avl_set_size(r));
+            avl_set_destroy(r);
+
+            r = avl_set_difference(a, b, _threads[t]);
+            ASSERT_AND_ABORT(r);
+            check(r, in_difference);
+            check_operands(a, b, na, nb);
+            printf("%u threads: difference of %zu elements\n", _threads[t], avl_set_size(r));
+            avl_set_destroy(r);
+
+            /* the difference of b and a, then the operations of a set with itself */
+            r = avl_set_difference(b, a, _threads[t]);
+            ASSERT_AND_ABORT(r);
+            check(r, in_reverse_difference);
+            avl_set_destroy(r);
+            r = avl_set_union(a, a, _threads[t]);
+            ASSERT_AND_ABORT(r && na == avl_set_size(r) && 0 == avl_set_validate(r, NULL, 0));
+            avl_set_destroy(r);
+            r = avl_set_difference(a, a, _threads[t]);
+            ASSERT_AND_ABORT(r && 0 == avl_set_size(r));
+            avl_set_destroy(r);
+            check_operands(a, b, na, nb);
+
+            avl_set_destroy(a);
+            avl_set_destroy(b);
+            ASSERT_AND_ABORT(na + nb == _destructed);
+        }
+    }
+
+    /* mismatched sets are refused */
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS};
+    struct avl_set *a = avl_set_create(int_compare, NULL, NULL);
+    struct avl_set *c = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(NULL == avl_set_union(a, c, 1));
+    avl_set_destroy(c);
+    avl_set_destroy(a);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 20)
+
+/* a counting arena allocator, over-allocates to honour the alignment */
+struct arena_stats
+{
+    size_t live_bytes;
+    size_t live_arenas;
+    size_t peak_bytes;
+    size_t align;
+};
+
+static void *arena_alloc(void *ctx, size_t bytes, size_t align)
+{
+    struct arena_stats *st = (struct arena_stats *)ctx;
+    uint8_t *raw = (uint8_t *)malloc(bytes + align + sizeof(void *));
+    if (NULL == raw)
+    {
+        return NULL;
+    }
+    uint8_t *p = (uint8_t *)(((uintptr_t)raw + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1));
+    ((void **)p)[-1] = raw;
+    st->live_bytes += bytes;
+    st->live_arenas++;
+    st->align = align;
+    if (st->live_bytes > st->peak_bytes)
+    {
+        st->peak_bytes = st->live_bytes;
+    }
+    return p;
+}
+
+static void arena_dealloc(void *ctx, void *p, size_t bytes)
+{
+    struct arena_stats *st = (struct arena_stats *)ctx;
+    ASSERT_AND_ABORT(st->live_arenas > 0 && st->live_bytes >= bytes);
+    st->live_bytes -= bytes;
+    st->live_arenas--;
+    free(((void **)p)[-1]);
+}
+
+static double now_ms(void)
+{
+    return (double)clock() * 1e3 / CLOCKS_PER_SEC;
+}
+
+/* insert, look up and delete N_ELEMENTS keys, returns the mean nanoseconds of a lookup */
+static double run(struct avl_set *s)
+{
+    int i, k;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        k = (int)(((long)i * 7919) % N_ELEMENTS);
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &k));
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_size(s));
+    srand(3);
+    double t0 = now_ms();
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        k = rand() % N_ELEMENTS;
+        ASSERT_AND_ABORT(k == *(int *)avl_set_search(s, &k));
+    }
+    double ns = (now_ms() - t0) * 1e6 / N_ELEMENTS;
+    struct avl_set_cursor c;
+    int *e = (int *)avl_set_first(s, &c);
+    for (i = 0; e; e = (int *)avl_set_next(&c), i++)
+    {
+        ASSERT_AND_ABORT(*e == i);
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == i);
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 == avl_set_size(s));
+    return ns;
+}
+
+int main(int argc, char **argv)
+{
+    struct arena_stats st;
+    memset(&st, 0, sizeof(st));
+    struct avl_config _config = {
+        ._reserve = 4,
+        ._key_size = sizeof(int),
+        ._arena_alloc = arena_alloc,
+        ._arena_dealloc = arena_dealloc,
+        ._arena_ctx = &st};
+
+    /* the arena and only the arena comes from the hooks, all of it goes back */
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(1 == st.live_arenas && 64 == st.align);
+    run(s);
+    size_t held = st.live_bytes;
+    ASSERT_AND_ABORT(held >= (size_t)N_ELEMENTS * 2 * sizeof(int) && held == st.peak_bytes);
+    ASSERT_AND_ABORT(0 == avl_set_compact(s, AVL_LAYOUT_BREADTH_FIRST) && held == st.live_bytes);
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(0 == st.live_arenas && 0 == st.live_bytes);
+
+    /* the huge page policies ask the hooks for 2 MB alignment */
+    _config._arena_policy = AVL_ARENA_HUGE_PAGES;
+    s = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(1 == st.live_arenas && ((size_t)2 << 20) == st.align);
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(0 == st.live_arenas);
+
+    /* the policies alone, whatever the kernel grants the set works the same */
+    _config._arena_alloc = NULL;
+    _config._arena_dealloc = NULL;
+    _config._arena_ctx = NULL;
+    _config._reserve = 0;
+    unsigned int policies[] = {0, AVL_ARENA_HUGE_PAGES, AVL_ARENA_HUGETLB, AVL_ARENA_NUMA_INTERLEAVE,
+                               AVL_ARENA_HUGE_PAGES | AVL_ARENA_NUMA_BIND};
+    const char *names[] = {"default", "huge pages", "hugetlb", "interleave", "huge pages, bound"};
+    size_t p;
+    for (p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+    {
+        _config._arena_policy = policies[p];
+        s = avl_set_create(int_compare, NULL, &_config);
+        ASSERT_AND_ABORT(NULL != s);
+        double ns = run(s);
+        printf("lookup: %.1f ns with %s arena\n", ns, names[p]);
+        avl_set_destroy(s);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+
+#define N_ELEMENTS (10000)
+#define N_LOOKUPS (100)
+
+int main(int argc, char **argv)
+{
+    static int _values[N_ELEMENTS];
+    static int _lookups[N_LOOKUPS];
+    void *_keys[N_LOOKUPS];
+    void *_out[N_LOOKUPS];
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        _values[i] = ((i * 7919) % N_ELEMENTS) * 2;
+    }
+    for (i = 0; i < N_LOOKUPS; i++)
+    {
+        /* odd keys are misses */
+        _lookups[i] = (i * 601) % (N_ELEMENTS * 3 / 2);
+        _keys[i] = &_lookups[i];
+    }
+
+    /* pointer keys and inline keys take different paths */
+    size_t _key_size = 0;
+    for (_key_size = 0; _key_size <= sizeof(int); _key_size += sizeof(int))
+    {
+        struct avl_config _config = {
+            ._key_size = _key_size};
+        struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+        ASSERT_AND_ABORT(0 == avl_set_search_batch(s, _keys, N_LOOKUPS, _out));
+        for (i = 0; i < N_LOOKUPS; i++)
+        {
+            ASSERT_AND_ABORT(NULL == _out[i]);
+        }
+        for (i = 0; i < N_ELEMENTS; i++)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_insert(s, &_values[i]));
+        }
+
+        size_t _found = avl_set_search_batch(s, _keys, N_LOOKUPS, _out);
+        size_t _expected = 0;
+        for (i = 0; i < N_LOOKUPS; i++)
+        {
+            void *_rslt = avl_set_search(s, _keys[i]);
+            ASSERT_AND_ABORT(_rslt == _out[i]);
+            if (_rslt)
+            {
+                ASSERT_AND_ABORT(_lookups[i] == *(const int *)_rslt);
+                _expected++;
+            }
+        }
+        ASSERT_AND_ABORT(_expected == _found);
+        /* a batch shorter than one group */
+        ASSERT_AND_ABORT(avl_set_search_batch(s, _keys, 3, _out) == (size_t)(!!_out[0] + !!_out[1] + !!_out[2]));
+        printf("key size %zu: found %zu of %d\n", _key_size, _found, N_LOOKUPS);
+        avl_set_destroy(s);
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+
+#define N_ELEMENTS (100000)
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS,
+        ._key_size = sizeof(int)};
+
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+
+    static int _values[N_ELEMENTS];
+    static void *_keys[N_ELEMENTS];
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        _values[i] = i * 2;
+        _keys[i] = &_values[i];
+    }
+    ASSERT_AND_ABORT(0 == avl_set_build_sorted(s, _keys, N_ELEMENTS));
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_size(s));
+    ASSERT_AND_ABORT(-1 == avl_set_build_sorted(s, _keys, N_ELEMENTS));
+    printf("built %d elements\n", N_ELEMENTS);
+
+    for (i = 0; i < N_ELEMENTS * 2; i++)
+    {
+        void *_rslt = avl_set_search(s, &i);
+        ASSERT_AND_ABORT((i % 2) ? (NULL == _rslt) : (_rslt && i == *(const int *)_rslt));
+    }
+    for (i = 0; i < N_ELEMENTS; i += 1000)
+    {
+        void *_e = avl_set_select(s, i, NULL);
+        ASSERT_AND_ABORT(_e && i * 2 == *(const int *)_e);
+    }
+
+    /* the built tree stays a regular avl_set */
+    for (i = 1; i < N_ELEMENTS * 2; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    for (i = 0; i < N_ELEMENTS * 2; i += 4)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS * 3 / 2 == avl_set_size(s));
+
+    struct avl_set_cursor c;
+    size_t _count = 0;
+    int _prev = -1;
+    void *_e = NULL;
+    for (_e = avl_set_first(s, &c); _e; _e = avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(_prev < *(const int *)_e && 0 != *(const int *)_e % 4);
+        _prev = *(const int *)_e;
+        _count++;
+    }
+    ASSERT_AND_ABORT(avl_set_size(s) == _count);
+    printf("%zu elements after updates\n", _count);
+
+    avl_set_clear(s);
+    ASSERT_AND_ABORT(0 == avl_set_build_sorted(s, _keys, 0));
+    ASSERT_AND_ABORT(NULL == avl_set_first(s, &c));
+    avl_set_destroy(s);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 20)
+#define N_LOOKUPS (1 << 20)
+
+static double now_ms(void)
+{
+    return (double)clock() * 1e3 / CLOCKS_PER_SEC;
+}
+
+/* mean nanoseconds of a lookup of a random key */
+static double lookup_ns(struct avl_set *s, const int *probes)
+{
+    double t0 = now_ms();
+    size_t found = 0;
+    int i;
+    for (i = 0; i < N_LOOKUPS; i++)
+    {
+        found += (NULL != avl_set_search(s, &probes[i]));
+    }
+    ASSERT_AND_ABORT(found == N_LOOKUPS);
+    return (now_ms() - t0) * 1e6 / N_LOOKUPS;
+}
+
+static void check(struct avl_set *s, int step)
+{
+    struct avl_set_cursor c;
+    int *e = (int *)avl_set_first(s, &c);
+    int i;
+    for (i = 0; e; e = (int *)avl_set_next(&c), i += step)
+    {
+        ASSERT_AND_ABORT(*e == i);
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == i);
+    int k = N_ELEMENTS / 2;
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(s, &k, &rank) && (size_t)k / step == rank);
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS,
+        ._key_size = sizeof(int)};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    int *probes = (int *)malloc(sizeof(int) * N_LOOKUPS);
+    int i;
+    /* the odd keys go in first and out last, the even ones take their slots in another order */
+    srand(11);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        int k = (int)(((long)i * 7919) % N_ELEMENTS);
+        k |= 1;
+        avl_set_insert(s, &k);
+    }
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        int k = (int)(((long)i * 104729) % N_ELEMENTS) & ~1;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &k));
+    }
+    for (i = 1; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    for (i = 0; i < N_LOOKUPS; i++)
+    {
+        probes[i] = (rand() % (N_ELEMENTS / 2)) * 2;
+    }
+    check(s, 2);
+    double scattered = lookup_ns(s, probes);
+
+    ASSERT_AND_ABORT(0 == avl_set_compact(s, AVL_LAYOUT_BREADTH_FIRST));
+    check(s, 2);
+    double bfs = lookup_ns(s, probes);
+    ASSERT_AND_ABORT(0 == avl_set_compact(s, AVL_LAYOUT_VAN_EMDE_BOAS));
+    check(s, 2);
+    double veb = lookup_ns(s, probes);
+    printf("lookup: %.1f ns scattered, %.1f ns breadth-first, %.1f ns van Emde Boas\n", scattered, bfs, veb);
+
+    /* it stays mutable */
+    for (i = 1; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    check(s, 1);
+    for (i = 1; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    check(s, 2);
+    avl_set_destroy(s);
+
+    /* an empty set, and a concurrent one */
+    s = avl_set_create(int_compare, NULL, NULL);
+    ASSERT_AND_ABORT(0 == avl_set_compact(s, AVL_LAYOUT_VAN_EMDE_BOAS) && 0 == avl_set_size(s));
+    i = 1;
+    ASSERT_AND_ABORT(0 == avl_set_insert(s, &i) && &i == avl_set_search(s, &i));
+    avl_set_destroy(s);
+    _config._options = AVL_SET_CONCURRENT;
+    s = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(-1 == avl_set_compact(s, AVL_LAYOUT_BREADTH_FIRST));
+    avl_set_destroy(s);
+    free(probes);
+    return 0;
+}
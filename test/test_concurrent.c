@@ -0,0 +1,297 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+/* destructions, by the writer alone */
+static size_t destructed;
+
+/* a destructed key is poisoned, a reader seeing it has been handed a recycled element */
+void int_destruct(void *p)
+{
+    destructed++;
+    *(int *)p = -1;
+    free(p);
+}
+
+#define N_KEYS (1 << 16)
+#define MAX_READERS (64)
+#define STRESS_MS (500)
+
+struct shared
+{
+    struct avl_set *set;
+    volatile int stop;
+    /* the writer erases and refills ranges of keys instead */
+    int ranges;
+};
+
+struct reader_arg
+{
+    struct shared *shared;
+    unsigned int seed;
+    size_t reads;
+    size_t walked;
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int *new_key(int v)
+{
+    int *k = (int *)malloc(sizeof(int));
+    ASSERT_AND_ABORT(k);
+    *k = v;
+    return k;
+}
+
+/* the writer keeps about half of the keys, and replaces some of them in place */
+void *writer(void *arg)
+{
+    struct shared *sh = (struct shared *)arg;
+    unsigned int seed = 1;
+    while (!sh->stop)
+    {
+        int v = rand_r(&seed) % N_KEYS;
+        int *k = new_key(v);
+        if (sh->ranges)
+        {
+            /* cut out up to 32 keys at once, or put them back one by one */
+            int to = v + 32;
+            int i;
+            if (rand_r(&seed) % 2)
+            {
+                ASSERT_AND_ABORT(avl_set_erase_range(sh->set, k, &to) <= 32);
+            }
+            else
+            {
+                for (i = v + 1; i < to; i++)
+                    ASSERT_AND_ABORT(0 <= avl_set_insert(sh->set, new_key(i)));
+                ASSERT_AND_ABORT(0 <= avl_set_insert(sh->set, k));
+                k = NULL;
+            }
+            free(k);
+        }
+        else if (rand_r(&seed) % 2)
+        {
+            ASSERT_AND_ABORT(0 <= avl_set_insert(sh->set, k));
+        }
+        else
+        {
+            avl_set_delete(sh->set, k);
+            free(k);
+        }
+    }
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    struct reader_arg *ra = (struct reader_arg *)arg;
+    struct shared *sh = ra->shared;
+    struct avl_reader *r = avl_set_reader_register(sh->set);
+    ASSERT_AND_ABORT(r);
+    while (!sh->stop)
+    {
+        int i;
+        avl_set_reader_enter(r);
+        for (i = 0; i < 64; i++)
+        {
+            int v = rand_r(&ra->seed) % N_KEYS;
+            int *k = (int *)avl_set_search(sh->set, &v);
+            ASSERT_AND_ABORT(NULL == k || *k == v);
+        }
+        if (0 == ra->reads % 4096)
+        {
+            /* a short walk, the cursor keeps its order across the changes of the writer */
+            struct avl_set_cursor c;
+            int v = rand_r(&ra->seed) % N_KEYS;
+            int prev = v - 1;
+            int *k = (int *)avl_set_lower_bound(sh->set, &v, &c);
+            for (i = 0; k && i < 32; i++, k = (int *)avl_set_next(&c))
+            {
+                ASSERT_AND_ABORT(*k > prev);
+                prev = *k;
+                ra->walked++;
+            }
+        }
+        avl_set_reader_exit(r);
+        ra->reads += 64;
+    }
+    avl_set_reader_unregister(r);
+    return NULL;
+}
+
+/* run n readers next to the writer for ms milliseconds, return the lookups per second */
+double run(struct shared *sh, int n, int ms, size_t *walked)
+{
+    pthread_t tw;
+    pthread_t tr[MAX_READERS];
+    struct reader_arg ra[MAX_READERS];
+    int i;
+    sh->stop = 0;
+    for (i = 0; i < n; i++)
+    {
+        memset(&ra[i], 0, sizeof(ra[i]));
+        ra[i].shared = sh;
+        ra[i].seed = (unsigned int)i + 7;
+        ASSERT_AND_ABORT(0 == pthread_create(&tr[i], NULL, reader, &ra[i]));
+    }
+    ASSERT_AND_ABORT(0 == pthread_create(&tw, NULL, writer, sh));
+    double t0 = now_ms();
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+    sh->stop = 1;
+    pthread_join(tw, NULL);
+    size_t reads = 0;
+    for (i = 0; i < n; i++)
+    {
+        pthread_join(tr[i], NULL);
+        reads += ra[i].reads;
+        if (walked)
+            *walked += ra[i].walked;
+    }
+    return reads / ((now_ms() - t0) / 1e3);
+}
+
+struct avl_set *filled_set(unsigned int options)
+{
+    struct avl_config _config = {
+        ._options = options};
+    struct avl_set *s = avl_set_create(int_compare, int_destruct, &_config);
+    int i;
+    ASSERT_AND_ABORT(s);
+    for (i = 0; i < N_KEYS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, new_key(i)));
+    }
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    struct shared sh;
+    memset(&sh, 0, sizeof(sh));
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+        ncpu = 1;
+    if (ncpu > MAX_READERS)
+        ncpu = MAX_READERS;
+
+    /* a plain set has no readers */
+    struct avl_set *s = filled_set(0);
+    ASSERT_AND_ABORT(NULL == avl_set_reader_register(s));
+    avl_set_destroy(s);
+
+    /* stress: every reader checks what it finds while the writer keeps changing the set */
+    sh.set = filled_set(AVL_SET_CONCURRENT | AVL_SET_ORDER_STATISTICS);
+    size_t walked = 0;
+    double rate = run(&sh, ncpu < 4 ? 4 : ncpu, STRESS_MS, &walked);
+    printf("stress: %.0f lookups/s, %zu elements walked, %zu elements left\n", rate, walked, avl_set_size(sh.set));
+    struct avl_set_cursor c;
+    int *k;
+    int prev = -1;
+    size_t n = 0;
+    for (k = (int *)avl_set_first(sh.set, &c); k; k = (int *)avl_set_next(&c), n++)
+    {
+        ASSERT_AND_ABORT(*k > prev);
+        prev = *k;
+    }
+    ASSERT_AND_ABORT(n == avl_set_size(sh.set));
+    ASSERT_AND_ABORT(NULL == avl_set_select(sh.set, n, NULL));
+
+    /* the same with ranges erased one element at a time, each in its own short change */
+    sh.ranges = 1;
+    rate = run(&sh, ncpu < 4 ? 4 : ncpu, STRESS_MS, NULL);
+    sh.ranges = 0;
+    int from = 0;
+    int half = N_KEYS / 2;
+    size_t before = avl_set_size(sh.set);
+    size_t erased = avl_set_erase_range(sh.set, &from, &half);
+    ASSERT_AND_ABORT(before - erased == avl_set_size(sh.set));
+    k = (int *)avl_set_first(sh.set, &c);
+    ASSERT_AND_ABORT(NULL == k || *k >= half);
+    printf("ranges: %.0f lookups/s, %zu elements erased at last\n", rate, erased);
+
+    /* a reader staying in its read section holds every element deleted meanwhile, however many */
+    /* an extraction waits for the older readers, nothing is left to reclaim */
+    k = (int *)avl_set_first(sh.set, &c);
+    free(avl_set_extract(sh.set, k));
+    struct avl_reader *r = avl_set_reader_register(sh.set);
+    ASSERT_AND_ABORT(r);
+    avl_set_reader_enter(r);
+    int *held = (int *)avl_set_last(sh.set, &c);
+    int last = *held;
+    before = destructed;
+    n = 0;
+    while ((k = (int *)avl_set_first(sh.set, &c)) && k != held)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(sh.set, k));
+        n++;
+    }
+    ASSERT_AND_ABORT(before == destructed && last == *held && 1 == avl_set_size(sh.set));
+    avl_set_reader_exit(r);
+    avl_set_reader_unregister(r);
+    /* the next change reclaims them */
+    ASSERT_AND_ABORT(0 == avl_set_delete(sh.set, held));
+    ASSERT_AND_ABORT(before + n + 1 == destructed);
+    printf("held: %zu elements kept until the reader exited\n", n);
+    avl_set_destroy(sh.set);
+    return 0;
+}
+#else
+int main(int argc, char **argv)
+{
+    printf("no threads on this platform, skipped\n");
+    return 0;
+}
+#endif
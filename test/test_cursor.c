@@ -0,0 +1,109 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1000)
+
+int main(int argc, char **argv)
+{
+    struct avl_set *s = avl_set_create(int_compare, NULL, NULL);
+    struct avl_set_cursor c;
+
+    ASSERT_AND_ABORT(NULL == avl_set_first(s, &c));
+    ASSERT_AND_ABORT(NULL == avl_set_last(s, &c));
+    ASSERT_AND_ABORT(NULL == avl_set_next(&c));
+
+    /* even numbers only, so that odd keys fall between two elements */
+    static int _values[N_ELEMENTS];
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        _values[i] = ((i * 7919) % N_ELEMENTS) * 2;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &_values[i]));
+    }
+
+    int expected = 0;
+    void *_e = NULL;
+    for (_e = avl_set_first(s, &c); _e; _e = avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(expected == *(const int *)_e);
+        ASSERT_AND_ABORT(_e == avl_set_cursor_get(&c));
+        expected += 2;
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS * 2 == expected);
+    printf("forward scan of %d elements\n", N_ELEMENTS);
+
+    for (_e = avl_set_last(s, &c); _e; _e = avl_set_prev(&c))
+    {
+        expected -= 2;
+        ASSERT_AND_ABORT(expected == *(const int *)_e);
+    }
+    ASSERT_AND_ABORT(0 == expected);
+    printf("backward scan of %d elements\n", N_ELEMENTS);
+
+    /* range scan [101, 201) */
+    int _from = 101;
+    int _to = 201;
+    int _count = 0;
+    for (_e = avl_set_lower_bound(s, &_from, &c); _e && *(const int *)_e < _to; _e = avl_set_next(&c))
+    {
+        _count++;
+    }
+    ASSERT_AND_ABORT(50 == _count);
+    printf("range scan got %d elements\n", _count);
+
+    int _key = 100;
+    ASSERT_AND_ABORT(100 == *(const int *)avl_set_lower_bound(s, &_key, &c));
+    ASSERT_AND_ABORT(98 == *(const int *)avl_set_prev(&c));
+    ASSERT_AND_ABORT(102 == *(const int *)avl_set_upper_bound(s, &_key, &c));
+    ASSERT_AND_ABORT(100 == *(const int *)avl_set_prev(&c));
+
+    _key = -1;
+    ASSERT_AND_ABORT(0 == *(const int *)avl_set_lower_bound(s, &_key, &c));
+    ASSERT_AND_ABORT(NULL == avl_set_prev(&c));
+    _key = N_ELEMENTS * 2 - 2;
+    ASSERT_AND_ABORT(NULL == avl_set_upper_bound(s, &_key, &c));
+    ASSERT_AND_ABORT(NULL == avl_set_cursor_get(&c));
+
+    avl_set_destroy(s);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+/* an element: the key it is ordered by, and which copy of the key it is */
+struct item
+{
+    int key;
+    int copy;
+};
+
+int item_compare(const void *lhs, const void *rhs)
+{
+    int l = ((const struct item *)lhs)->key;
+    int r = ((const struct item *)rhs)->key;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+static size_t destroyed;
+
+void item_destroy(void *p)
+{
+    destroyed++;
+    free(p);
+}
+
+static struct item *item_new(int key, int copy)
+{
+    struct item *e = (struct item *)malloc(sizeof(struct item));
+    ASSERT_AND_ABORT(e);
+    e->key = key;
+    e->copy = copy;
+    return e;
+}
+
+#define N_ELEMENTS (4096)
+
+/* the pointer keys of a plain, a concurrent and a snapshot avl_set */
+static void test_pointer_keys(unsigned int options)
+{
+    struct avl_config _config = {._options = options};
+    struct avl_set *s = avl_set_create(item_compare, item_destroy, &_config);
+    struct avl_reader *r = (options & AVL_SET_CONCURRENT) ? avl_set_reader_register(s) : NULL;
+    int i;
+    int inserted = 0;
+    destroyed = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        struct item *e = item_new(i, 0);
+        ASSERT_AND_ABORT(e == avl_set_find_or_insert(s, e, &inserted) && inserted);
+    }
+
+    /* a duplicate finds the element in place, nothing is destroyed */
+    struct item *dup = item_new(7, 1);
+    struct item *found = (struct item *)avl_set_find_or_insert(s, dup, &inserted);
+    ASSERT_AND_ABORT(!inserted && 7 == found->key && 0 == found->copy && 0 == destroyed);
+    void *prev = NULL;
+    ASSERT_AND_ABORT(1 == avl_set_insert_or_assign(s, dup, AVL_ASSIGN_KEEP, &prev) && prev == found);
+
+    /* a detached element is handed back, a replaced one is destroyed */
+    ASSERT_AND_ABORT(1 == avl_set_insert_or_assign(s, dup, AVL_ASSIGN_DETACH, &prev) && prev == found);
+    ASSERT_AND_ABORT(dup == avl_set_search(s, &(struct item){7, 0}) && 0 == destroyed);
+    ASSERT_AND_ABORT(1 == avl_set_insert_or_assign(s, found, AVL_ASSIGN_REPLACE, &prev) && NULL == prev);
+    /* a concurrent avl_set destroys it once its readers are done */
+    ASSERT_AND_ABORT(found == avl_set_search(s, &(struct item){7, 0}) && (r ? destroyed <= 1 : 1 == destroyed));
+    struct item *fresh = item_new(N_ELEMENTS, 0);
+    ASSERT_AND_ABORT(0 == avl_set_insert_or_assign(s, fresh, AVL_ASSIGN_DETACH, &prev) && NULL == prev);
+    /* nobody would take an element detached without prev, it stays in place */
+    struct item *other = item_new(7, 2);
+    ASSERT_AND_ABORT(-1 == avl_set_insert_or_assign(s, other, AVL_ASSIGN_DETACH, NULL));
+    ASSERT_AND_ABORT(found == avl_set_search(s, &(struct item){7, 0}) && (r ? destroyed <= 1 : 1 == destroyed));
+    free(other);
+
+    /* a snapshot keeps seeing the extracted elements, which the caller owns from now on */
+    struct avl_snapshot *snap = (options & AVL_SET_SNAPSHOTS) ? avl_set_snapshot(s) : NULL;
+    struct item *out[N_ELEMENTS / 2];
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        if (r)
+        {
+            /* a reader in between the changes does not hold anything */
+            avl_set_reader_enter(r);
+            ASSERT_AND_ABORT(avl_set_search(s, &(struct item){i + 1, 0}));
+            avl_set_reader_exit(r);
+        }
+        out[i / 2] = (struct item *)avl_set_extract(s, &(struct item){i, 0});
+        ASSERT_AND_ABORT(out[i / 2] && i == out[i / 2]->key);
+        ASSERT_AND_ABORT(NULL == avl_set_extract(s, &(struct item){i, 0}));
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 + 1 == avl_set_size(s) && 1 == destroyed);
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, NULL, 0));
+    if (snap)
+    {
+        ASSERT_AND_ABORT(out[0] == avl_snapshot_search(snap, &(struct item){0, 0}));
+        avl_set_snapshot_release(snap);
+        ASSERT_AND_ABORT(1 == destroyed);
+    }
+
+    /* the extracted elements move to another avl_set */
+    struct avl_set *t = avl_set_create(item_compare, item_destroy, NULL);
+    for (i = 0; i < N_ELEMENTS / 2; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(t, out[i]));
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 == avl_set_size(t) && 0 == avl_set_validate(t, NULL, 0));
+    avl_set_destroy(t);
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 + 1 == destroyed);
+    if (r)
+    {
+        avl_set_reader_unregister(r);
+    }
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(N_ELEMENTS + 2 == destroyed);
+}
+
+/* the inline keys stay readable until the next change */
+static void test_inline_keys(void)
+{
+    struct avl_config _config = {._key_size = sizeof(struct item)};
+    struct avl_set *s = avl_set_create(item_compare, NULL, &_config);
+    struct item e;
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        e.key = i;
+        e.copy = 0;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &e));
+    }
+    e.key = 3;
+    e.copy = 1;
+    void *prev = NULL;
+    ASSERT_AND_ABORT(1 == avl_set_insert_or_assign(s, &e, AVL_ASSIGN_DETACH, &prev));
+    ASSERT_AND_ABORT(3 == ((struct item *)prev)->key && 0 == ((struct item *)prev)->copy);
+    ASSERT_AND_ABORT(1 == ((struct item *)avl_set_search(s, &e))->copy);
+    struct item *x = (struct item *)avl_set_extract(s, &e);
+    ASSERT_AND_ABORT(x && 3 == x->key && 1 == x->copy && NULL == avl_set_search(s, &e));
+    ASSERT_AND_ABORT(N_ELEMENTS - 1 == avl_set_size(s) && 0 == avl_set_validate(s, NULL, 0));
+    avl_set_destroy(s);
+}
+
+int main(int argc, char **argv)
+{
+    test_pointer_keys(0);
+    test_pointer_keys(AVL_SET_ORDER_STATISTICS);
+    test_pointer_keys(AVL_SET_CONCURRENT);
+    test_pointer_keys(AVL_SET_SNAPSHOTS);
+    test_inline_keys();
+    printf("test_extract ok\n");
+    return 0;
+}
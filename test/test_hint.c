@@ -0,0 +1,218 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+static size_t compares;
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    compares++;
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 16)
+
+/* the set holds 0 .. n - 1 in order, balanced, ranks included */
+static void check(struct avl_set *s, int n)
+{
+    struct avl_set_cursor c;
+    const int *e = (const int *)avl_set_first(s, &c);
+    int i;
+    for (i = 0; i < n; i++, e = (const int *)avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(e && i == *e);
+    }
+    ASSERT_AND_ABORT(NULL == e && (size_t)n == avl_set_size(s) && 0 == avl_set_validate(s, NULL, 0));
+}
+
+/* an ascending stream, each insertion hinted by the previous one */
+static void test_ascending(unsigned int options)
+{
+    struct avl_config _config = {._key_size = sizeof(int), ._options = options};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    struct avl_snapshot *snap = NULL;
+    struct avl_set_cursor hint;
+    memset(&hint, 0, sizeof(hint));
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint));
+        /* the hint is left on the inserted element */
+        ASSERT_AND_ABORT(i == *(const int *)avl_set_cursor_get(&hint));
+        if ((options & AVL_SET_SNAPSHOTS) && N_ELEMENTS / 2 == i)
+        {
+            snap = avl_set_snapshot(s);
+        }
+    }
+    check(s, N_ELEMENTS);
+    if (options & AVL_SET_ORDER_STATISTICS)
+    {
+        size_t rank = 0;
+        ASSERT_AND_ABORT(0 == avl_set_rank(s, &(int){N_ELEMENTS / 3}, &rank) && N_ELEMENTS / 3 == rank);
+    }
+
+    /* a duplicate replaces the element, the hint moves to it, a descent beyond the check of the hint */
+    i = N_ELEMENTS / 2;
+    compares = 0;
+    ASSERT_AND_ABORT(avl_set_search(s, &i));
+    size_t descent = compares;
+    compares = 0;
+    ASSERT_AND_ABORT(1 == avl_set_insert_hint(s, &i, &hint) && i == *(const int *)avl_set_cursor_get(&hint));
+    ASSERT_AND_ABORT(compares <= descent + 2);
+    ASSERT_AND_ABORT(i + 1 == *(const int *)avl_set_next(&hint));
+    check(s, N_ELEMENTS);
+    if (snap)
+    {
+        /* the snapshot does not see the later insertions */
+        ASSERT_AND_ABORT(NULL == avl_snapshot_search(snap, &(int){N_ELEMENTS - 1}));
+        ASSERT_AND_ABORT(avl_snapshot_search(snap, &(int){N_ELEMENTS / 2}));
+        avl_set_snapshot_release(snap);
+    }
+    avl_set_destroy(s);
+}
+
+/* a near-sorted stream: runs of ascending keys, the hint is stale at each run */
+static void test_near_sorted(void)
+{
+    struct avl_config _config = {._key_size = sizeof(int), ._options = AVL_SET_ORDER_STATISTICS};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    struct avl_set_cursor hint;
+    struct avl_set_cursor other;
+    memset(&hint, 0, sizeof(hint));
+    int i;
+    int j;
+    /* the even keys of 64 interleaved runs, then the odd ones */
+    for (j = 0; j < 2 * 64; j++)
+    {
+        for (i = (j % 64) * (N_ELEMENTS / 64) + j / 64; i < (j % 64 + 1) * (N_ELEMENTS / 64); i += 2)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint));
+        }
+    }
+    check(s, N_ELEMENTS);
+
+    /* a hint in the wrong place, or of another set, only costs a descent from the root */
+    struct avl_set *t = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(avl_set_first(s, &other));
+    i = N_ELEMENTS;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(t, &i, &other) && 1 == avl_set_size(t));
+    ASSERT_AND_ABORT(avl_set_last(s, &hint));
+    i = -1;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint) && -1 == *(const int *)avl_set_cursor_get(&hint));
+    ASSERT_AND_ABORT(0 == *(const int *)avl_set_next(&hint));
+    ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    check(s, N_ELEMENTS);
+    avl_set_destroy(t);
+    avl_set_destroy(s);
+}
+
+/* a hint moved or outlived by a change of the set is checked again, the successor it knew is not trusted */
+static void test_stale(void)
+{
+    struct avl_config _config = {._key_size = sizeof(int)};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    struct avl_set_cursor hint;
+    memset(&hint, 0, sizeof(hint));
+    int i;
+    compares = 0;
+    for (i = 0; i < N_ELEMENTS; i += 10)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint));
+    }
+    /* an append only compares with the element of the hint */
+    ASSERT_AND_ABORT(compares <= N_ELEMENTS / 10 + 32);
+
+    /* the last element has no successor, the one before it has */
+    ASSERT_AND_ABORT(avl_set_prev(&hint));
+    i = N_ELEMENTS;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint) && avl_set_search(s, &i));
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, NULL, 0));
+
+    /* 20 rotated above 10 and 30, 10 is left with 20 for successor, not 30 */
+    struct avl_set *t = avl_set_create(int_compare, NULL, &_config);
+    memset(&hint, 0, sizeof(hint));
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(t, &(int){10}, &hint));
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(t, &(int){30}, &hint));
+    ASSERT_AND_ABORT(avl_set_first(t, &hint));
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(t, &(int){20}, &hint));
+    ASSERT_AND_ABORT(10 == *(const int *)avl_set_prev(&hint));
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(t, &(int){25}, &hint));
+    ASSERT_AND_ABORT(0 == avl_set_validate(t, NULL, 0) && avl_set_search(t, &(int){25}));
+    avl_set_destroy(t);
+
+    /* the element of the hint is deleted, then its slot reused */
+    i = N_ELEMENTS;
+    ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    i = 5;
+    ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    i = N_ELEMENTS + 1;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint) && avl_set_search(s, &i));
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, NULL, 0));
+
+    /* a hint in the middle, followed by a deletion of its successor */
+    ASSERT_AND_ABORT(avl_set_lower_bound(s, &(int){20}, &hint));
+    i = 21;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint));
+    ASSERT_AND_ABORT(0 == avl_set_delete(s, &(int){30}));
+    i = 35;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint) && avl_set_search(s, &i));
+    i = 45;
+    ASSERT_AND_ABORT(0 == avl_set_insert_hint(s, &i, &hint) && avl_set_search(s, &i));
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, NULL, 0));
+    struct avl_set_cursor c;
+    const int *e = (const int *)avl_set_first(s, &c);
+    int prev = -1;
+    for (; e; e = (const int *)avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(prev < *e);
+        prev = *e;
+    }
+    avl_set_destroy(s);
+}
+
+int main(int argc, char **argv)
+{
+    test_ascending(0);
+    test_ascending(AVL_SET_ORDER_STATISTICS);
+    test_ascending(AVL_SET_CONCURRENT);
+    test_ascending(AVL_SET_SNAPSHOTS);
+    test_near_sorted();
+    test_stale();
+    printf("test_hint ok\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+
+struct point
+{
+    int64_t x;
+    int64_t y;
+};
+
+int point_compare(const void *lhs, const void *rhs)
+{
+    const struct point *l = (const struct point *)lhs;
+    const struct point *r = (const struct point *)rhs;
+    if (l->x != r->x)
+        return l->x < r->x ? -1 : 1;
+    return (l->y < r->y ? -1 : (l->y == r->y ? 0 : 1));
+}
+
+#define N_ELEMENTS (1000)
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._key_size = sizeof(int)};
+
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        /* the key lives on the stack, the set keeps its own copy */
+        int _key = (i * 7919) % N_ELEMENTS;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &_key));
+    }
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        int *_rslt = (int *)avl_set_search(s, &i);
+        ASSERT_AND_ABORT(_rslt && i == *_rslt);
+        ASSERT_AND_ABORT(_rslt != &i);
+    }
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    struct avl_set_cursor c;
+    int expected = 1;
+    void *_e = NULL;
+    for (_e = avl_set_first(s, &c); _e; _e = avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(expected == *(const int *)_e);
+        expected += 2;
+    }
+    printf("%zu inline int keys\n", avl_set_size(s));
+    avl_set_destroy(s);
+
+    _config._key_size = sizeof(struct point);
+    s = avl_set_create(point_compare, NULL, &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        struct point _p = {i % 10, i / 10};
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &_p));
+    }
+    struct point _q = {3, 42};
+    struct point *_r = (struct point *)avl_set_search(s, &_q);
+    ASSERT_AND_ABORT(_r && 3 == _r->x && 42 == _r->y);
+    ASSERT_AND_ABORT(1 == avl_set_insert(s, &_q));
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_size(s));
+    printf("%zu inline point keys\n", avl_set_size(s));
+    avl_set_destroy(s);
+
+    /* inline keys and inline values */
+    _config._key_size = sizeof(int);
+    struct avl_map *m = avl_map_create(int_compare, NULL, NULL, sizeof(double), &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        double _v = i * 0.5;
+        ASSERT_AND_ABORT(0 == avl_map_put(m, &i, &_v));
+    }
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        double *_v = (double *)avl_map_get(m, &i);
+        ASSERT_AND_ABORT(_v && i * 0.5 == *_v);
+    }
+    printf("%zu inline map entries\n", avl_map_size(m));
+    avl_map_destroy(m);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+static int u32_compare(const void *lhs, const void *rhs)
+{
+    uint32_t l = *(const uint32_t *)lhs;
+    uint32_t r = *(const uint32_t *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 22)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* percentile p (in per mille) of the sorted latencies */
+static uint32_t percentile(const uint32_t *sorted, size_t n, size_t p)
+{
+    return sorted[(n - 1) * p / 1000];
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._reserve = 1,
+        ._key_size = sizeof(int)};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    uint32_t *lat = (uint32_t *)malloc(sizeof(uint32_t) * N_ELEMENTS);
+    ASSERT_AND_ABORT(s && lat);
+
+    /* time every insertion, the arena grows all along */
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        int k = (int)(((long)i * 7919) % N_ELEMENTS);
+        uint64_t t0 = now_ns();
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &k));
+        uint64_t t = now_ns() - t0;
+        lat[i] = (t > UINT32_MAX) ? UINT32_MAX : (uint32_t)t;
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_size(s));
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(i == *(int *)avl_set_search(s, &i));
+    }
+
+    qsort(lat, N_ELEMENTS, sizeof(uint32_t), u32_compare);
+    printf("insert latency over %d insertions: p50 %u ns, p99 %u ns, p99.9 %u ns, max %u ns\n", N_ELEMENTS,
+           percentile(lat, N_ELEMENTS, 500), percentile(lat, N_ELEMENTS, 990), percentile(lat, N_ELEMENTS, 999),
+           lat[N_ELEMENTS - 1]);
+
+    /* for reference, what moving the whole arena once would cost at the end */
+    size_t bytes = (size_t)N_ELEMENTS * 16;
+    uint8_t *from = (uint8_t *)malloc(bytes);
+    uint8_t *to = (uint8_t *)malloc(bytes);
+    ASSERT_AND_ABORT(from && to);
+    memset(from, 1, bytes);
+    memset(to, 0, bytes);
+    uint64_t t0 = now_ns();
+    memcpy(to, from, bytes);
+    printf("copying a %zu MB arena once: %llu ns\n", bytes >> 20, (unsigned long long)(now_ns() - t0));
+    ASSERT_AND_ABORT(1 == to[bytes - 1]);
+    free(from);
+    free(to);
+
+    free(lat);
+    avl_set_destroy(s);
+    return 0;
+}
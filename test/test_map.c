@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+
+int string_compare(const void *lhs, const void *rhs)
+{
+    const char *l = (const char *)lhs;
+    const char *r = (const char *)rhs;
+    return strcmp(l, r);
+}
+
+void free_value(void *p)
+{
+    free(*(char **)p);
+}
+
+struct score
+{
+    int wins;
+    int losses;
+    double rate;
+};
+
+int main(int argc, char **argv)
+{
+    struct avl_map *m = avl_map_create(string_compare, NULL, NULL, sizeof(struct score), NULL);
+
+    const char *_names[5] = {
+        "alice",
+        "bob",
+        "carl",
+        "david",
+        "eve"};
+
+    size_t i = 0;
+    for (i = 0; i < 5; i++)
+    {
+        struct score _s = {(int)i, 5 - (int)i, (double)i / 5};
+        ASSERT_AND_ABORT(0 == avl_map_put(m, (void *)(_names[i]), &_s));
+        printf("putting %s\n", _names[i]);
+    }
+    ASSERT_AND_ABORT(5 == avl_map_size(m));
+
+    for (i = 0; i < 5; i++)
+    {
+        struct score *_rslt = (struct score *)avl_map_get(m, _names[i]);
+        ASSERT_AND_ABORT(_rslt);
+        ASSERT_AND_ABORT((int)i == _rslt->wins && 5 - (int)i == _rslt->losses);
+        printf("%s has %d wins\n", _names[i], _rslt->wins);
+    }
+    ASSERT_AND_ABORT(NULL == avl_map_get(m, "frank"));
+
+    struct score _replaced = {100, 0, 1.0};
+    ASSERT_AND_ABORT(1 == avl_map_put(m, (void *)("carl"), &_replaced));
+    ASSERT_AND_ABORT(100 == ((struct score *)avl_map_get(m, "carl"))->wins);
+
+    int inserted = 0;
+    struct score *_frank = (struct score *)avl_map_get_or_insert(m, (void *)("frank"), &inserted);
+    ASSERT_AND_ABORT(_frank && inserted);
+    ASSERT_AND_ABORT(0 == _frank->wins && 0 == _frank->losses);
+    _frank->wins = 7;
+    _frank = (struct score *)avl_map_get_or_insert(m, (void *)("frank"), &inserted);
+    ASSERT_AND_ABORT(_frank && !inserted && 7 == _frank->wins);
+    ASSERT_AND_ABORT(6 == avl_map_size(m));
+
+    printf("------------\n erasing alice\n-----------\n");
+    ASSERT_AND_ABORT(0 == avl_map_erase(m, "alice"));
+    ASSERT_AND_ABORT(-1 == avl_map_erase(m, "alice"));
+    ASSERT_AND_ABORT(NULL == avl_map_get(m, "alice"));
+    ASSERT_AND_ABORT(3 == ((struct score *)avl_map_get(m, "david"))->wins);
+    ASSERT_AND_ABORT(5 == avl_map_size(m));
+    avl_map_destroy(m);
+
+    /* pointer-sized values */
+    m = avl_map_create(string_compare, NULL, free_value, 0, NULL);
+    for (i = 0; i < 5; i++)
+    {
+        char *_v = (char *)malloc(16);
+        snprintf(_v, 16, "%s!", _names[i]);
+        ASSERT_AND_ABORT(0 == avl_map_put(m, (void *)(_names[i]), &_v));
+    }
+    for (i = 0; i < 5; i++)
+    {
+        char **_rslt = (char **)avl_map_get(m, _names[i]);
+        ASSERT_AND_ABORT(_rslt && 0 == strncmp(*_rslt, _names[i], strlen(_names[i])));
+        printf("we got %s\n", *_rslt);
+    }
+    avl_map_destroy(m);
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (100000)
+#define SAVED_FILE "test_mmap.avl"
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS,
+        ._key_size = sizeof(int)};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        /* odd numbers, shuffled by a multiplier coprime with N_ELEMENTS */
+        int k = (int)((i * 7919L) % N_ELEMENTS) * 2 + 1;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &k));
+    }
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        int k = i * 2 + 1;
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &k));
+    }
+    ASSERT_AND_ABORT(0 == avl_set_save(s, SAVED_FILE));
+    avl_set_destroy(s);
+
+    /* the mapped set serves lookups, cursors and order statistics */
+    struct avl_set *m = avl_set_open_mmap(SAVED_FILE, int_compare);
+    ASSERT_AND_ABORT(m && N_ELEMENTS / 2 == avl_set_size(m));
+    for (i = 0; i < 2 * N_ELEMENTS; i++)
+    {
+        int *e = (int *)avl_set_search(m, &i);
+        ASSERT_AND_ABORT((NULL != e) == (3 == i % 4));
+        ASSERT_AND_ABORT(NULL == e || *e == i);
+    }
+    struct avl_set_cursor c;
+    int *e = (int *)avl_set_first(m, &c);
+    for (i = 3; e; e = (int *)avl_set_next(&c), i += 4)
+    {
+        ASSERT_AND_ABORT(*e == i);
+    }
+    ASSERT_AND_ABORT(2 * N_ELEMENTS + 3 == i);
+    int k = 1000;
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(m, &k, &rank) && 250 == rank);
+    ASSERT_AND_ABORT(1003 == *(int *)avl_set_select(m, 250, NULL));
+    ASSERT_AND_ABORT(1003 == *(int *)avl_set_lower_bound(m, &k, &c));
+    ASSERT_AND_ABORT(999 == *(int *)avl_set_prev(&c));
+    printf("mapped: %zu elements\n", avl_set_size(m));
+
+    /* it is read-only */
+    k = 0;
+    ASSERT_AND_ABORT(-1 == avl_set_insert(m, &k));
+    k = 3;
+    ASSERT_AND_ABORT(-1 == avl_set_delete(m, &k));
+
+    /* a lookup that finds its element needs no room */
+    int inserted = 1;
+    k = 0;
+    ASSERT_AND_ABORT(NULL == avl_set_find_or_insert(m, &k, &inserted));
+    k = 3;
+    ASSERT_AND_ABORT(3 == *(int *)avl_set_find_or_insert(m, &k, &inserted) && !inserted);
+    avl_set_clear(m);
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 == avl_set_size(m));
+
+    /* a saved mapped set is the same */
+    ASSERT_AND_ABORT(0 == avl_set_save(m, SAVED_FILE ".2"));
+
+    /* saving over the mapped file replaces it, the mapped set keeps reading the previous one */
+    s = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(0 == avl_set_save(s, SAVED_FILE));
+    avl_set_destroy(s);
+    e = (int *)avl_set_first(m, &c);
+    for (i = 3; e; e = (int *)avl_set_next(&c), i += 4)
+    {
+        ASSERT_AND_ABORT(*e == i);
+    }
+    ASSERT_AND_ABORT(2 * N_ELEMENTS + 3 == i);
+    avl_set_destroy(m);
+    m = avl_set_open_mmap(SAVED_FILE ".2", int_compare);
+    ASSERT_AND_ABORT(m && N_ELEMENTS / 2 == avl_set_size(m));
+    ASSERT_AND_ABORT(NULL != avl_set_search(m, &k));
+    avl_set_destroy(m);
+    remove(SAVED_FILE ".2");
+
+    /* an empty set, a set of pointers and a truncated file */
+    s = avl_set_create(int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(0 == avl_set_save(s, SAVED_FILE));
+    avl_set_destroy(s);
+    m = avl_set_open_mmap(SAVED_FILE, int_compare);
+    ASSERT_AND_ABORT(m && 0 == avl_set_size(m) && NULL == avl_set_first(m, &c));
+    avl_set_destroy(m);
+    s = avl_set_create(int_compare, NULL, NULL);
+    ASSERT_AND_ABORT(-1 == avl_set_save(s, SAVED_FILE));
+    avl_set_destroy(s);
+    FILE *f = fopen(SAVED_FILE, "wb");
+    ASSERT_AND_ABORT(f && 1 == fwrite("CAVL", 4, 1, f));
+    fclose(f);
+    ASSERT_AND_ABORT(NULL == avl_set_open_mmap(SAVED_FILE, int_compare));
+    ASSERT_AND_ABORT(NULL == avl_set_open_mmap(SAVED_FILE ".missing", int_compare));
+    remove(SAVED_FILE);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int string_compare(const void *lhs, const void *rhs)
+{
+    return strcmp((const char *)lhs, (const char *)rhs);
+}
+
+int qsort_compare(const void *lhs, const void *rhs)
+{
+    return strcmp(*(char *const *)lhs, *(char *const *)rhs);
+}
+
+#define N_ELEMENTS (1 << 16)
+#define KEY_BYTES (32)
+
+/* short keys, long keys sharing their first 8 bytes, and keys ending in the middle of a prefix */
+static void make_key(char *buf, int i)
+{
+    switch (i % 3)
+    {
+    case 0:
+        sprintf(buf, "%d", i);
+        break;
+    case 1:
+        sprintf(buf, "https://example.com/%d", i);
+        break;
+    default:
+        sprintf(buf, "id%c", 'a' + i % 26);
+        sprintf(buf + 3, "%d", i / 26);
+        break;
+    }
+}
+
+/* the set holds the keys in order, as the sorted references */
+static void check(struct avl_set *s, char **sorted, size_t n)
+{
+    struct avl_set_cursor c;
+    const char *e = (const char *)avl_set_first(s, &c);
+    size_t i;
+    for (i = 0; i < n; i++, e = (const char *)avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(e && 0 == strcmp(e, sorted[i]));
+        ASSERT_AND_ABORT(0 == strcmp((const char *)avl_set_search(s, sorted[i]), sorted[i]));
+    }
+    ASSERT_AND_ABORT(NULL == e && n == avl_set_size(s) && 0 == avl_set_validate(s, NULL, 0));
+}
+
+int main(int argc, char **argv)
+{
+    char *keys = (char *)malloc((size_t)N_ELEMENTS * KEY_BYTES);
+    char **sorted = (char **)malloc(sizeof(char *) * N_ELEMENTS);
+    void **found = (void **)malloc(sizeof(void *) * N_ELEMENTS);
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        make_key(keys + (size_t)i * KEY_BYTES, i);
+        sorted[i] = keys + (size_t)i * KEY_BYTES;
+    }
+    qsort(sorted, N_ELEMENTS, sizeof(char *), qsort_compare);
+
+    /* the prefixes keep the order of strcmp() */
+    ASSERT_AND_ABORT(avl_string_prefix("") < avl_string_prefix("a"));
+    ASSERT_AND_ABORT(avl_string_prefix("a") < avl_string_prefix("ab"));
+    ASSERT_AND_ABORT(avl_string_prefix("ab") < avl_string_prefix("b"));
+    ASSERT_AND_ABORT(avl_string_prefix("\x7f") < avl_string_prefix("\xff"));
+    ASSERT_AND_ABORT(avl_string_prefix("abcdefgh1") == avl_string_prefix("abcdefgh2"));
+
+    /* pointer keys, and inline keys the prefixes are computed from */
+    struct avl_config _pointer = {._options = AVL_SET_ORDER_STATISTICS, ._key_prefix = avl_string_prefix};
+    struct avl_config _inline = {._key_size = KEY_BYTES, ._key_prefix = avl_string_prefix};
+    struct avl_set *s = avl_set_create(string_compare, NULL, &_pointer);
+    struct avl_set *t = avl_set_create(string_compare, NULL, &_inline);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        /* the keys are inserted in the order they were made, which is not sorted */
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, keys + (size_t)i * KEY_BYTES));
+        ASSERT_AND_ABORT(0 == avl_set_insert(t, keys + (size_t)i * KEY_BYTES));
+    }
+    ASSERT_AND_ABORT(1 == avl_set_insert(s, "https://example.com/1"));
+    check(s, sorted, N_ELEMENTS);
+    check(t, sorted, N_ELEMENTS);
+
+    /* absent keys, bounds and ranks */
+    ASSERT_AND_ABORT(NULL == avl_set_search(s, "") && NULL == avl_set_search(s, "https://example.com/x"));
+    ASSERT_AND_ABORT(NULL == avl_set_search(t, "id") && NULL == avl_set_search(t, "zzz"));
+    struct avl_set_cursor c;
+    const char *e = (const char *)avl_set_lower_bound(s, "https://example.com/", &c);
+    ASSERT_AND_ABORT(0 == strcmp(e, "https://example.com/1"));
+    for (i = 0; strcmp(sorted[i], "idb") <= 0; i++)
+        ;
+    ASSERT_AND_ABORT(0 == strcmp((const char *)avl_set_upper_bound(t, "idb", &c), sorted[i]));
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(s, sorted[N_ELEMENTS / 2], &rank) && N_ELEMENTS / 2 == rank);
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_search_batch(s, (void *const *)sorted, N_ELEMENTS, found));
+    ASSERT_AND_ABORT(N_ELEMENTS == avl_set_search_batch(t, (void *const *)sorted, N_ELEMENTS, found));
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == strcmp((const char *)found[i], sorted[i]));
+    }
+
+    struct avl_set_stats st;
+    avl_set_get_stats(s, &st);
+    if (st.counting)
+    {
+        printf("%llu comparisons decided by the prefixes, %llu calls of the comparator\n",
+               (unsigned long long)st.prefix_decisions, (unsigned long long)st.compares);
+        ASSERT_AND_ABORT(st.prefix_decisions > st.compares);
+    }
+
+    /* every other key is deleted */
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, sorted[i]));
+        ASSERT_AND_ABORT(0 == avl_set_delete(t, sorted[i]));
+        sorted[i / 2] = sorted[i + 1];
+    }
+    check(s, sorted, N_ELEMENTS / 2);
+    check(t, sorted, N_ELEMENTS / 2);
+
+    /* the set operations copy the cached prefixes along with the keys */
+    struct avl_set *u = avl_set_create(string_compare, NULL, &_pointer);
+    ASSERT_AND_ABORT(0 == avl_set_insert(u, "https://example.com/") && 0 == avl_set_insert(u, "~"));
+    struct avl_set *v = avl_set_union(s, u, 1);
+    ASSERT_AND_ABORT(v && N_ELEMENTS / 2 + 2 == avl_set_size(v) && 0 == avl_set_validate(v, NULL, 0));
+    ASSERT_AND_ABORT(avl_set_search(v, "https://example.com/") && avl_set_search(v, "~") &&
+                     avl_set_search(v, sorted[0]));
+
+    avl_set_destroy(v);
+    avl_set_destroy(u);
+    avl_set_destroy(t);
+    avl_set_destroy(s);
+    free(found);
+    free(sorted);
+    free(keys);
+    printf("test_prefix ok\n");
+    return 0;
+}
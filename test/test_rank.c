@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+
+#define N_ELEMENTS (1000)
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS};
+
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+
+    /* even numbers only, so that odd keys fall between two elements */
+    static int _values[N_ELEMENTS];
+    int i = 0;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        _values[i] = ((i * 7919) % N_ELEMENTS) * 2;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &_values[i]));
+    }
+
+    size_t _rank = 0;
+    for (i = -1; i <= N_ELEMENTS * 2; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_rank(s, &i, &_rank));
+        ASSERT_AND_ABORT((size_t)((i + 1) / 2) == _rank);
+    }
+    printf("rank checked\n");
+
+    struct avl_set_cursor c;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        void *_e = avl_set_select(s, i, &c);
+        ASSERT_AND_ABORT(_e && i * 2 == *(const int *)_e);
+    }
+    ASSERT_AND_ABORT(NULL == avl_set_select(s, N_ELEMENTS, &c));
+    ASSERT_AND_ABORT(500 == *(const int *)avl_set_select(s, 250, &c));
+    ASSERT_AND_ABORT(502 == *(const int *)avl_set_next(&c));
+    printf("select checked\n");
+
+    /* delete the lower half, order statistics must follow */
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    ASSERT_AND_ABORT(1000 == *(const int *)avl_set_select(s, 0, NULL));
+
+    int _from = 1100;
+    int _to = 1201;
+    size_t _count = 0;
+    ASSERT_AND_ABORT(0 == avl_set_count_range(s, &_from, &_to, &_count));
+    ASSERT_AND_ABORT(51 == _count);
+    printf("%zu elements in [%d, %d)\n", _count, _from, _to);
+    ASSERT_AND_ABORT(0 == avl_set_count_range(s, &_to, &_from, &_count));
+    ASSERT_AND_ABORT(0 == _count);
+
+    avl_set_destroy(s);
+
+    /* order statistics are not kept by default */
+    s = avl_set_create(int_compare, NULL, NULL);
+    ASSERT_AND_ABORT(0 == avl_set_insert(s, &_values[0]));
+    ASSERT_AND_ABORT(-1 == avl_set_rank(s, &_values[0], &_rank));
+    ASSERT_AND_ABORT(NULL == avl_set_select(s, 0, NULL));
+    avl_set_destroy(s);
+    return 0;
+}
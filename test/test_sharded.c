@@ -0,0 +1,197 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+size_t int_hash(const void *k)
+{
+    /* Fibonacci hashing spreads consecutive keys over the shards */
+    return (size_t)((unsigned int)*(const int *)k * 2654435769u >> 8);
+}
+
+#define N_KEYS (1 << 18)
+#define MAX_WRITERS (64)
+
+struct writer
+{
+    struct avl_sharded_set *ss;
+    int *keys;
+    int from;
+    int to;
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void *write_keys(void *arg)
+{
+    struct writer *w = (struct writer *)arg;
+    int i;
+    for (i = w->from; i < w->to; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_sharded_set_insert(w->ss, &w->keys[i]));
+    }
+    return NULL;
+}
+
+/* nwriters threads insert the shuffled keys, interleaved, return the insertions per second */
+static double ingest(struct avl_sharded_set *ss, int *keys, int nwriters)
+{
+    pthread_t threads[MAX_WRITERS];
+    struct writer w[MAX_WRITERS];
+    double t0 = now_ms();
+    int t;
+    for (t = 0; t < nwriters; t++)
+    {
+        w[t].ss = ss;
+        w[t].keys = keys;
+        w[t].from = (int)((long)N_KEYS * t / nwriters);
+        w[t].to = (int)((long)N_KEYS * (t + 1) / nwriters);
+        ASSERT_AND_ABORT(0 == pthread_create(&threads[t], NULL, write_keys, &w[t]));
+    }
+    for (t = 0; t < nwriters; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    return N_KEYS / ((now_ms() - t0) / 1e3);
+}
+
+static int check_order(void *e, void *arg)
+{
+    int *next = (int *)arg;
+    ASSERT_AND_ABORT(*(int *)e == *next);
+    (*next)++;
+    return 0;
+}
+
+static int stop_at_ten(void *e, void *arg)
+{
+    (void)arg;
+    return 10 == *(int *)e;
+}
+
+int main(int argc, char **argv)
+{
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+        ncpu = 1;
+    if (ncpu > MAX_WRITERS)
+        ncpu = MAX_WRITERS;
+    int *keys = (int *)malloc(sizeof(int) * N_KEYS);
+    ASSERT_AND_ABORT(keys);
+    int i;
+    for (i = 0; i < N_KEYS; i++)
+    {
+        keys[i] = i;
+    }
+    srand(7);
+    for (i = N_KEYS - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        int t = keys[i];
+        keys[i] = keys[j];
+        keys[j] = t;
+    }
+    struct avl_config _config = {
+        ._reserve = N_KEYS};
+
+    /* hash partitioning, the merged walk is in order */
+    struct avl_sharded_set *ss = avl_sharded_set_create(int_compare, NULL, int_hash, 16, &_config);
+    ASSERT_AND_ABORT(ss);
+    ingest(ss, keys, ncpu);
+    ASSERT_AND_ABORT(N_KEYS == avl_sharded_set_size(ss));
+    int next = 0;
+    ASSERT_AND_ABORT(N_KEYS == avl_sharded_set_foreach(ss, check_order, &next) && N_KEYS == next);
+    ASSERT_AND_ABORT(11 == avl_sharded_set_foreach(ss, stop_at_ten, NULL));
+    ASSERT_AND_ABORT(1 == avl_sharded_set_insert(ss, &keys[0]));
+    ASSERT_AND_ABORT(avl_sharded_set_contains(ss, &keys[1]));
+    ASSERT_AND_ABORT(0 == avl_sharded_set_delete(ss, &keys[1]));
+    ASSERT_AND_ABORT(!avl_sharded_set_contains(ss, &keys[1]));
+    ASSERT_AND_ABORT(-1 == avl_sharded_set_delete(ss, &keys[1]));
+    avl_sharded_set_destroy(ss);
+
+    /* range partitioning, the shards are walked one after another */
+    int bounds[3] = {N_KEYS / 4, N_KEYS / 2, N_KEYS / 4 * 3};
+    void *bound_keys[3] = {&bounds[0], &bounds[1], &bounds[2]};
+    ss = avl_sharded_set_create_ranges(int_compare, NULL, bound_keys, 3, &_config);
+    ASSERT_AND_ABORT(ss);
+    ingest(ss, keys, ncpu);
+    ASSERT_AND_ABORT(N_KEYS == avl_sharded_set_size(ss));
+    next = 0;
+    ASSERT_AND_ABORT(N_KEYS == avl_sharded_set_foreach(ss, check_order, &next) && N_KEYS == next);
+    ASSERT_AND_ABORT(avl_sharded_set_contains(ss, &bounds[1]));
+    avl_sharded_set_destroy(ss);
+    printf("sharded set: %d keys ingested and walked in order\n", N_KEYS);
+
+    /* scaling of the ingest with the writers, against one shard behind one lock */
+    int t;
+    for (t = 1; t <= ncpu; t *= 2)
+    {
+        ss = avl_sharded_set_create(int_compare, NULL, int_hash, 4 * t, &_config);
+        double sharded = ingest(ss, keys, t);
+        avl_sharded_set_destroy(ss);
+        ss = avl_sharded_set_create(int_compare, NULL, NULL, 1, &_config);
+        double single = ingest(ss, keys, t);
+        avl_sharded_set_destroy(ss);
+        printf("%d writers: %.2f M inserts/s with %d shards, %.2f M inserts/s with one\n", t, sharded / 1e6, 4 * t,
+               single / 1e6);
+    }
+    free(keys);
+    return 0;
+}
+#else
+int main(int argc, char **argv)
+{
+    printf("no threads on this platform, skipped\n");
+    return 0;
+}
+#endif
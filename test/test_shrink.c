@@ -0,0 +1,216 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 20)
+
+/* the arena hooks count the bytes held and the arenas allocated */
+static size_t live_bytes;
+static size_t allocations;
+static size_t allocated_bytes;
+
+static void *arena_alloc(void *ctx, size_t bytes, size_t align)
+{
+    live_bytes += bytes;
+    allocations++;
+    allocated_bytes += bytes;
+    return malloc(bytes);
+}
+
+static void arena_dealloc(void *ctx, void *p, size_t bytes)
+{
+    live_bytes -= bytes;
+    free(p);
+}
+
+/* the elements are the multiples of step in [from, to) */
+static void check(struct avl_set *s, int from, int to, int step)
+{
+    struct avl_set_cursor c;
+    int *e = (int *)avl_set_first(s, &c);
+    int i;
+    for (i = from; e; e = (int *)avl_set_next(&c), i += step)
+    {
+        ASSERT_AND_ABORT(*e == i);
+    }
+    ASSERT_AND_ABORT(i >= to && (size_t)((to - from + step - 1) / step) == avl_set_size(s));
+    for (i = from; i < to; i += step)
+    {
+        ASSERT_AND_ABORT(i == *(int *)avl_set_search(s, &i));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS | AVL_SET_SNAPSHOTS,
+        ._key_size = sizeof(int),
+        ._arena_alloc = arena_alloc,
+        ._arena_dealloc = arena_dealloc};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    size_t peak = live_bytes;
+    /* deletions alone keep the arena */
+    ASSERT_AND_ABORT(N_ELEMENTS - 1024 == avl_set_erase_range(s, &(int){1024}, &(int){N_ELEMENTS}));
+    ASSERT_AND_ABORT(peak == live_bytes);
+
+    /* nor does a shrink while a snapshot is alive */
+    struct avl_snapshot *snap = avl_set_snapshot(s);
+    ASSERT_AND_ABORT(-1 == avl_set_shrink_to_fit(s) && peak == live_bytes);
+    avl_set_snapshot_release(snap);
+    ASSERT_AND_ABORT(0 == avl_set_shrink_to_fit(s));
+    printf("arena: %zu bytes at the peak, %zu bytes for 1024 elements\n", peak, live_bytes);
+    ASSERT_AND_ABORT(live_bytes * 1000 < peak);
+    check(s, 0, 1024, 1);
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(s, &(int){512}, &rank) && 512 == rank);
+    /* the set grows again from there, and shrinks to a single slot */
+    for (i = 1024; i < 4096; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    check(s, 0, 4096, 1);
+    avl_set_clear(s);
+    ASSERT_AND_ABORT(0 == avl_set_shrink_to_fit(s) && 0 == avl_set_size(s));
+    ASSERT_AND_ABORT(0 == avl_set_insert(s, &i) && i == *(int *)avl_set_search(s, &i));
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(0 == live_bytes);
+
+    /* the low watermark follows the count of elements */
+    _config._shrink_percent = 25;
+    s = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    peak = live_bytes;
+    /* the arena drains a few slots per deletion, no deletion copies more than the first segment */
+    size_t worst = 0;
+    for (i = 0; i < N_ELEMENTS; i += 8)
+    {
+        size_t from = allocated_bytes;
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &(int){i + 1}));
+        ASSERT_AND_ABORT(0 == avl_set_erase_range(s, &(int){i + 1}, &(int){i + 2}));
+        ASSERT_AND_ABORT(6 == avl_set_erase_range(s, &(int){i + 2}, &(int){i + 8}));
+        worst = allocated_bytes - from > worst ? allocated_bytes - from : worst;
+    }
+    ASSERT_AND_ABORT(worst <= 64 * 1024);
+    check(s, 0, N_ELEMENTS, 8);
+    printf("arena: %zu bytes at the peak, %zu bytes after deleting 7 elements in 8\n", peak, live_bytes);
+    ASSERT_AND_ABORT(live_bytes < peak / 2);
+
+    /* hysteresis, a set going up and down by a third neither grows nor shrinks */
+    size_t before = allocations;
+    int round;
+    for (round = 0; round < 16; round++)
+    {
+        for (i = 1; i < N_ELEMENTS / 3; i += 8)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+        }
+        for (i = 1; i < N_ELEMENTS / 3; i += 8)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+        }
+    }
+    ASSERT_AND_ABORT(allocations - before <= 1);
+    check(s, 0, N_ELEMENTS, 8);
+    avl_set_clear(s);
+    ASSERT_AND_ABORT(0 == avl_set_size(s) && live_bytes < peak / 1000);
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(0 == live_bytes);
+
+    /* a drain gives up when the set grows back, and waits while a snapshot is alive */
+    _config._shrink_percent = 50;
+    s = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    for (round = 0; round < 2; round++)
+    {
+        for (i = 0; i < N_ELEMENTS; i += 2)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_delete(s, &(int){i + 1}));
+            if (i == N_ELEMENTS / 2 + 2 * round)
+            {
+                snap = avl_set_snapshot(s);
+            }
+        }
+        check(s, 0, N_ELEMENTS, 2);
+        ASSERT_AND_ABORT(N_ELEMENTS / 4 == *(int *)avl_snapshot_search(snap, &(int){N_ELEMENTS / 4}));
+        avl_set_snapshot_release(snap);
+        for (i = 0; i < N_ELEMENTS / 2; i += 4)
+        {
+            ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+        }
+        for (i = 0; i < N_ELEMENTS; i++)
+        {
+            int absent = (i % 2) || (0 == i % 4 && i < N_ELEMENTS / 2);
+            ASSERT_AND_ABORT(absent == (0 == avl_set_insert(s, &i)));
+        }
+        check(s, 0, N_ELEMENTS, 1);
+    }
+    avl_set_destroy(s);
+    ASSERT_AND_ABORT(0 == live_bytes);
+
+    /* a concurrent set is left alone */
+    _config._options = AVL_SET_CONCURRENT;
+    s = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < 1000; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    peak = live_bytes;
+    for (i = 0; i < 1000; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &i));
+    }
+    ASSERT_AND_ABORT(-1 == avl_set_shrink_to_fit(s) && peak == live_bytes);
+    avl_set_destroy(s);
+    return 0;
+}
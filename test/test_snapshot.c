@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1000)
+
+static int _destructed = 0;
+
+void count_destruct(void *key)
+{
+    (void)key;
+    _destructed++;
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_SNAPSHOTS | AVL_SET_ORDER_STATISTICS};
+    int *keys = malloc(sizeof(int) * N_ELEMENTS);
+    int i;
+    struct avl_set *s = avl_set_create(int_compare, count_destruct, &_config);
+    for (i = 0; i < N_ELEMENTS; i += 2)
+    {
+        keys[i] = i;
+        keys[i + 1] = i + 1;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &keys[i]));
+    }
+
+    /* the snapshot keeps the even elements */
+    struct avl_snapshot *even = avl_set_snapshot(s);
+    ASSERT_AND_ABORT(even && N_ELEMENTS / 2 == avl_snapshot_size(even));
+    for (i = 1; i < N_ELEMENTS; i += 2)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &keys[i]));
+    }
+    for (i = 0; i < N_ELEMENTS; i += 4)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_delete(s, &keys[i]));
+    }
+    ASSERT_AND_ABORT(0 == _destructed);
+    ASSERT_AND_ABORT(N_ELEMENTS / 2 == avl_snapshot_size(even));
+    ASSERT_AND_ABORT(&keys[4] == avl_snapshot_search(even, &keys[4]));
+    ASSERT_AND_ABORT(NULL == avl_snapshot_search(even, &keys[5]));
+    ASSERT_AND_ABORT(NULL == avl_set_search(s, &keys[4]));
+    ASSERT_AND_ABORT(&keys[5] == avl_set_search(s, &keys[5]));
+    struct avl_set_cursor c;
+    int *k = avl_snapshot_first(even, &c);
+    for (i = 0; k; k = avl_set_next(&c), i += 2)
+    {
+        ASSERT_AND_ABORT(*k == i);
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == i);
+    ASSERT_AND_ABORT(&keys[N_ELEMENTS - 2] == avl_snapshot_last(even, &c));
+    ASSERT_AND_ABORT(&keys[6] == avl_snapshot_lower_bound(even, &keys[5], &c));
+    ASSERT_AND_ABORT(&keys[8] == avl_snapshot_upper_bound(even, &keys[6], &c));
+    ASSERT_AND_ABORT(&keys[6] == avl_set_prev(&c));
+    printf("snapshot: %zu elements, the set has %zu\n", avl_snapshot_size(even), avl_set_size(s));
+
+    /* a newer snapshot, then the set is emptied */
+    struct avl_snapshot *mixed = avl_set_snapshot(s);
+    ASSERT_AND_ABORT(mixed && avl_set_size(s) == avl_snapshot_size(mixed));
+    struct avl_set *lo = NULL;
+    struct avl_set *hi = NULL;
+    ASSERT_AND_ABORT(-1 == avl_set_split(s, &keys[500], &lo, &hi));
+    avl_set_clear(s);
+    ASSERT_AND_ABORT(0 == avl_set_size(s) && 0 == _destructed);
+    ASSERT_AND_ABORT(&keys[5] == avl_snapshot_search(mixed, &keys[5]));
+    ASSERT_AND_ABORT(&keys[4] == avl_snapshot_search(even, &keys[4]));
+
+    /* the deleted elements are destructed with the oldest snapshot */
+    avl_set_snapshot_release(mixed);
+    ASSERT_AND_ABORT(0 == _destructed);
+    avl_set_snapshot_release(even);
+    ASSERT_AND_ABORT(N_ELEMENTS == _destructed);
+    printf("release: %d elements destructed\n", _destructed);
+
+    /* without snapshots the set is as usual */
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &keys[i]));
+    }
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(s, &keys[300], &rank) && 300 == rank);
+    ASSERT_AND_ABORT(0 == avl_set_split(s, &keys[500], &lo, &hi));
+    ASSERT_AND_ABORT(0 == avl_set_join(lo, hi));
+    avl_set_destroy(hi);
+    _destructed = 0;
+    avl_set_destroy(lo);
+    ASSERT_AND_ABORT(N_ELEMENTS == _destructed);
+    free(keys);
+    return 0;
+}
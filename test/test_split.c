@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1000)
+
+static int _destructed = 0;
+
+void count_destruct(void *key)
+{
+    (void)key;
+    _destructed++;
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {
+        ._options = AVL_SET_ORDER_STATISTICS};
+    int *keys = malloc(sizeof(int) * N_ELEMENTS);
+    int i;
+    struct avl_set *s = avl_set_create(int_compare, count_destruct, &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        keys[i] = i;
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &keys[i]));
+    }
+
+    /* erase [100, 300) */
+    int from = 100, to = 300;
+    ASSERT_AND_ABORT(200 == avl_set_erase_range(s, &from, &to));
+    ASSERT_AND_ABORT(200 == _destructed);
+    ASSERT_AND_ABORT(N_ELEMENTS - 200 == avl_set_size(s));
+    ASSERT_AND_ABORT(NULL == avl_set_search(s, &keys[100]));
+    ASSERT_AND_ABORT(NULL == avl_set_search(s, &keys[299]));
+    ASSERT_AND_ABORT(&keys[300] == avl_set_search(s, &keys[300]));
+    ASSERT_AND_ABORT(0 == avl_set_erase_range(s, &from, &to));
+    ASSERT_AND_ABORT(0 == avl_set_erase_range(s, &to, &from));
+    printf("erase range: %zu elements left\n", avl_set_size(s));
+
+    /* split at 700 */
+    struct avl_set *lo = NULL;
+    struct avl_set *hi = NULL;
+    int pivot = 700;
+    ASSERT_AND_ABORT(0 == avl_set_split(s, &pivot, &lo, &hi));
+    ASSERT_AND_ABORT(lo == s || hi == s);
+    ASSERT_AND_ABORT(500 == avl_set_size(lo) && 300 == avl_set_size(hi));
+    ASSERT_AND_ABORT(&keys[699] == avl_set_search(lo, &keys[699]));
+    ASSERT_AND_ABORT(NULL == avl_set_search(lo, &keys[700]));
+    ASSERT_AND_ABORT(&keys[700] == avl_set_search(hi, &keys[700]));
+    size_t rank = 0;
+    ASSERT_AND_ABORT(0 == avl_set_rank(hi, &keys[800], &rank) && 100 == rank);
+    printf("split: %zu + %zu elements\n", avl_set_size(lo), avl_set_size(hi));
+
+    /* overlapping sets are not joined */
+    ASSERT_AND_ABORT(-1 == avl_set_join(hi, lo));
+    ASSERT_AND_ABORT(0 == avl_set_join(lo, hi));
+    ASSERT_AND_ABORT(0 == avl_set_size(hi));
+    ASSERT_AND_ABORT(N_ELEMENTS - 200 == avl_set_size(lo));
+    struct avl_set_cursor c;
+    int *k = avl_set_first(lo, &c);
+    for (i = 0; k; k = avl_set_next(&c))
+    {
+        ASSERT_AND_ABORT(*k == i);
+        i = (99 == i) ? 300 : i + 1;
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == i);
+    ASSERT_AND_ABORT(&keys[500] == avl_set_select(lo, 300, NULL));
+    printf("join: %zu elements\n", avl_set_size(lo));
+
+    /* the emptied set is still usable */
+    ASSERT_AND_ABORT(0 == avl_set_insert(hi, &keys[150]));
+    ASSERT_AND_ABORT(-1 == avl_set_join(lo, hi) && 1 == avl_set_size(hi));
+    avl_set_destroy(hi);
+    _destructed = 0;
+    avl_set_destroy(lo);
+    ASSERT_AND_ABORT(N_ELEMENTS - 200 == _destructed);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+/* a negative order turns the comparisons around, the tree built before breaks its order */
+static int order = 1;
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return order * (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+#define N_ELEMENTS (1 << 16)
+
+static void report(struct avl_set *s, const char *what)
+{
+    struct avl_set_stats st;
+    avl_set_get_stats(s, &st);
+    printf("%s: size %zu, height %zu (max %zu), %zu of %zu slots free, %zu arena bytes for %zu live bytes\n", what,
+           st.size, st.height, st.max_height, st.free_slots, st.reserve, st.arena_bytes, st.live_bytes);
+    ASSERT_AND_ABORT(st.size == avl_set_size(s));
+    ASSERT_AND_ABORT(st.free_slots == st.reserve - st.size);
+    ASSERT_AND_ABORT(st.arena_bytes >= st.live_bytes && st.max_height >= st.height);
+    if (st.counting)
+    {
+        printf("%s: %llu compares, rotations %llu right, %llu left, %llu left-right, %llu right-left, "
+               "%llu grows moved %llu bytes\n",
+               what, (unsigned long long)st.compares, (unsigned long long)st.rotate_right,
+               (unsigned long long)st.rotate_left, (unsigned long long)st.rotate_left_right,
+               (unsigned long long)st.rotate_right_left, (unsigned long long)st.grows,
+               (unsigned long long)st.grow_bytes);
+    }
+    else
+    {
+        ASSERT_AND_ABORT(0 == st.compares && 0 == st.rotate_left && 0 == st.grows);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_config _config = {._options = AVL_SET_ORDER_STATISTICS, ._key_size = sizeof(int)};
+    struct avl_set *s = avl_set_create(int_compare, NULL, &_config);
+    size_t depths[AVL_MAX_HEIGHT];
+    struct avl_set_stats st;
+    int i;
+
+    /* an empty set is sound */
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, depths, AVL_MAX_HEIGHT) && 0 == depths[0]);
+    avl_set_get_stats(s, &st);
+    ASSERT_AND_ABORT(0 == st.size && 0 == st.height && 0 == st.live_bytes);
+
+    /* ascending insertions only rotate to the left, and the tree is perfect up to the last level */
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    report(s, "ascending");
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, depths, AVL_MAX_HEIGHT));
+    size_t d;
+    size_t total = 0;
+    for (d = 0; d < AVL_MAX_HEIGHT; d++)
+    {
+        total += depths[d];
+        if (depths[d])
+        {
+            printf("depth %zu: %zu\n", d, depths[d]);
+        }
+    }
+    ASSERT_AND_ABORT(N_ELEMENTS == total && 1 == depths[0] && 2 == depths[1]);
+    avl_set_get_stats(s, &st);
+    ASSERT_AND_ABORT(0 == depths[st.height] && 0 != depths[st.height - 1]);
+    if (st.counting)
+    {
+        ASSERT_AND_ABORT(st.rotate_left && 0 == st.rotate_right && 0 == st.rotate_left_right);
+        ASSERT_AND_ABORT(st.compares >= N_ELEMENTS && st.grows && st.grow_bytes);
+    }
+
+    /* random insertions and deletions keep the invariants, a short histogram counts the top levels only */
+    srand(7);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        int k = rand() % (4 * N_ELEMENTS);
+        if (rand() % 2)
+        {
+            avl_set_insert(s, &k);
+        }
+        else
+        {
+            avl_set_delete(s, &k);
+        }
+    }
+    report(s, "random");
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, depths, 2) && 1 == depths[0] && 2 == depths[1]);
+    ASSERT_AND_ABORT(0 == avl_set_validate(s, NULL, 0));
+
+    /* a set operation counts its comparisons */
+    struct avl_set *u = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < 16; i++)
+    {
+        int k = 4 * N_ELEMENTS + i;
+        ASSERT_AND_ABORT(0 == avl_set_insert(u, &k));
+    }
+    avl_set_get_stats(s, &st);
+    uint64_t _compares = st.compares;
+    struct avl_set *v = avl_set_union(s, u, 1);
+    ASSERT_AND_ABORT(v && avl_set_size(s) + 16 == avl_set_size(v));
+    avl_set_get_stats(s, &st);
+    ASSERT_AND_ABORT(!st.counting || st.compares > _compares);
+    ASSERT_AND_ABORT(0 == avl_set_validate(v, NULL, 0));
+    avl_set_destroy(v);
+    avl_set_destroy(u);
+
+    /* the stored elements are out of order for the reversed comparison */
+    order = -1;
+    ASSERT_AND_ABORT(-1 == avl_set_validate(s, NULL, 0));
+    order = 1;
+
+    avl_set_destroy(s);
+    printf("test_stats ok\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2021 Lu Kai
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-avl.h"
+
+#define ASSERT_AND_ABORT(stmt) \
+    do                         \
+    {                          \
+        if (!(stmt))           \
+        {                      \
+            abort();           \
+        }                      \
+    } while (0)
+
+int string_compare(const void *lhs, const void *rhs)
+{
+    const char *l = (const char *)lhs;
+    const char *r = (const char *)rhs;
+    return strcmp(l, r);
+}
+
+int int_compare(const void *lhs, const void *rhs)
+{
+    int l = *(const int *)lhs;
+    int r = *(const int *)rhs;
+    return (l < r ? -1 : (l == r ? 0 : 1));
+}
+
+size_t string_encode(const void *k, void *buf, size_t cap)
+{
+    size_t n = strlen((const char *)k);
+    if (n <= cap)
+        memcpy(buf, k, n);
+    return n;
+}
+
+void *string_decode(const void *buf, size_t n)
+{
+    char *k = (char *)malloc(n + 1);
+    memcpy(k, buf, n);
+    k[n] = '\0';
+    return k;
+}
+
+/* a pipe in memory, read back in small pieces */
+struct pipe
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+    size_t piece;
+};
+
+int pipe_write(void *ctx, const void *buf, size_t n)
+{
+    struct pipe *p = (struct pipe *)ctx;
+    if (p->len + n > p->cap)
+    {
+        p->cap = 2 * (p->len + n);
+        p->data = (char *)realloc(p->data, p->cap);
+    }
+    memcpy(p->data + p->len, buf, n);
+    p->len += n;
+    return 0;
+}
+
+size_t pipe_read(void *ctx, void *buf, size_t n)
+{
+    struct pipe *p = (struct pipe *)ctx;
+    if (n > p->piece)
+        n = p->piece;
+    if (n > p->len - p->pos)
+        n = p->len - p->pos;
+    memcpy(buf, p->data + p->pos, n);
+    p->pos += n;
+    return n;
+}
+
+#define N_ELEMENTS (20000)
+
+/* the largest single allocation, the arena of a set included */
+static size_t _largest = 0;
+
+void *counting_alloc(size_t n)
+{
+    if (n > _largest)
+        _largest = n;
+    return malloc(n);
+}
+
+static int _destructed = 0;
+
+void string_destruct(void *k)
+{
+    free(k);
+    _destructed++;
+}
+
+int main(int argc, char **argv)
+{
+    struct avl_set *s = avl_set_create(string_compare, free, NULL);
+    char name[32];
+    int i;
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        sprintf(name, "user/%08d/profile", (i * 7919) % N_ELEMENTS);
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, string_decode(name, strlen(name))));
+    }
+
+    /* front coding shrinks the stream of keys sharing their prefixes */
+    struct pipe plain = {NULL, 0, 0, 0, 7};
+    struct pipe front = {NULL, 0, 0, 0, 4096};
+    ASSERT_AND_ABORT(-1 == avl_set_serialize(s, pipe_write, &plain, NULL, 0));
+    ASSERT_AND_ABORT(0 == avl_set_serialize(s, pipe_write, &plain, string_encode, 0));
+    ASSERT_AND_ABORT(0 == avl_set_serialize(s, pipe_write, &front, string_encode, AVL_STREAM_FRONT_CODING));
+    ASSERT_AND_ABORT(front.len < plain.len / 5 * 3);
+    printf("stream: %zu bytes, %zu with front coding\n", plain.len, front.len);
+    avl_set_destroy(s);
+
+    struct pipe *pipes[2] = {&plain, &front};
+    int j;
+    for (j = 0; j < 2; j++)
+    {
+        s = avl_set_deserialize(pipe_read, pipes[j], string_decode, string_compare, free, NULL);
+        ASSERT_AND_ABORT(s && N_ELEMENTS == avl_set_size(s));
+        struct avl_set_cursor c;
+        const char *k = (const char *)avl_set_first(s, &c);
+        for (i = 0; k; k = (const char *)avl_set_next(&c), i++)
+        {
+            sprintf(name, "user/%08d/profile", i);
+            ASSERT_AND_ABORT(0 == strcmp(k, name));
+        }
+        ASSERT_AND_ABORT(N_ELEMENTS == i);
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, string_decode("zz", 2)));
+        avl_set_destroy(s);
+    }
+
+    /* a broken stream gives no set, the keys decoded so far are destroyed */
+    plain.pos = 0;
+    plain.len /= 2;
+    ASSERT_AND_ABORT(NULL == avl_set_deserialize(pipe_read, &plain, string_decode, string_compare,
+                                                 string_destruct, NULL));
+    ASSERT_AND_ABORT(0 < _destructed);
+    printf("broken stream: %d keys destroyed\n", _destructed);
+    free(plain.data);
+    free(front.data);
+
+    /* inline keys are written as they are, an unsorted stream is refused */
+    struct avl_config _config = {
+        ._key_size = sizeof(int)};
+    s = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < N_ELEMENTS; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    struct pipe ints = {NULL, 0, 0, 0, 1000};
+    ASSERT_AND_ABORT(0 == avl_set_serialize(s, pipe_write, &ints, NULL, 0));
+    avl_set_destroy(s);
+    s = avl_set_deserialize(pipe_read, &ints, NULL, int_compare, NULL, &_config);
+    ASSERT_AND_ABORT(s && N_ELEMENTS == avl_set_size(s));
+    i = N_ELEMENTS / 2;
+    ASSERT_AND_ABORT(i == *(int *)avl_set_search(s, &i));
+    avl_set_destroy(s);
+    /* the last key, after its one-byte length, takes the value of the one before */
+    memcpy(ints.data + ints.len - sizeof(int), ints.data + ints.len - 1 - 2 * sizeof(int), sizeof(int));
+    ints.pos = 0;
+    ASSERT_AND_ABORT(NULL == avl_set_deserialize(pipe_read, &ints, NULL, int_compare, NULL, &_config));
+
+    /* a count of 2^30 keys in front of three, the arena only grows with the keys actually read */
+    struct pipe forged = {NULL, 0, 0, 0, 1000};
+    unsigned char count[5] = {0x80, 0x80, 0x80, 0x80, 0x04};
+    ints.len = 0;
+    s = avl_set_create(int_compare, NULL, &_config);
+    for (i = 0; i < 3; i++)
+    {
+        ASSERT_AND_ABORT(0 == avl_set_insert(s, &i));
+    }
+    ASSERT_AND_ABORT(0 == avl_set_serialize(s, pipe_write, &ints, NULL, 0));
+    avl_set_destroy(s);
+    /* the magic, the version and the options take 6 bytes, then comes the count of 3, in one byte */
+    ASSERT_AND_ABORT(3 == ints.data[6]);
+    ASSERT_AND_ABORT(0 == pipe_write(&forged, ints.data, 6) && 0 == pipe_write(&forged, count, sizeof(count)));
+    ASSERT_AND_ABORT(0 == pipe_write(&forged, ints.data + 7, ints.len - 7));
+    struct avl_config _counted = {._key_size = sizeof(int), ._alloc = counting_alloc, ._dealloc = free};
+    ASSERT_AND_ABORT(NULL == avl_set_deserialize(pipe_read, &forged, NULL, int_compare, NULL, &_counted));
+    ASSERT_AND_ABORT(_largest < 1024 * 1024);
+    printf("forged count: largest allocation of %zu bytes\n", _largest);
+    free(forged.data);
+    free(ints.data);
+    return 0;
+}
@@ -10,4 +10,136 @@ target("test_custom")
     set_kind("binary")
     add_files("test_custom.c")
     add_deps("c-avl")
-target_end()
\ No newline at end of file
+target_end()
+
+target("test_growth")
+    set_kind("binary")
+    add_files("test_growth.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_cursor")
+    set_kind("binary")
+    add_files("test_cursor.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_rank")
+    set_kind("binary")
+    add_files("test_rank.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_map")
+    set_kind("binary")
+    add_files("test_map.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_inline")
+    set_kind("binary")
+    add_files("test_inline.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_build")
+    set_kind("binary")
+    add_files("test_build.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_batch")
+    set_kind("binary")
+    add_files("test_batch.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_algebra")
+    set_kind("binary")
+    add_files("test_algebra.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_split")
+    set_kind("binary")
+    add_files("test_split.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_concurrent")
+    set_kind("binary")
+    add_files("test_concurrent.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_snapshot")
+    set_kind("binary")
+    add_files("test_snapshot.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_sharded")
+    set_kind("binary")
+    add_files("test_sharded.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_mmap")
+    set_kind("binary")
+    add_files("test_mmap.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_stream")
+    set_kind("binary")
+    add_files("test_stream.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_compact")
+    set_kind("binary")
+    add_files("test_compact.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_arena")
+    set_kind("binary")
+    add_files("test_arena.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_shrink")
+    set_kind("binary")
+    add_files("test_shrink.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_latency")
+    set_kind("binary")
+    add_files("test_latency.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_stats")
+    set_kind("binary")
+    add_files("test_stats.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_prefix")
+    set_kind("binary")
+    add_files("test_prefix.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_extract")
+    set_kind("binary")
+    add_files("test_extract.c")
+    add_deps("c-avl")
+target_end()
+
+target("test_hint")
+    set_kind("binary")
+    add_files("test_hint.c")
+    add_deps("c-avl")
+target_end()
@@ -9,13 +9,26 @@ set_warnings("all", "error")
 -- set language: ANSI
 set_languages("ansi")
 
+-- maintain the counters of avl_set_get_stats(): xmake f --stats=y
+option("stats")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count comparisons, rotations and arena growth in avl_set_get_stats()")
+    add_defines("AVL_STATS")
+option_end()
+
 target("c-avl")
     set_kind("static")
     add_files("src/c-avl.c")
+    add_options("stats")
     add_includedirs("export", {public = true})
+    if not is_plat("windows") then
+        add_syslinks("pthread", {public = true})
+    end
 target_end()
 
 includes("test")
+includes("bench")
 
 --
 -- If you want to known more usage about xmake, please see https://xmake.io